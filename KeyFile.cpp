@@ -0,0 +1,352 @@
+#include "KeyFile.h"
+#include "bn_avx.h"
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <sddl.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char KEYFILE_MAGIC[8] = { 'L', '5', 'R', 'S', 'A', 'K', 'E', 'Y' };
+static const uint32_t KEYFILE_VERSION = 1;
+static const uint32_t KEYFILE_BYTE_ORDER = 0x01020304;
+// Limb-ов в начале поля контекста Монтгомери: mm, engine, N.n, RR.n, RRs.n
+static const size_t KEYFILE_MONT_META = 5;
+
+KeyFile::KeyFile()
+{
+	_OutFields = 0;
+	_Map = NULL;
+	_MapSize = 0;
+	_MapHandle = NULL;
+}
+
+KeyFile::~KeyFile()
+{
+	_wipe();
+	_close();
+}
+// Затереть записываемые поля: в них закрытый ключ
+void KeyFile::_wipe()
+{
+	// Через volatile, чтобы компилятор не убрал запись в уже ненужную память
+	volatile t_uint *p = _Out.empty() ? NULL : &_Out[0];
+	for (size_t i = 0; i < _Out.size(); i++)
+		p[i] = 0;
+	_Out.clear();
+	_OutFields = 0;
+}
+// Дописать limb-ы mpi в _Out
+void KeyFile::_store(const mpi *X, size_t Count)
+{
+	if (Count > 0)
+		_Out.insert(_Out.end(), X->p, X->p + Count);
+}
+// Добавить число в записываемый файл
+void KeyFile::Put(int Tag, BigInteger const & BI)
+{
+	// Старшие нулевые limb-ы не записываются
+	size_t Count = BI._MPI.n;
+	while (Count > 0 && BI._MPI.p[Count - 1] == 0)
+		Count--;
+
+	KeyFileField F;
+	F.Tag = Tag;
+	F.Sign = BI._MPI.s;
+	F.Limbs = Count;
+	const t_uint *Limbs = (const t_uint *)&F;
+	_Out.insert(_Out.end(), Limbs, Limbs + sizeof(F) / sizeof(t_uint));
+	_store(&BI._MPI, Count);
+	_OutFields++;
+}
+// Добавить контекст Монтгомери в записываемый файл
+void KeyFile::Put(int Tag, MontgomeryContext const & MC)
+{
+	// N.n и RR.n записываются как есть: от них зависит R = 2^(biL * N.n)
+	const mpi_mont_ctx & Ctx = MC._Ctx;
+	KeyFileField F;
+	F.Tag = Tag;
+	F.Sign = 1;
+	F.Limbs = KEYFILE_MONT_META + Ctx.N.n + Ctx.RR.n + Ctx.RRs.n;
+	const t_uint *Limbs = (const t_uint *)&F;
+	_Out.insert(_Out.end(), Limbs, Limbs + sizeof(F) / sizeof(t_uint));
+	_Out.push_back(Ctx.mm);
+	_Out.push_back((t_uint)Ctx.engine);
+	_Out.push_back((t_uint)Ctx.N.n);
+	_Out.push_back((t_uint)Ctx.RR.n);
+	_Out.push_back((t_uint)Ctx.RRs.n);
+	_store(&Ctx.N, Ctx.N.n);
+	_store(&Ctx.RR, Ctx.RR.n);
+	_store(&Ctx.RRs, Ctx.RRs.n);
+	_OutFields++;
+}
+// Записать добавленные поля в файл
+void KeyFile::Save(string FileName, int KeySize)
+{
+	KeyFileHeader H;
+	memset(&H, 0, sizeof(H));
+	memcpy(H.Magic, KEYFILE_MAGIC, sizeof(H.Magic));
+	H.Version = KEYFILE_VERSION;
+	H.LimbSize = sizeof(t_uint);
+	H.ByteOrder = KEYFILE_BYTE_ORDER;
+	H.KeySize = KeySize;
+	H.Fields = _OutFields;
+
+	FILE *f = _create(FileName);
+	bool Ok = fwrite(&H, sizeof(H), 1, f) == 1;
+	if (Ok && !_Out.empty())
+		Ok = fwrite(&_Out[0], sizeof(t_uint), _Out.size(), f) == _Out.size();
+	if (fclose(f) != 0)
+		Ok = false;
+	_wipe();
+	if (!Ok)
+		throw exception("Cannot write key file");
+}
+// Создать файл ключа, доступный только владельцу
+FILE * KeyFile::_create(string FileName)
+{
+#if defined(_WIN32)
+	// Защищенный DACL с единственной записью OWNER RIGHTS: права не
+	// наследуются от каталога. У существующего файла CreateFile не меняет
+	// дескриптор безопасности, поэтому старый файл сначала удаляется
+	PSECURITY_DESCRIPTOR Sd = NULL;
+	if (!ConvertStringSecurityDescriptorToSecurityDescriptorA("D:P(A;;FA;;;OW)", SDDL_REVISION_1, &Sd, NULL))
+		throw exception("Cannot open key file");
+	SECURITY_ATTRIBUTES Sa;
+	Sa.nLength = sizeof(Sa);
+	Sa.lpSecurityDescriptor = Sd;
+	Sa.bInheritHandle = FALSE;
+	DeleteFileA(FileName.c_str());
+	HANDLE File = CreateFileA(FileName.c_str(), GENERIC_WRITE, 0, &Sa,
+		CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	LocalFree(Sd);
+	if (File == INVALID_HANDLE_VALUE)
+		throw exception("Cannot open key file");
+	int Fd = _open_osfhandle((intptr_t)File, _O_WRONLY | _O_BINARY);
+	if (Fd < 0)
+	{
+		CloseHandle(File);
+		throw exception("Cannot open key file");
+	}
+	FILE *f = _fdopen(Fd, "wb");
+	if (f == NULL)
+	{
+		::_close(Fd);
+		throw exception("Cannot open key file");
+	}
+#else
+	// Режим 0600; у существующего файла open права не меняет, поэтому
+	// еще fchmod - до записи, файл к этому моменту уже пуст
+	int Fd = open(FileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (Fd < 0)
+		throw exception("Cannot open key file");
+	if (fchmod(Fd, 0600) != 0)
+	{
+		close(Fd);
+		throw exception("Cannot open key file");
+	}
+	FILE *f = fdopen(Fd, "wb");
+	if (f == NULL)
+	{
+		close(Fd);
+		throw exception("Cannot open key file");
+	}
+#endif
+	return f;
+}
+// Снять отображение
+void KeyFile::_close()
+{
+	if (_Map != NULL)
+	{
+#if defined(_WIN32)
+		UnmapViewOfFile(_Map);
+		CloseHandle((HANDLE)_MapHandle);
+#else
+		munmap((void *)_Map, _MapSize);
+#endif
+	}
+	_Map = NULL;
+	_MapSize = 0;
+	_MapHandle = NULL;
+	_Fields.clear();
+}
+// Отобразить файл в память и проверить заголовок и поля
+void KeyFile::Open(string FileName)
+{
+	_close();
+#if defined(_WIN32)
+	HANDLE File = CreateFileA(FileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (File == INVALID_HANDLE_VALUE)
+		throw exception("Cannot open key file");
+	LARGE_INTEGER Size;
+	if (!GetFileSizeEx(File, &Size) || Size.QuadPart < (LONGLONG)sizeof(KeyFileHeader))
+	{
+		CloseHandle(File);
+		throw exception("Bad key file");
+	}
+	HANDLE Mapping = CreateFileMappingA(File, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(File);
+	if (Mapping == NULL)
+		throw exception("Cannot map key file");
+	_Map = (const unsigned char *)MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+	if (_Map == NULL)
+	{
+		CloseHandle(Mapping);
+		throw exception("Cannot map key file");
+	}
+	_MapHandle = Mapping;
+	_MapSize = (size_t)Size.QuadPart;
+#else
+	int File = open(FileName.c_str(), O_RDONLY);
+	if (File < 0)
+		throw exception("Cannot open key file");
+	struct stat St;
+	if (fstat(File, &St) != 0 || St.st_size < (off_t)sizeof(KeyFileHeader))
+	{
+		close(File);
+		throw exception("Bad key file");
+	}
+	void *Map = mmap(NULL, (size_t)St.st_size, PROT_READ, MAP_PRIVATE, File, 0);
+	close(File);
+	if (Map == MAP_FAILED)
+		throw exception("Cannot map key file");
+	_Map = (const unsigned char *)Map;
+	_MapSize = (size_t)St.st_size;
+#endif
+
+	// Заголовок, затем каждое поле целиком внутри файла
+	const KeyFileHeader *H = (const KeyFileHeader *)_Map;
+	bool Ok = memcmp(H->Magic, KEYFILE_MAGIC, sizeof(H->Magic)) == 0 &&
+		H->Version == KEYFILE_VERSION && H->LimbSize == sizeof(t_uint) &&
+		H->ByteOrder == KEYFILE_BYTE_ORDER;
+	_Fields.assign(KEYFILE_MONT_Q + 1, NULL);
+	size_t Pos = sizeof(KeyFileHeader);
+	for (uint32_t i = 0; Ok && i < H->Fields; i++)
+	{
+		if (_MapSize - Pos < sizeof(KeyFileField))
+		{
+			Ok = false;
+			break;
+		}
+		const KeyFileField *F = (const KeyFileField *)(_Map + Pos);
+		Pos += sizeof(KeyFileField);
+		if (F->Limbs > (_MapSize - Pos) / sizeof(t_uint))
+		{
+			Ok = false;
+			break;
+		}
+		Pos += (size_t)F->Limbs * sizeof(t_uint);
+		// Незнакомые поля пропускаются
+		if (F->Tag < _Fields.size())
+			_Fields[F->Tag] = F;
+	}
+	if (!Ok)
+	{
+		_close();
+		throw exception("Bad key file");
+	}
+}
+// Размер ключа из заголовка открытого файла
+int KeyFile::KeySize()
+{
+	if (_Map == NULL)
+		throw exception("Key file is not open");
+	return ((const KeyFileHeader *)_Map)->KeySize;
+}
+// Есть ли поле в открытом файле
+bool KeyFile::Has(int Tag)
+{
+	return Tag >= 0 && (size_t)Tag < _Fields.size() && _Fields[Tag] != NULL;
+}
+// Описатель поля Tag или исключение
+const KeyFileField * KeyFile::_field(int Tag)
+{
+	if (!Has(Tag))
+		throw exception("Key file field is missing");
+	return _Fields[Tag];
+}
+// Скопировать Limbs limb-ов в mpi
+void KeyFile::_load(mpi *X, const t_uint *Limbs, size_t Count, int Sign)
+{
+	// mpi владеет своим буфером (mpi_grow, mpi_free), поэтому limb-ы
+	// копируются из отображения, а не используются на месте
+	mpi_free(X);
+	if (Count == 0)
+	{
+		if (mpi_lset(X, 0) != 0)
+			throw exception("Memory allocation failed");
+		return;
+	}
+	if (mpi_grow(X, Count) != 0)
+		throw exception("Memory allocation failed");
+	memcpy(X->p, Limbs, Count * sizeof(t_uint));
+	X->s = (Sign < 0) ? -1 : 1;
+}
+// Прочитать число из открытого файла
+void KeyFile::Get(int Tag, BigInteger & BI)
+{
+	const KeyFileField *F = _field(Tag);
+	_load(&BI._MPI, (const t_uint *)(F + 1), (size_t)F->Limbs, F->Sign);
+}
+// Прочитать контекст Монтгомери для модуля N из открытого файла
+void KeyFile::Get(int Tag, MontgomeryContext & MC, BigInteger const & N)
+{
+	const KeyFileField *F = _field(Tag);
+	const t_uint *Limbs = (const t_uint *)(F + 1);
+	if (F->Limbs < KEYFILE_MONT_META)
+		throw exception("Bad key file");
+	size_t NCount = (size_t)Limbs[2], RRCount = (size_t)Limbs[3], RRsCount = (size_t)Limbs[4];
+	if (NCount == 0 || NCount > F->Limbs || RRCount > F->Limbs || RRsCount > F->Limbs ||
+		KEYFILE_MONT_META + NCount + RRCount + RRsCount != F->Limbs)
+		throw exception("Bad key file");
+
+	mpi_mont_ctx & Ctx = MC._Ctx;
+	mpi_mont_free(&Ctx);
+	Limbs += KEYFILE_MONT_META;
+	_load(&Ctx.N, Limbs, NCount, 1);
+	Limbs += NCount;
+	_load(&Ctx.RR, Limbs, RRCount, 1);
+	Limbs += RRCount;
+	if (RRsCount > 0)
+		_load(&Ctx.RRs, Limbs, RRsCount, 1);
+	Ctx.mm = ((const t_uint *)(F + 1))[0];
+	Ctx.engine = (int)((const t_uint *)(F + 1))[1];
+
+	// Контекст другого модуля - файл испорчен
+	if (mpi_cmp_mpi(&Ctx.N, &N._MPI) != 0)
+	{
+		mpi_mont_free(&Ctx);
+		throw exception("Bad key file");
+	}
+
+	// Файл записан на машине с другим набором инструкций: RR и RRs
+	// для движка этой машины пересчитываются
+	int Engine = 0;
+#if defined(POLARSSL_MPI_HAVE_AVX2)
+	if (mpi_avx_engine(mpi_msb(&Ctx.N)) == POLARSSL_MPI_ENGINE_IFMA)
+		Engine = POLARSSL_MPI_ENGINE_IFMA;
+#endif
+	if (Ctx.engine != Engine)
+	{
+		MC.Setup(N);
+		return;
+	}
+	// Иначе mm, RR и RRs проверяются: неверный RR дал бы молча неверные
+	// половины CRT, а по одной неверной подписи CRT раскладывается N
+	int ret = mpi_mont_check(&Ctx);
+	if (ret != 0)
+	{
+		mpi_mont_free(&Ctx);
+		throw exception(ret == POLARSSL_ERR_MPI_MALLOC_FAILED ? "Memory allocation failed" : "Bad key file");
+	}
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include "MpiBigInt.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+// Двоичный файл ключа RSA. После заголовка идут поля: описатель поля и
+// limb-ы числа в том же порядке, что и в mpi::p. Все части выровнены по
+// размеру limb, так что загрузка - это одно отображение файла в память
+// (mmap / MapViewOfFile) и копирование limb-ов в mpi, без разбора текста
+// и без пересчета mm и R^2 mod N. Файл переносим только между машинами с
+// тем же размером limb и порядком байт: заголовок это проверяет.
+//
+// Поле контекста Монтгомери: limb-ы mm, engine, N.n, RR.n, RRs.n, затем
+// limb-ы N, RR и RRs.
+//
+// В файле закрытый ключ: Save создает его с правами только для владельца
+// (0600, в Windows - DACL только с OWNER RIGHTS) и после записи затирает
+// буфер полей.
+
+// Поля файла ключа
+enum KeyFileTag
+{
+	KEYFILE_N = 1, KEYFILE_E, KEYFILE_D, KEYFILE_P, KEYFILE_Q,
+	// Параметры CRT: D mod (P-1), D mod (Q-1), Q^-1 mod P
+	KEYFILE_DP, KEYFILE_DQ, KEYFILE_QP,
+	// Контексты Монтгомери для N, P и Q
+	KEYFILE_MONT_N, KEYFILE_MONT_P, KEYFILE_MONT_Q
+};
+
+// Заголовок файла ключа
+struct KeyFileHeader
+{
+	char Magic[8];
+	uint32_t Version;
+	// sizeof(t_uint)
+	uint32_t LimbSize;
+	// 0x01020304 в порядке байт записавшей машины
+	uint32_t ByteOrder;
+	// Размер ключа в битах
+	uint32_t KeySize;
+	// Количество полей
+	uint32_t Fields;
+	uint32_t Reserved;
+};
+
+// Описатель поля
+struct KeyFileField
+{
+	uint32_t Tag;
+	// Знак числа (mpi::s)
+	int32_t Sign;
+	// Limb-ов данных после описателя
+	uint64_t Limbs;
+};
+
+class KeyFile
+{
+public:
+	KeyFile();
+	~KeyFile();
+	// Добавить число в записываемый файл
+	void Put(int Tag, BigInteger const & BI);
+	// Добавить контекст Монтгомери в записываемый файл
+	void Put(int Tag, MontgomeryContext const & MC);
+	// Записать добавленные поля в файл
+	void Save(string FileName, int KeySize);
+
+	// Отобразить файл в память и проверить заголовок и поля
+	void Open(string FileName);
+	// Размер ключа из заголовка открытого файла
+	int KeySize();
+	// Есть ли поле в открытом файле
+	bool Has(int Tag);
+	// Прочитать число из открытого файла
+	void Get(int Tag, BigInteger & BI);
+	// Прочитать контекст Монтгомери для модуля N из открытого файла.
+	// Контекст не для N или с неверными mm, RR, RRs - исключение
+	void Get(int Tag, MontgomeryContext & MC, BigInteger const & N);
+private:
+	// Записываемые поля
+	vector<t_uint> _Out;
+	uint32_t _OutFields;
+
+	// Отображение открытого файла
+	const unsigned char *_Map;
+	size_t _MapSize;
+	void *_MapHandle;
+	// Описатели полей в отображении, по тегу
+	vector<const KeyFileField *> _Fields;
+
+	KeyFile(KeyFile const &);
+	KeyFile operator= (KeyFile const &);
+	// Снять отображение
+	void _close();
+	// Описатель поля Tag или исключение
+	const KeyFileField * _field(int Tag);
+	// Создать файл ключа, доступный только владельцу
+	static FILE * _create(string FileName);
+	// Затереть записываемые поля
+	void _wipe();
+	// Скопировать Limbs limb-ов в mpi
+	static void _load(mpi *X, const t_uint *Limbs, size_t Count, int Sign);
+	// Дописать limb-ы mpi в _Out
+	void _store(const mpi *X, size_t Count);
+};
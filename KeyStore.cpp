@@ -0,0 +1,172 @@
+#include "KeyStore.h"
+#include "KeyFile.h"
+
+// Счетчик попаданий текущего потока
+static size_t _HitSlot()
+{
+	static atomic<size_t> Next(0);
+	static thread_local size_t Slot = Next++;
+	return Slot;
+}
+
+KeyStore::KeyStore(size_t Capacity)
+{
+	if (Capacity < 1)
+		Capacity = 1;
+	_Capacity = Capacity;
+	_Cache = make_shared<const _Table>();
+	_Clock = 0;
+	for (size_t i = 0; i < HIT_COUNTERS; i++)
+		_Hits[i].Value = 0;
+	_Misses = 0;
+	_Evictions = 0;
+}
+// Добавить ключ или заменить ключ с тем же Id
+void KeyStore::Add(string Id, RSACrypter const & R)
+{
+	RSAKey const & Key = R._Key();
+	shared_ptr<_Key> K = make_shared<_Key>();
+	K->KeySize = Key._KeySize;
+	K->N = Key._N;
+	K->E = Key._E;
+	K->D = Key._D;
+	K->P = Key._P;
+	K->Q = Key._Q;
+	K->FillChar = R._FillChar;
+	K->ParallelCRT = R._ParallelCRT;
+	K->SignMode = R._SignMode;
+	K->CryptMode = R._CryptMode;
+	K->Threads = R._Threads;
+	_put(Id, K);
+}
+// Добавить ключ из файла, записанного RSACrypter::SaveKey
+void KeyStore::Add(string Id, string KeyFileName, char FillChar)
+{
+	// Параметры CRT и контексты Монтгомери из файла не нужны: хранилище
+	// держит только исходные числа, кэш подготовит их сам
+	KeyFile KF;
+	KF.Open(KeyFileName);
+	shared_ptr<_Key> K = make_shared<_Key>();
+	K->KeySize = KF.KeySize();
+	KF.Get(KEYFILE_N, K->N);
+	KF.Get(KEYFILE_E, K->E);
+	KF.Get(KEYFILE_D, K->D);
+	KF.Get(KEYFILE_P, K->P);
+	KF.Get(KEYFILE_Q, K->Q);
+	// Настройки по умолчанию берутся у RSACrypter без ключа
+	RSACrypter Defaults((shared_ptr<const RSAKey>()), FillChar);
+	K->FillChar = FillChar;
+	K->ParallelCRT = Defaults._ParallelCRT;
+	K->SignMode = Defaults._SignMode;
+	K->CryptMode = Defaults._CryptMode;
+	K->Threads = Defaults._Threads;
+	_put(Id, K);
+}
+// Удалить ключ
+void KeyStore::Remove(string Id)
+{
+	lock_guard<mutex> Guard(_Lock);
+	_Keys.erase(Id);
+	_uncache(Id);
+}
+// Есть ли ключ
+bool KeyStore::Has(string Id)
+{
+	lock_guard<mutex> Guard(_Lock);
+	return _Keys.count(Id) != 0;
+}
+// Подготовленный ключ. Исключение, если ключа нет
+shared_ptr<const RSACrypter> KeyStore::Get(string Id)
+{
+	// Попадание: без блокировки хранилища и без записи в общие счетчики.
+	// Отметка ключа пишется, только если с прошлого раза был промах
+	shared_ptr<const _Table> Cache = atomic_load(&_Cache);
+	_Table::const_iterator It = Cache->find(Id);
+	if (It != Cache->end())
+	{
+		unsigned long long Now = _Clock.load(memory_order_relaxed);
+		if (It->second->LastUse.load(memory_order_relaxed) != Now)
+			It->second->LastUse.store(Now, memory_order_relaxed);
+		_Hits[_HitSlot() % HIT_COUNTERS].Value.fetch_add(1, memory_order_relaxed);
+		return It->second->Crypter;
+	}
+
+	shared_ptr<const _Key> K;
+	{
+		lock_guard<mutex> Guard(_Lock);
+		map<string, shared_ptr<const _Key> >::iterator KIt = _Keys.find(Id);
+		if (KIt == _Keys.end())
+			throw exception("Unknown key");
+		K = KIt->second;
+	}
+	// Подготовка идет вне блокировки: промахи по разным ключам не ждут
+	// друг друга
+	_Misses++;
+	shared_ptr<_Cached> C = make_shared<_Cached>();
+	shared_ptr<RSACrypter> R = make_shared<RSACrypter>(make_shared<RSAKey>(K->KeySize,
+		K->N, K->E, K->D, K->P, K->Q), K->FillChar);
+	R->_ParallelCRT = K->ParallelCRT;
+	R->_SignMode = K->SignMode;
+	R->_CryptMode = K->CryptMode;
+	R->_Threads = K->Threads;
+	C->Crypter = R;
+	C->LastUse = ++_Clock;
+
+	lock_guard<mutex> Guard(_Lock);
+	// Ключ заменили или удалили, пока он готовился: в кэш не кладем
+	map<string, shared_ptr<const _Key> >::iterator KIt = _Keys.find(Id);
+	if (KIt == _Keys.end() || KIt->second != K)
+		return C->Crypter;
+	shared_ptr<_Table> Next = make_shared<_Table>(*atomic_load(&_Cache));
+	// Тот же ключ уже подготовил другой поток
+	It = Next->find(Id);
+	if (It != Next->end())
+		return It->second->Crypter;
+	(*Next)[Id] = C;
+	while (Next->size() > _Capacity)
+	{
+		_Table::iterator Oldest = Next->begin();
+		for (_Table::iterator I = Next->begin(); I != Next->end(); ++I)
+			if (I->second->LastUse.load(memory_order_relaxed) <
+				Oldest->second->LastUse.load(memory_order_relaxed))
+				Oldest = I;
+		Next->erase(Oldest);
+		_Evictions++;
+	}
+	atomic_store(&_Cache, shared_ptr<const _Table>(Next));
+	return C->Crypter;
+}
+// Метрики кэша
+KeyStore::Stats KeyStore::GetStats()
+{
+	Stats S;
+	{
+		lock_guard<mutex> Guard(_Lock);
+		S.Keys = _Keys.size();
+	}
+	S.Cached = atomic_load(&_Cache)->size();
+	S.Hits = 0;
+	for (size_t i = 0; i < HIT_COUNTERS; i++)
+		S.Hits += _Hits[i].Value.load(memory_order_relaxed);
+	S.Misses = _Misses;
+	S.Evictions = _Evictions;
+	S.HitRate = (S.Hits + S.Misses > 0) ? (double)S.Hits / (S.Hits + S.Misses) : 0;
+	return S;
+}
+// Сохранить ключ и убрать из кэша его прежнюю версию
+void KeyStore::_put(string Id, shared_ptr<const _Key> K)
+{
+	lock_guard<mutex> Guard(_Lock);
+	_Keys[Id] = K;
+	_uncache(Id);
+}
+// Убрать ключ из кэша (под _Lock)
+void KeyStore::_uncache(string Id)
+{
+	shared_ptr<const _Table> Cache = atomic_load(&_Cache);
+	if (Cache->count(Id) == 0)
+		return;
+	shared_ptr<_Table> Next = make_shared<_Table>(*Cache);
+	Next->erase(Id);
+	atomic_store(&_Cache, shared_ptr<const _Table>(Next));
+}
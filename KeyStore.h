@@ -0,0 +1,106 @@
+#pragma once
+#include "RSA.h"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+
+// Хранилище ключей RSA по идентификатору. Для каждого ключа хранятся
+// только N, E, D, P, Q и настройки RSACrypter; подготовленные RSACrypter
+// (параметры CRT и контексты Монтгомери) держатся в кэше на Capacity
+// ключей, при переполнении вытесняется давнее всех использованный.
+//
+// Кэш - неизменяемая таблица, которую Get() читает через atomic_load без
+// блокировки хранилища. Промах готовит ключ вне блокировки, а затем под
+// ней публикует новую копию таблицы. Попадание при этом не lock-free:
+// atomic_load для shared_ptr в libstdc++ и MSVC берет короткую
+// спин-блокировку из общего пула, а возвращаемый shared_ptr меняет
+// счетчик ссылок ключа. Общих счетчиков попадание не пишет: попадания
+// считаются по потокам, а отметка для вытеснения - в самом ключе.
+class KeyStore
+{
+public:
+	// Метрики кэша
+	struct Stats
+	{
+		// Ключей в хранилище
+		size_t Keys;
+		// Подготовленных ключей в кэше
+		size_t Cached;
+		// Get() с готовым ключом в кэше
+		size_t Hits;
+		// Get(), подготовившие ключ
+		size_t Misses;
+		// Ключей, вытесненных из кэша
+		size_t Evictions;
+		// Доля попаданий
+		double HitRate;
+	};
+
+	// Capacity - подготовленных ключей в кэше
+	KeyStore(size_t Capacity = 64);
+	// Добавить ключ или заменить ключ с тем же Id. Get отдаст RSACrypter
+	// с настройками R: FillChar, режимы подписи и шифрования, потоки,
+	// ParallelCRT
+	void Add(string Id, RSACrypter const & R);
+	// Добавить ключ из файла, записанного RSACrypter::SaveKey; настройки
+	// по умолчанию
+	void Add(string Id, string KeyFileName, char FillChar);
+	// Удалить ключ
+	void Remove(string Id);
+	// Есть ли ключ
+	bool Has(string Id);
+	// Подготовленный ключ. Исключение, если ключа нет. Один и тот же
+	// объект отдается всем потокам, поэтому он const
+	shared_ptr<const RSACrypter> Get(string Id);
+	// Метрики кэша
+	Stats GetStats();
+private:
+	// Ключ в хранилище
+	struct _Key
+	{
+		int KeySize;
+		BigInteger N, E, D, P, Q;
+		// Настройки RSACrypter
+		char FillChar;
+		bool ParallelCRT;
+		RSACrypter::SignMode SignMode;
+		RSACrypter::CryptMode CryptMode;
+		int Threads;
+	};
+	// Ключ в кэше
+	struct _Cached
+	{
+		shared_ptr<const RSACrypter> Crypter;
+		// Отметка последнего использования для вытеснения: значение _Clock
+		// при последнем попадании
+		atomic<unsigned long long> LastUse;
+	};
+	// Счетчик попаданий группы потоков, на своей строке кэша
+	struct _HitCounter
+	{
+		atomic<size_t> Value;
+		char Pad[64 - sizeof(atomic<size_t>)];
+	};
+	static const size_t HIT_COUNTERS = 16;
+	typedef map<string, shared_ptr<_Cached> > _Table;
+
+	size_t _Capacity;
+	// Ключи; меняются и читаются под _Lock
+	map<string, shared_ptr<const _Key> > _Keys;
+	// Кэш; читается через atomic_load, заменяется под _Lock
+	shared_ptr<const _Table> _Cache;
+	mutex _Lock;
+	// Растет только при промахах; попадания его лишь читают, так что ключи,
+	// использованные после последнего промаха, для вытеснения равны
+	atomic<unsigned long long> _Clock;
+	_HitCounter _Hits[HIT_COUNTERS];
+	atomic<size_t> _Misses, _Evictions;
+
+	KeyStore(KeyStore const &);
+	KeyStore operator= (KeyStore const &);
+	// Сохранить ключ и убрать из кэша его прежнюю версию
+	void _put(string Id, shared_ptr<const _Key> K);
+	// Убрать ключ из кэша (под _Lock)
+	void _uncache(string Id);
+};
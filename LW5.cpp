@@ -1,23 +1,11 @@
 #include "bignum.h"
+#include "chacha_drbg.h"
 #include <stdlib.h>
 
-//        
-static int myrand( void *rng_state, unsigned char *output, size_t len )
-{
-    size_t i;
-
-    if( rng_state != NULL )
-        rng_state  = NULL;
-
-    for( i = 0; i < len; ++i )
-        output[i] = rand();
-    
-    return( 0 );
-}
-
 int main(int argc, char* argv[])
 {
 	mpi E, P, Q, N, H, D, X, Y, Z;
+	chacha_drbg_context rng;
 
     ((void) argc);
     ((void) argv);
@@ -26,7 +14,8 @@ int main(int argc, char* argv[])
     mpi_init( &H ); mpi_init( &D ); mpi_init( &X ); mpi_init( &Y );
     mpi_init( &Z );
 
-	if (mpi_gen_prime(&P, 512, 0, myrand, NULL) == 0)
+	if (chacha_drbg_seed_os(&rng) == 0 &&
+		mpi_gen_prime(&P, 512, 0, chacha_drbg_random, &rng) == 0)
 	{
 		printf( "\n  Primary:\n\n" );
 		mpi_write_file( "  P = ", &P, 16, NULL );
@@ -69,6 +58,7 @@ int main(int argc, char* argv[])
     mpi_free( &E ); mpi_free( &P ); mpi_free( &Q ); mpi_free( &N );
     mpi_free( &H ); mpi_free( &D ); mpi_free( &X ); mpi_free( &Y );
     mpi_free( &Z );
+    chacha_drbg_free( &rng );
 
 #if defined(_WIN32)
     printf( "  Press Enter to exit this program...\n" );
@@ -32,7 +32,6 @@ int main(int argc, char* argv[])
 	cout << "Input key size in bits	:\n\t";
 	cin >> keySize;
 
-	srand((unsigned int)time(0));
 	RSACrypter rsaCrypter = RSACrypter(keySize);
 
 	cout << "Input string to encrypt:\n\t";
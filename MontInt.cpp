@@ -0,0 +1,116 @@
+#include "MontInt.h"
+
+MontInt::MontInt()
+{
+	mpi_init(&_MPI);
+	_Ctx = NULL;
+}
+
+MontInt::MontInt(MontgomeryContext const & MC)
+{
+	mpi_init(&_MPI);
+	mpi_lset(&_MPI, 0);
+	_Ctx = &MC;
+}
+
+MontInt::MontInt(BigInteger const & BI, MontgomeryContext const & MC)
+{
+	mpi_init(&_MPI);
+	_Ctx = &MC;
+	if (mpi_mont_to(&_MPI, &BI._MPI, &_Ctx->_Ctx) != 0)
+		throw exception("Bad input parameters to function");
+}
+
+MontInt::MontInt(MontInt const & MI)
+{
+	mpi_init(&_MPI);
+	_Ctx = MI._Ctx;
+	if (mpi_copy(&_MPI, &MI._MPI) != 0)
+		throw exception("Memory allocation failed");
+}
+
+MontInt::~MontInt()
+{
+	mpi_free(&_MPI);
+}
+// Вернуть обычное значение числа (A mod N)
+BigInteger MontInt::ToBigInteger()
+{
+	BigInteger Res = BigInteger();
+	if (_Ctx == NULL || mpi_mont_from(&Res._MPI, &_MPI, &_Ctx->_Ctx) != 0)
+		throw exception("Bad input parameters to function");
+	return Res;
+}
+// Квадрат числа по модулю N
+MontInt MontInt::Sqr()
+{
+	_check(*this);
+	MontInt Res = MontInt(*_Ctx);
+	// Один и тот же операнд: mpi_mont_mul возводит в квадрат через mpi_montsqr
+	if (mpi_mont_mul(&Res._MPI, &_MPI, &_MPI, &_Ctx->_Ctx) != 0)
+		throw exception("Memory allocation failed");
+	return Res;
+}
+// Возвести число в степень E по модулю N
+MontInt MontInt::Pow(BigInteger const & E)
+{
+	_check(*this);
+	// Оконное возведение в степень по контексту работает с обычными
+	// значениями: A^E mod N считается от A = this * R^-1 и переводится обратно
+	BigInteger A = ToBigInteger();
+	BigInteger X = BigInteger();
+	if (mpi_exp_mod_ctx(&X._MPI, &A._MPI, &E._MPI, &_Ctx->_Ctx) != 0)
+		throw exception("Bad input parameters to function");
+	return MontInt(X, *_Ctx);
+}
+
+MontInt MontInt::operator=(MontInt const & MI)
+{
+	if (this != &MI)
+	{
+		if (mpi_copy(&_MPI, &MI._MPI) != 0)
+			throw exception("Memory allocation failed");
+		_Ctx = MI._Ctx;
+	}
+	return *this;
+}
+
+MontInt MontInt::operator+(MontInt const & MI)
+{
+	_check(MI);
+	MontInt Res = MontInt(*_Ctx);
+	mpi_mont_add(&Res._MPI, &_MPI, &MI._MPI, &_Ctx->_Ctx);
+	return Res;
+}
+
+MontInt MontInt::operator-(MontInt const & MI)
+{
+	_check(MI);
+	MontInt Res = MontInt(*_Ctx);
+	mpi_mont_sub(&Res._MPI, &_MPI, &MI._MPI, &_Ctx->_Ctx);
+	return Res;
+}
+
+MontInt MontInt::operator*(MontInt const & MI)
+{
+	_check(MI);
+	MontInt Res = MontInt(*_Ctx);
+	mpi_mont_mul(&Res._MPI, &_MPI, &MI._MPI, &_Ctx->_Ctx);
+	return Res;
+}
+
+bool MontInt::operator==(MontInt const & MI)
+{
+	return _Ctx == MI._Ctx && !mpi_cmp_mpi(&_MPI, &MI._MPI);
+}
+
+bool MontInt::operator!=(MontInt const & MI)
+{
+	return !(*this == MI);
+}
+// Проверить, что оба числа привязаны к одному контексту
+void MontInt::_check(MontInt const & MI)
+{
+	if (_Ctx == NULL || _Ctx != MI._Ctx)
+		throw exception("MontInt values bound to different contexts");
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+#include "MpiBigInt.h"
+
+// Число в форме Монтгомери (A * R mod N), привязанное к общему контексту.
+// Преобразование выполняется только при создании и в ToBigInteger(),
+// поэтому цепочки +, -, * по одному модулю обходятся без mpi_div_mpi.
+// Контекст должен жить дольше всех привязанных к нему чисел.
+class MontInt
+{
+public:
+	mpi _MPI;
+
+	MontInt();
+	MontInt(MontgomeryContext const & MC);
+	MontInt(BigInteger const & BI, MontgomeryContext const & MC);
+	MontInt(MontInt const & MI);
+	~MontInt();
+	// Вернуть обычное значение числа (A mod N)
+	BigInteger ToBigInteger();
+	// Квадрат числа по модулю N
+	MontInt Sqr();
+	// Возвести число в степень E по модулю N
+	MontInt Pow(BigInteger const & E);
+
+	MontInt operator= (MontInt const & MI);
+	MontInt operator+ (MontInt const & MI);
+	MontInt operator- (MontInt const & MI);
+	MontInt operator* (MontInt const & MI);
+	bool operator==(MontInt const & MI);
+	bool operator!=(MontInt const & MI);
+private:
+	MontgomeryContext const * _Ctx;
+	// Проверить, что оба числа привязаны к одному контексту
+	void _check(MontInt const & MI);
+};
@@ -1,4 +1,71 @@
 #include "MpiBigInt.h"
+#include "chacha_drbg.h"
+#include "ThreadPool.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+// Общее состояние потоков NextPrime: наименьшее окно решета, в котором
+// найдено простое число. Окна после него просматривать уже не нужно
+struct PrimeSearchState
+{
+	atomic<size_t> Best;
+	atomic<int> Ret;
+	mutex Lock;
+};
+
+// Состояние одного потока NextPrime: текущее окно решета
+struct PrimeSearchWorker
+{
+	PrimeSearchState *Search;
+	size_t Window;
+};
+
+// Генератор случайных чисел потока и поколение сида, от которого он засеян
+struct RandomState
+{
+	chacha_drbg_context Ctx;
+	unsigned Generation;
+	bool Seeded;
+};
+
+static thread_local RandomState _ThreadRandom = { {}, 0, false };
+
+// Текущий сид. Поколение меняется при каждом SetRandomSeed/ResetRandomSeed,
+// и каждый поток пересевает свой генератор при следующем обращении.
+// В детерминированном режиме потоки получают номера потоков ChaCha20 по
+// порядку: 0 - поток, вызвавший SetRandomSeed, далее остальные
+static mutex _SeedLock;
+static atomic<unsigned> _SeedGeneration(0);
+static bool _SeedFixed = false;
+static unsigned long long _SeedValue = 0;
+static unsigned long long _SeedStreams = 0;
+
+// Засеять генератор потока текущим сидом (под _SeedLock)
+static int _seedThreadRandom(RandomState & R)
+{
+	int ret = 0;
+	if (_SeedFixed)
+	{
+		unsigned char Key[CHACHA_DRBG_KEY_SIZE] = { 0 };
+		for (int i = 0; i < 8; i++)
+			Key[i] = (unsigned char)(_SeedValue >> (8 * i));
+		chacha_drbg_seed(&R.Ctx, Key, _SeedStreams++);
+	}
+	else
+		ret = chacha_drbg_seed_os(&R.Ctx);
+	R.Generation = _SeedGeneration;
+	R.Seeded = (ret == 0);
+	return ret;
+}
+
+// Отмена поиска: окно дальше найденного или ошибка в другом потоке
+static int _primeSearchAbort(void *abort_state, size_t window)
+{
+	PrimeSearchWorker *W = (PrimeSearchWorker *)abort_state;
+	W->Window = window;
+	return window > W->Search->Best || W->Search->Ret != 0;
+}
 
 BigInteger::BigInteger()
 {
@@ -33,14 +100,135 @@ BigInteger::~BigInteger()
 {
 	mpi_free(&_MPI);
 }
-//     keySize 
+// Сгенерировать простое число размером keySize бит
 BigInteger BigInteger::GenPrime(int keySize, bool dhFlag)
 {
 	BigInteger Res = BigInteger();
 	mpi_gen_prime(&Res._MPI, keySize, dhFlag, _randFunc, NULL);
 	return Res;
 }
-//     E   N
+// Детерминированный режим генератора случайных чисел
+void BigInteger::SetRandomSeed(unsigned long long Seed)
+{
+	lock_guard<mutex> Guard(_SeedLock);
+	_SeedFixed = true;
+	_SeedValue = Seed;
+	_SeedStreams = 0;
+	++_SeedGeneration;
+	_seedThreadRandom(_ThreadRandom);
+}
+// Вернуть генератор случайных чисел к инициализации от ОС
+void BigInteger::ResetRandomSeed()
+{
+	lock_guard<mutex> Guard(_SeedLock);
+	_SeedFixed = false;
+	++_SeedGeneration;
+}
+// Случайные байты для функций bignum: ChaCha20 DRBG своего потока
+int BigInteger::_randFunc(void *rng_state, unsigned char *output, size_t len)
+{
+	int ret;
+	RandomState & R = _ThreadRandom;
+	((void)rng_state);
+	if (!R.Seeded || R.Generation != _SeedGeneration)
+	{
+		lock_guard<mutex> Guard(_SeedLock);
+		if ((ret = _seedThreadRandom(R)) != 0)
+			return ret;
+	}
+	return chacha_drbg_random(&R.Ctx, output, len);
+}
+// Сгенерировать простое число размером keySize бит, поиск в Threads потоках
+BigInteger BigInteger::GenPrimeParallel(int keySize, int Threads, bool dhFlag)
+{
+	if (keySize < POLARSSL_MPI_SIEVE_MIN_BITS)
+		return GenPrime(keySize, dhFlag);
+	return PrimeStart(keySize).NextPrime(Threads, dhFlag);
+}
+// Случайная начальная точка поиска простого числа размером keySize бит
+BigInteger BigInteger::PrimeStart(int keySize)
+{
+	BigInteger Res = BigInteger();
+	if (mpi_gen_prime_start(&Res._MPI, keySize, _randFunc, NULL) != 0)
+		throw exception("Bad input parameters to function");
+	return Res;
+}
+// Первое простое число, не меньшее данного, поиск в Threads потоках.
+// Поток t просматривает окна решета t, t + Threads, ...; из найденных
+// берется число из наименьшего окна, как при поиске в одном потоке
+BigInteger BigInteger::NextPrime(int Threads, bool dhFlag)
+{
+	int ret;
+	BigInteger Res = *this;
+	BigInteger Y;
+
+	if (Res < 3)
+		Res = 3;
+	// Простые, кроме самых маленьких, нечетны, безопасные равны 3 по модулю 4
+	mpi_set_bit(&Res._MPI, 0, 1);
+	if (dhFlag)
+		mpi_set_bit(&Res._MPI, 1, 1);
+	// Числа не больше границы решета проверяются по одному
+	if (mpi_cmp_int(&Res._MPI, POLARSSL_MPI_SIEVE_BOUND) <= 0)
+	{
+		while (1)
+		{
+			ret = mpi_is_prime(&Res._MPI, _randFunc, NULL);
+			if (ret == 0 && dhFlag)
+			{
+				Y = Res;
+				mpi_shift_r(&Y._MPI, 1);
+				ret = mpi_is_prime(&Y._MPI, _randFunc, NULL);
+			}
+			if (ret == 0)
+				return Res;
+			if (ret != POLARSSL_ERR_MPI_NOT_ACCEPTABLE)
+				throw exception("Bad input parameters to function");
+			Res = Res + (dhFlag ? 4 : 2);
+		}
+	}
+
+	if (Threads <= 0)
+		Threads = ThreadPool::Default().Threads();
+	if (Threads <= 1)
+	{
+		if (mpi_gen_prime_search(&Res._MPI, dhFlag, 0, 1, _randFunc, NULL, NULL, NULL) != 0)
+			throw exception("Bad input parameters to function");
+		return Res;
+	}
+
+	// Серии окон t, t + Threads, ... - блоки ParallelFor в общем пуле.
+	// Если потоков пула меньше, серии идут по очереди, и поздние серии
+	// останавливаются на окне, уже превышающем найденное
+	PrimeSearchState Search;
+	Search.Best = SIZE_MAX;
+	Search.Ret = 0;
+	BigInteger Start = Res;
+	ThreadPool::Default().ParallelFor(Threads, [&](size_t i)
+	{
+		BigInteger X = Start;
+		PrimeSearchWorker W = { &Search, 0 };
+		int ret = mpi_gen_prime_search(&X._MPI, dhFlag, (int)i, Threads,
+			_randFunc, NULL, _primeSearchAbort, &W);
+		if (ret == 0)
+		{
+			lock_guard<mutex> Guard(Search.Lock);
+			if (W.Window < Search.Best)
+			{
+				Search.Best = W.Window;
+				if (mpi_copy(&Res._MPI, &X._MPI) != 0)
+					throw exception("Memory allocation failed");
+			}
+		}
+		else if (ret != POLARSSL_ERR_MPI_ABORTED)
+		{
+			Search.Ret = ret;
+			throw exception("Bad input parameters to function");
+		}
+	}, Threads);
+	return Res;
+}
+// Возвести число в степень E по модулю N
 BigInteger BigInteger::PowAndMod(BigInteger const & E, BigInteger const & N)
 {
 	BigInteger Res = BigInteger();
@@ -48,14 +236,29 @@ BigInteger BigInteger::PowAndMod(BigInteger const & E, BigInteger const & N)
 		throw exception("Bad input parameters to function");
 	return Res;
 }
-//     -1   N
+// Возвести число в степень E по модулю, заданному контекстом Монтгомери
+BigInteger BigInteger::PowAndMod(BigInteger const & E, MontgomeryContext const & MC)
+{
+	BigInteger Res = BigInteger();
+	if (mpi_exp_mod_ctx(&Res._MPI, &_MPI, &E._MPI, &MC._Ctx) != 0)
+		throw exception("Bad input parameters to function");
+	return Res;
+}
+// Возвести число в степень -1 по модулю N
 BigInteger BigInteger::InvMod(BigInteger const & N)
 {
 	BigInteger Res = BigInteger();
 	mpi_inv_mod(&Res._MPI, &_MPI, &N._MPI);
 	return Res;
 }
-//     ,    
+// Наибольший общий делитель с числом B
+BigInteger BigInteger::Gcd(BigInteger const & B)
+{
+	BigInteger Res = BigInteger();
+	mpi_gcd(&Res._MPI, &_MPI, &B._MPI);
+	return Res;
+}
+// Необходимая длина буфера для хранения, в зависимотсти от СС
 int BigInteger::BytesCount(int radix)
 {
 	size_t CurSize = mpi_msb(&_MPI);
@@ -64,26 +267,29 @@ int BigInteger::BytesCount(int radix)
 	CurSize += 3;
 	return CurSize;
 }
-//     
+// Возвращает строку с цифрами числа
 string BigInteger::ToString(int radix)
 {
-	//    ,    
+	// Расчет необходимого размера буфера, в зависимости от СС
 	size_t CurSize = BytesCount(radix);
-	//    
+	// Выделение памяти под параметры
 	char* buf = new char[CurSize];
 	size_t* slen = new size_t(CurSize);
 	if (mpi_write_string(&_MPI, radix, buf, slen) != 0)
 		throw new exception("Some problems in ToString()");
 	return string(buf);
 }
-//  "" ,    
+// Возвращает "сырую" строку, полученную из байтов числа
 string BigInteger::ToRawString(int sizeInBytes)
 {
 	char* ByteArr = ToByteArr(sizeInBytes);
 	string res = string(ByteArr, sizeInBytes);
+	// Буфер ToByteArr больше не нужен: затираем и освобождаем
+	memset(ByteArr, 0, sizeInBytes);
+	delete[] ByteArr;
 	return res;
 }
-//    
+// Возвращает массив байт числа
 char* BigInteger::ToByteArr()
 {
 	int bufSize = mpi_size(&_MPI);
@@ -92,7 +298,7 @@ char* BigInteger::ToByteArr()
 	mpi_write_binary(&_MPI, buf, bufSize);
 	return (char*)buf;
 }
-//    ,    
+// Возвращает массив байт числа, выравненный по правому краю
 char * BigInteger::ToByteArr(int sizeInBytes)
 {
 	unsigned char *buf = new unsigned char[sizeInBytes];
@@ -233,4 +439,39 @@ void BigInteger::_swap(BigInteger &BI)
 {
 	mpi_init(&BI._MPI);
 	mpi_swap(&BI._MPI, &_MPI);
+}
+
+MontgomeryContext::MontgomeryContext()
+{
+	mpi_mont_init(&_Ctx);
+}
+
+MontgomeryContext::MontgomeryContext(BigInteger const & N)
+{
+	mpi_mont_init(&_Ctx);
+	Setup(N);
+}
+
+MontgomeryContext::MontgomeryContext(MontgomeryContext const & MC)
+{
+	mpi_mont_init(&_Ctx);
+	mpi_mont_copy(&_Ctx, &MC._Ctx);
+}
+
+MontgomeryContext::~MontgomeryContext()
+{
+	mpi_mont_free(&_Ctx);
+}
+// Подготовить контекст для модуля N
+void MontgomeryContext::Setup(BigInteger const & N)
+{
+	if (mpi_mont_setup(&_Ctx, &N._MPI) != 0)
+		throw exception("Bad modulus for Montgomery context");
+}
+
+MontgomeryContext MontgomeryContext::operator=(MontgomeryContext const & MC)
+{
+	if (this != &MC)
+		mpi_mont_copy(&_Ctx, &MC._Ctx);
+	return *this;
 }
\ No newline at end of file
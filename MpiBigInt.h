@@ -5,6 +5,8 @@
 #include <time.h>
 using namespace std;
 
+class MontgomeryContext;
+
 class BigInteger
 {
 public:
@@ -16,27 +18,45 @@ public:
 	BigInteger(int Num);
 	BigInteger(double Num);
 	~BigInteger();
-	//     keySize 
+	// Сгенерировать простое число размером keySize бит
 	BigInteger GenPrime(int keySize, bool dhFlag=0);
-	//     E   N
+	// Сгенерировать простое число размером keySize бит, поиск в Threads
+	// потоках ThreadPool::Default() (0 - во всех)
+	BigInteger GenPrimeParallel(int keySize, int Threads=0, bool dhFlag=0);
+	// Случайная начальная точка поиска простого числа размером keySize бит
+	BigInteger PrimeStart(int keySize);
+	// Первое простое число, не меньшее данного, поиск в Threads потоках
+	// ThreadPool::Default() (0 - во всех). Результат не зависит от числа
+	// потоков
+	BigInteger NextPrime(int Threads=0, bool dhFlag=0);
+	// Возвести число в степень E по модулю N
 	BigInteger PowAndMod(BigInteger const & E, BigInteger const & N);
-	//     -1   N
+	// Возвести число в степень E по модулю, заданному контекстом Монтгомери
+	BigInteger PowAndMod(BigInteger const & E, MontgomeryContext const & MC);
+	// Возвести число в степень -1 по модулю N
 	BigInteger InvMod(BigInteger const & N);
-	//     ,    
+	// Наибольший общий делитель с числом B
+	BigInteger Gcd(BigInteger const & B);
+	// Детерминированный режим генератора случайных чисел: при одном и том же
+	// Seed вызывающий поток получает те же случайные числа и те же ключи
+	static void SetRandomSeed(unsigned long long Seed);
+	// Вернуть генератор случайных чисел к инициализации от ОС
+	static void ResetRandomSeed();
+	// Необходимая длина буфера для хранения, в зависимотсти от СС
 	int BytesCount(int radix=10);
 
-	//     
+	// Возвращает строку с цифрами числа
 	string	ToString(int radix = 10);
-	//  "" ,    
+	// Возвращает "сырую" строку, полученную из байтов числа
 	string	ToRawString(int sizeInBytes);
-	//    
+	// Возвращает массив байт числа
 	char* ToByteArr();
-	//    ,    
+	// Возвращает массив байт числа, выравненный по правому краю
 	char* ToByteArr(int sizeInBytes);
 
-	//  BigInteger   
+	// Инициализировать BigInteger из массива байт
 	BigInteger FromByteArr(char* ByteArr, int sizeInBytes);
-	//  BigInteger  "" 
+	// Инициализировать BigInteger из "сырой" строки
 	BigInteger FromRawString(string RawString);
 
 	BigInteger operator= (BigInteger const & BI);
@@ -58,13 +78,23 @@ public:
 	bool operator<=(BigInteger const & BI);
 private:
 	void _swap(BigInteger &BI);
-	static int _randFunc(void *rng_state, unsigned char *output, size_t len)
-	{
-		size_t i;
-		if (rng_state != NULL)
-			rng_state = NULL;
-		for (i = 0; i < len; ++i)
-			output[i] = rand();
-		return(0);
-	}
+	// Случайные байты для функций bignum: ChaCha20 DRBG своего потока
+	static int _randFunc(void *rng_state, unsigned char *output, size_t len);
+};
+
+// Контекст Монтгомери для модуля N: N, mm и R^2 mod N вычисляются
+// один раз и используются во всех PowAndMod по этому модулю
+class MontgomeryContext
+{
+public:
+	mpi_mont_ctx _Ctx;
+
+	MontgomeryContext();
+	MontgomeryContext(BigInteger const & N);
+	MontgomeryContext(MontgomeryContext const & MC);
+	~MontgomeryContext();
+	// Подготовить контекст для модуля N
+	void Setup(BigInteger const & N);
+
+	MontgomeryContext operator= (MontgomeryContext const & MC);
 };
@@ -0,0 +1,192 @@
+#include "PrimePool.h"
+#include "chacha_drbg.h"
+#include <chrono>
+
+PrimePool::PrimePool(size_t LowWater, size_t HighWater, int Threads)
+{
+	if (HighWater < 1)
+		HighWater = 1;
+	if (LowWater >= HighWater)
+		LowWater = HighWater - 1;
+	if (Threads <= 0)
+		Threads = thread::hardware_concurrency() / 2;
+	if (Threads < 1)
+		Threads = 1;
+	_LowWater = LowWater;
+	_HighWater = HighWater;
+	_Threads = Threads;
+	_Stop = false;
+}
+
+PrimePool::~PrimePool()
+{
+	{
+		lock_guard<mutex> Guard(_Lock);
+		_Stop = true;
+	}
+	_Wake.notify_all();
+	for (size_t i = 0; i < _Workers.size(); i++)
+		_Workers[i].join();
+}
+// Поддерживать запас простых чисел размером Bits бит
+void PrimePool::AddSize(int Bits)
+{
+	if (Bits < 3 || Bits > POLARSSL_MPI_MAX_BITS)
+		throw exception("Bad input parameters to function");
+	{
+		lock_guard<mutex> Guard(_Lock);
+		if (_Queues.count(Bits) == 0)
+		{
+			_Queue & Q = _Queues[Bits];
+			Q.Refilling = true;
+			Q.InFlight = 0;
+			Q.Generated = Q.Taken = Q.Misses = Q.Failures = 0;
+			Q.FailStreak = 0;
+			Q.Seconds = 0;
+		}
+		// Потоки запускаются с первым размером: пустой пул ничего не стоит
+		while ((int)_Workers.size() < _Threads)
+			_Workers.push_back(thread(&PrimePool::_work, this));
+	}
+	_Wake.notify_all();
+}
+// Есть ли в пуле очередь для размера Bits
+bool PrimePool::Has(int Bits)
+{
+	lock_guard<mutex> Guard(_Lock);
+	return _Queues.count(Bits) != 0;
+}
+// Взять простое число размером Bits бит
+BigInteger PrimePool::Take(int Bits)
+{
+	BigInteger Res;
+	{
+		lock_guard<mutex> Guard(_Lock);
+		map<int, _Queue>::iterator It = _Queues.find(Bits);
+		if (It != _Queues.end())
+		{
+			_Queue & Q = It->second;
+			if (!Q.Primes.empty())
+			{
+				Res = Q.Primes.front();
+				Q.Primes.pop_front();
+				Q.Taken++;
+				if (Q.Primes.size() <= _LowWater && !Q.Refilling)
+				{
+					Q.Refilling = true;
+					_Wake.notify_all();
+				}
+				return Res;
+			}
+			Q.Misses++;
+			Q.Refilling = true;
+			_Wake.notify_all();
+		}
+	}
+	// Очередь пуста или размер не задан: ищем сразу
+	return Res.GenPrimeParallel(Bits);
+}
+// Метрики очереди размера Bits
+PrimePool::Stats PrimePool::GetStats(int Bits)
+{
+	Stats S = { 0, 0, 0, 0, 0, 0 };
+	lock_guard<mutex> Guard(_Lock);
+	map<int, _Queue>::iterator It = _Queues.find(Bits);
+	if (It == _Queues.end())
+		return S;
+	_Queue & Q = It->second;
+	S.Depth = Q.Primes.size();
+	S.Generated = Q.Generated;
+	S.Taken = Q.Taken;
+	S.Misses = Q.Misses;
+	S.Failures = Q.Failures;
+	S.RefillRate = (Q.Seconds > 0) ? Q.Generated / Q.Seconds : 0;
+	return S;
+}
+// Общий пул, из которого берут простые числа конструкторы RSACrypter
+PrimePool & PrimePool::Default()
+{
+	static PrimePool Pool;
+	return Pool;
+}
+// Размер, который нужно пополнять, или 0 (под _Lock)
+int PrimePool::_nextRefill()
+{
+	map<int, _Queue>::iterator It;
+	for (It = _Queues.begin(); It != _Queues.end(); ++It)
+	{
+		_Queue & Q = It->second;
+		if (Q.Refilling && Q.Primes.size() + Q.InFlight < _HighWater)
+			return It->first;
+	}
+	return 0;
+}
+// Отмена поиска при остановке пула
+int PrimePool::_abortFunc(void *abort_state, size_t window)
+{
+	((void)window);
+	return ((PrimePool *)abort_state)->_Stop;
+}
+// Цикл фонового потока
+void PrimePool::_work()
+{
+	chacha_drbg_context Rng;
+	bool Seeded = false;
+
+	unique_lock<mutex> Guard(_Lock);
+	while (!_Stop)
+	{
+		int Bits = _nextRefill();
+		if (Bits == 0)
+		{
+			_Wake.wait(Guard);
+			continue;
+		}
+		_Queues[Bits].InFlight++;
+		Guard.unlock();
+
+		chrono::steady_clock::time_point Start = chrono::steady_clock::now();
+		BigInteger P;
+		int ret = 0;
+		// Генератор засевается при первом поиске; ошибка ОС - ошибка этого
+		// поиска, следующий поиск засевает снова
+		if (!Seeded)
+		{
+			ret = chacha_drbg_seed_os(&Rng);
+			Seeded = (ret == 0);
+		}
+		// Поиск с решетом можно прервать при остановке пула
+		if (ret == 0 && Bits >= POLARSSL_MPI_SIEVE_MIN_BITS)
+		{
+			ret = mpi_gen_prime_start(&P._MPI, Bits, chacha_drbg_random, &Rng);
+			if (ret == 0)
+				ret = mpi_gen_prime_search(&P._MPI, 0, 0, 1, chacha_drbg_random, &Rng, _abortFunc, this);
+		}
+		else if (ret == 0)
+			ret = mpi_gen_prime(&P._MPI, Bits, 0, chacha_drbg_random, &Rng);
+		double Seconds = chrono::duration<double>(chrono::steady_clock::now() - Start).count();
+
+		Guard.lock();
+		_Queue & Q = _Queues[Bits];
+		Q.InFlight--;
+		// Прерван остановкой пула
+		if (ret == POLARSSL_ERR_MPI_ABORTED)
+			continue;
+		// Постоянная ошибка не должна крутить потоки вхолостую: после
+		// FAILURE_LIMIT ошибок подряд размер ждет следующего Take()
+		if (ret != 0)
+		{
+			Q.Failures++;
+			if (++Q.FailStreak >= FAILURE_LIMIT)
+				Q.Refilling = false;
+			continue;
+		}
+		Q.FailStreak = 0;
+		Q.Primes.push_back(P);
+		Q.Generated++;
+		Q.Seconds += Seconds;
+		if (Q.Primes.size() >= _HighWater)
+			Q.Refilling = false;
+	}
+	chacha_drbg_free(&Rng);
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include "MpiBigInt.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Пул готовых простых чисел. Фоновые потоки держат для каждого заданного
+// размера очередь простых чисел: когда в ней остается LowWater чисел или
+// меньше, очередь пополняется до HighWater. Take() берет число из очереди
+// за микросекунды, а при пустой очереди ищет его сразу в вызывающем потоке.
+// Фоновые потоки засеваются от ОС и не следуют BigInteger::SetRandomSeed.
+// После FAILURE_LIMIT ошибок поиска подряд размер перестает пополняться,
+// пока Take() не запросит его снова.
+class PrimePool
+{
+public:
+	// Метрики очереди одного размера
+	struct Stats
+	{
+		// Готовых простых чисел в очереди
+		size_t Depth;
+		// Сгенерировано фоновыми потоками
+		size_t Generated;
+		// Выдано через Take()
+		size_t Taken;
+		// Take() при пустой очереди
+		size_t Misses;
+		// Поисков фоновых потоков, завершившихся ошибкой
+		size_t Failures;
+		// Скорость пополнения: простых чисел в секунду работы потока
+		double RefillRate;
+	};
+
+	// LowWater, HighWater - отметки пополнения, Threads - фоновые потоки
+	// (0 - половина ядер)
+	PrimePool(size_t LowWater = 2, size_t HighWater = 8, int Threads = 1);
+	~PrimePool();
+	// Поддерживать запас простых чисел размером Bits бит
+	void AddSize(int Bits);
+	// Есть ли в пуле очередь для размера Bits
+	bool Has(int Bits);
+	// Взять простое число размером Bits бит
+	BigInteger Take(int Bits);
+	// Метрики очереди размера Bits
+	Stats GetStats(int Bits);
+
+	// Общий пул, из которого берут простые числа конструкторы RSACrypter
+	static PrimePool & Default();
+private:
+	// Очередь простых чисел одного размера
+	struct _Queue
+	{
+		deque<BigInteger> Primes;
+		// Пополняется: от LowWater до HighWater
+		bool Refilling;
+		// Чисел, которые сейчас ищут фоновые потоки
+		size_t InFlight;
+		size_t Generated, Taken, Misses, Failures;
+		// Ошибок поиска подряд
+		size_t FailStreak;
+		// Время работы фоновых потоков на эту очередь
+		double Seconds;
+	};
+
+	static const size_t FAILURE_LIMIT = 3;
+
+	size_t _LowWater, _HighWater;
+	int _Threads;
+	map<int, _Queue> _Queues;
+	vector<thread> _Workers;
+	mutex _Lock;
+	condition_variable _Wake;
+	atomic<bool> _Stop;
+
+	PrimePool(PrimePool const &);
+	PrimePool operator= (PrimePool const &);
+	// Цикл фонового потока
+	void _work();
+	// Размер, который нужно пополнять, или 0 (под _Lock)
+	int _nextRefill();
+	// Отмена поиска при остановке пула
+	static int _abortFunc(void *abort_state, size_t window);
+};
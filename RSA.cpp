@@ -1,145 +1,636 @@
 #include "RSA.h"
+#include "KeyFile.h"
+#include "chacha_drbg.h"
+#include "chachapoly.h"
+#include "PrimePool.h"
+#include "ThreadPool.h"
+#include "sha2.h"
+#include <chrono>
 
 RSACrypter::RSACrypter()
 {
-	_P = _P.GenPrime(_KeySize);
-	_Q = _Q.GenPrime(_KeySize);
-	_N = _P*_Q;
-	_H = (_P - 1)*(_Q - 1);
-	_E = _E.GenPrime(_KeySize);
-	_D = _E.InvMod(_H);
-	_KeySize = DEFAULT_KEY_SIZE;
-	_FillChar = '\0';
+	_Defaults('\0');
+	_StartKey(DEFAULT_KEY_SIZE, 0, KEYGEN_SYNC);
 }
 
 RSACrypter::RSACrypter(int KeySize)
 {
 	if (KeySize < 8) KeySize = 8;
-	_P = _P.GenPrime(KeySize);
-	_Q = _Q.GenPrime(KeySize);
-	_N = _P*_Q;
-	_H = (_P - 1)*(_Q - 1);
-	_E = _E.GenPrime(KeySize);
-	_D = _E.InvMod(_H);
-	_KeySize = KeySize;
-	_FillChar = '\0';
+	_Defaults('\0');
+	_StartKey(KeySize, 0, KEYGEN_SYNC);
 }
 
 RSACrypter::RSACrypter(int KeySize, char FillChar)
 {
 	if (KeySize < 8) KeySize = 8;
-	_P = _P.GenPrime(KeySize);
-	_Q = _Q.GenPrime(KeySize);
-	_N = _P*_Q;
-	_H = (_P - 1)*(_Q - 1);
-	_E = _E.GenPrime(KeySize);
-	_D = _E.InvMod(_H);
-	_KeySize = KeySize;
-	_FillChar = FillChar;
+	_Defaults(FillChar);
+	_StartKey(KeySize, 0, KEYGEN_SYNC);
 }
 
-RSACrypter::~RSACrypter()
+RSACrypter::RSACrypter(int KeySize, char FillChar, int PublicExp)
 {
+	if (KeySize < 8) KeySize = 8;
+	if (PublicExp != 0 && (PublicExp < 3 || PublicExp % 2 == 0))
+		throw exception("Bad public exponent: must be odd and at least 3");
+	_Defaults(FillChar);
+	_StartKey(KeySize, PublicExp, KEYGEN_SYNC);
 }
 
-string RSACrypter::Encrypt(string M)
+RSACrypter::RSACrypter(int KeySize, char FillChar, int PublicExp, KeyGenMode Mode)
 {
-	int BytesInBlock = _KeySize / 8;
-	while (M.length() % BytesInBlock != 0)
-	{
-		M = M + _FillChar;
-	}
-	string Res = "";
-	string Enc = "";
-	string Block;
-	BigInteger EncInt;
-	BigInteger MessageInt;
-	int BlocksCount = M.length() / BytesInBlock;
+	if (KeySize < 8) KeySize = 8;
+	if (PublicExp != 0 && (PublicExp < 3 || PublicExp % 2 == 0))
+		throw exception("Bad public exponent: must be odd and at least 3");
+	_Defaults(FillChar);
+	_StartKey(KeySize, PublicExp, Mode);
+}
 
-	for (int i = 0; i < BlocksCount; i++) {
-		Block = string(M, i*BytesInBlock,BytesInBlock);
-		MessageInt = MessageInt.FromRawString(Block);
-		EncInt = MessageInt.PowAndMod(_E, _N);
-		Enc = EncInt.ToRawString(BytesInBlock*DELTA);
-		Res = Res + Enc;
-	}
+RSACrypter::RSACrypter(string KeyFileName)
+{
+	_Defaults('\0');
+	_SetKeyReady(make_shared<RSAKey>(KeyFileName));
+}
+
+RSACrypter::RSACrypter(string KeyFileName, char FillChar)
+{
+	_Defaults(FillChar);
+	_SetKeyReady(make_shared<RSAKey>(KeyFileName));
+}
+
+// Готовый ключ, общий с другими RSACrypter
+RSACrypter::RSACrypter(shared_ptr<const RSAKey> Key)
+{
+	_Defaults('\0');
+	_SetKeyReady(Key);
+}
+
+RSACrypter::RSACrypter(shared_ptr<const RSAKey> Key, char FillChar)
+{
+	_Defaults(FillChar);
+	_SetKeyReady(Key);
+}
+
+// Копия разделяет ключ (и его генерацию) с исходным объектом
+RSACrypter::RSACrypter(RSACrypter const & R)
+{
+	_FillChar = R._FillChar;
+	_ParallelCRT = R._ParallelCRT;
+	_SignMode = R._SignMode;
+	_CryptMode = R._CryptMode;
+	_Threads = R._Threads;
+	_KeyReady = R._KeyReady;
+	_KeyPtr = R._KeyPtr.load();
+}
+
+string RSACrypter::Encrypt(string M) const
+{
+	RSAKey const & K = _Key();
+	if (_CryptMode == CRYPT_HYBRID)
+		return _EncryptHybrid(K, M);
+	size_t PlainBytes, CipherBytes;
+	_BlockSizes(K, PlainBytes, CipherBytes);
+	if (M.length() % PlainBytes != 0)
+		M.append(PlainBytes - M.length() % PlainBytes, _FillChar);
+	size_t BlocksCount = M.length() / PlainBytes;
+	// Каждый блок пишется сразу на свое место в результате
+	string Res(BlocksCount * CipherBytes, '\0');
+	_EncryptBlocks(K, (const unsigned char *)M.data(), BlocksCount, (unsigned char *)&Res[0]);
 	return Res;
 }
 
-string RSACrypter::Decryt(string C)
+string RSACrypter::Decryt(string C) const
 {
-	int BytesInBlock = _KeySize / 8;
-	if (C.length() % BytesInBlock != 0)
+	RSAKey const & K = _Key();
+	if (_CryptMode == CRYPT_HYBRID)
+		return _DecryptHybrid(K, C);
+	size_t PlainBytes, CipherBytes;
+	_BlockSizes(K, PlainBytes, CipherBytes);
+	// Шифртекст - целые блоки; неполный последний блок - ошибка, как и в
+	// RSAStream::Finish
+	if (C.length() % CipherBytes != 0)
 		throw exception("Bad input data: wrong size of chipertext");
-	int BlocksCount = C.length() / BytesInBlock / DELTA;
-	string Res = "";
-	string Dec = "";
-	string Block;
-	BigInteger DecInt;
-	BigInteger ChiperInt;
-
-	for (int i = 0; i < BlocksCount; i++) {
-		Block = string(C, i*BytesInBlock*DELTA, BytesInBlock*DELTA);
-		ChiperInt = ChiperInt.FromRawString(Block);
-		DecInt = ChiperInt.PowAndMod(_D, _N);
-
-		Dec = DecInt.ToRawString(BytesInBlock);
-		Res = Res + Dec;
-	}
+	size_t BlocksCount = C.length() / CipherBytes;
+	string Res(BlocksCount * PlainBytes, '\0');
+	_DecryptBlocks(K, (const unsigned char *)C.data(), BlocksCount, (unsigned char *)&Res[0]);
 	return Res;
 }
 
-string RSACrypter::Sign(string M)
+string RSACrypter::Sign(string M) const
 {
-	int BytesInBlock = _KeySize / 8;
-	while (M.length() % BytesInBlock != 0)
+	RSAKey const & K = _Key();
+	if (_SignMode == SIGN_SHA256)
 	{
-		M = M + _FillChar;
+		BigInteger EM = _EncodeDigest(K, M);
+		string Res(mpi_size(&K._N._MPI), '\0');
+		_WriteBlock(_PrivateOp(K, EM), (unsigned char *)&Res[0], Res.length());
+		return Res;
 	}
-	string Res = "";
-	string Signed = "";
-	string Block;
-	BigInteger SignedInt;
-	BigInteger MessageInt;
+	int BytesInBlock = K._KeySize / 8;
+	if (M.length() % BytesInBlock != 0)
+		M.append(BytesInBlock - M.length() % BytesInBlock, _FillChar);
 	int BlocksCount = M.length() / BytesInBlock;
+	string Res(BlocksCount * BytesInBlock * DELTA, '\0');
+	unsigned char *Out = (unsigned char *)&Res[0];
 
-	for (int i = 0; i < BlocksCount; i++) {
-		Block = string(M, i*BytesInBlock, BytesInBlock);
-		MessageInt = MessageInt.FromRawString(Block);
-		SignedInt = MessageInt.PowAndMod(_D, _N);
-		Signed = SignedInt.ToRawString(BytesInBlock*DELTA);
-		Res = Res + Signed;
-	}
+	_ForEachBlock(BlocksCount, [&](size_t i)
+	{
+		BigInteger MessageInt;
+		MessageInt = MessageInt.FromRawString(string(M, i*BytesInBlock, BytesInBlock));
+		BigInteger SignedInt = _PrivateOp(K, MessageInt);
+		_WriteBlock(SignedInt, Out + i*BytesInBlock*DELTA, BytesInBlock*DELTA);
+	});
 	return Res;
 }
 
-bool RSACrypter::Verify(string M, string S)
+bool RSACrypter::Verify(string M, string S) const
 {
-	bool IsValid = false;
-	int BytesInBlock = _KeySize / 8;
-	while (M.length() % BytesInBlock != 0)
+	RSAKey const & K = _Key();
+	if (_SignMode == SIGN_SHA256)
 	{
-		M = M + _FillChar;
+		if (S.length() != mpi_size(&K._N._MPI))
+			return false;
+		BigInteger SInt;
+		SInt = SInt.FromRawString(S);
+		if (mpi_cmp_mpi(&SInt._MPI, &K._N._MPI) >= 0)
+			return false;
+		return SInt.PowAndMod(K._E, K._MontN) == _EncodeDigest(K, M);
 	}
+	int BytesInBlock = K._KeySize / 8;
+	if (M.length() % BytesInBlock != 0)
+		M.append(BytesInBlock - M.length() % BytesInBlock, _FillChar);
 	if (S.length() % BytesInBlock != 0)
 		throw exception("Bad input data: wrong size of chipertext");
 
 	int BlocksCount = S.length() / BytesInBlock / DELTA;
-	string ResM = "";		//M'
-	string ResBlock = "";	// M'
-	string MesBlock;		// 
-	BigInteger ResInt;
-	BigInteger SignedInt;
-
-	for (int i = 0; i < BlocksCount; i++) {
-		MesBlock = string(S, i*BytesInBlock*DELTA, BytesInBlock*DELTA);
-		SignedInt = SignedInt.FromRawString(MesBlock);
-		
-		ResInt = SignedInt.PowAndMod(_E, _N);
-
-		ResBlock = ResInt.ToRawString(BytesInBlock);
-		ResM = ResM + ResBlock;
+	string ResM(BlocksCount * BytesInBlock, '\0');	//M'
+	unsigned char *Out = (unsigned char *)&ResM[0];
+
+	_ForEachBlock(BlocksCount, [&](size_t i)
+	{
+		BigInteger SignedInt;
+		SignedInt = SignedInt.FromRawString(string(S, i*BytesInBlock*DELTA, BytesInBlock*DELTA));
+		BigInteger ResInt = SignedInt.PowAndMod(K._E, K._MontN);
+		_WriteBlock(ResInt, Out + i*BytesInBlock, BytesInBlock);
+	});
+	return ResM == M;
+}
+// Готов ли ключ. Не ждет и не запускает отложенную генерацию
+bool RSACrypter::Ready() const
+{
+	return _KeyReady.wait_for(chrono::seconds(0)) == future_status::ready;
+}
+// Результат генерации ключа: get() дожидается его (в режиме KEYGEN_LAZY
+// запускает генерацию) и передает ее исключение
+shared_future<shared_ptr<const RSAKey> > RSACrypter::KeyFuture() const
+{
+	return _KeyReady;
+}
+// Ключ; дожидается генерации
+shared_ptr<const RSAKey> RSACrypter::Key() const
+{
+	return _KeyReady.get();
+}
+// Включить или выключить вычисление половин CRT в двух потоках
+// ThreadPool::Default()
+void RSACrypter::SetParallelCRT(bool Parallel)
+{
+	_ParallelCRT = Parallel;
+}
+// Записать ключ вместе с параметрами CRT и контекстами Монтгомери
+void RSACrypter::SaveKey(string FileName) const
+{
+	_Key().Save(FileName);
+}
+// Выбрать режим подписи для Sign и Verify
+void RSACrypter::SetSignMode(SignMode Mode)
+{
+	_SignMode = Mode;
+}
+// Потоков для блоков Encrypt, Decryt, Sign и Verify
+void RSACrypter::SetThreads(int Threads)
+{
+	_Threads = (Threads < 0) ? 0 : Threads;
+}
+// Выбрать режим шифрования для Encrypt и Decryt
+void RSACrypter::SetCryptMode(CryptMode Mode)
+{
+	_CryptMode = Mode;
+}
+// Настройки по умолчанию
+void RSACrypter::_Defaults(char FillChar)
+{
+	_FillChar = FillChar;
+	_ParallelCRT = false;
+	_SignMode = SIGN_BLOCKS;
+	_CryptMode = CRYPT_BLOCKS;
+	_Threads = 1;
+	_KeyPtr = NULL;
+}
+// Запустить генерацию ключа в заданном режиме
+void RSACrypter::_StartKey(int KeySize, int PublicExp, KeyGenMode Mode)
+{
+	if (Mode == KEYGEN_SYNC)
+	{
+		_SetKeyReady(make_shared<RSAKey>(KeySize, PublicExp));
+		return;
+	}
+	// Генерация пишет только в новый RSAKey, а не в этот объект
+	_KeyReady = async(Mode == KEYGEN_ASYNC ? launch::async : launch::deferred, [KeySize, PublicExp]()
+	{
+		return shared_ptr<const RSAKey>(make_shared<RSAKey>(KeySize, PublicExp));
+	}).share();
+}
+// Ключ готов
+void RSACrypter::_SetKeyReady(shared_ptr<const RSAKey> Key)
+{
+	promise<shared_ptr<const RSAKey> > Done;
+	Done.set_value(Key);
+	_KeyReady = Done.get_future().share();
+}
+// Ключ; при первом обращении дожидается генерации
+RSAKey const & RSACrypter::_Key() const
+{
+	RSAKey const *K = _KeyPtr.load(memory_order_acquire);
+	if (K == NULL)
+	{
+		K = _KeyReady.get().get();
+		_KeyPtr.store(K, memory_order_release);
+	}
+	return *K;
+}
+// Сгенерировать ключ. PublicExp - фиксированная открытая экспонента,
+// 0 - случайное простое число длиной KeySize бит
+RSAKey::RSAKey(int KeySize, int PublicExp)
+{
+	_KeySize = KeySize;
+	_GenKey(KeySize, PublicExp);
+}
+// Готовый ключ; параметры CRT и контексты Монтгомери вычисляются
+RSAKey::RSAKey(int KeySize, BigInteger const & N, BigInteger const & E, BigInteger const & D,
+	BigInteger const & P, BigInteger const & Q)
+{
+	_KeySize = KeySize;
+	_N = N;
+	_E = E;
+	_D = D;
+	_P = P;
+	_Q = Q;
+	_Prepare();
+}
+// Ключ из файла, записанного Save; недостающие параметры вычисляются
+RSAKey::RSAKey(string FileName)
+{
+	KeyFile KF;
+	KF.Open(FileName);
+	_KeySize = KF.KeySize();
+	KF.Get(KEYFILE_N, _N);
+	KF.Get(KEYFILE_E, _E);
+	KF.Get(KEYFILE_D, _D);
+	KF.Get(KEYFILE_P, _P);
+	KF.Get(KEYFILE_Q, _Q);
+	if (KF.Has(KEYFILE_DP) && KF.Has(KEYFILE_DQ) && KF.Has(KEYFILE_QP))
+	{
+		KF.Get(KEYFILE_DP, _DP);
+		KF.Get(KEYFILE_DQ, _DQ);
+		KF.Get(KEYFILE_QP, _QP);
+	}
+	else
+	{
+		_DP = _D % (_P - 1);
+		_DQ = _D % (_Q - 1);
+		_QP = _Q.InvMod(_P);
 	}
-	if (ResM == M) IsValid = true;
-	return IsValid;
+	// Сохраненные контексты Монтгомери избавляют от вычисления R^2 mod N
+	if (KF.Has(KEYFILE_MONT_N))
+		KF.Get(KEYFILE_MONT_N, _MontN, _N);
+	else
+		_MontN.Setup(_N);
+	if (KF.Has(KEYFILE_MONT_P))
+		KF.Get(KEYFILE_MONT_P, _MontP, _P);
+	else
+		_MontP.Setup(_P);
+	if (KF.Has(KEYFILE_MONT_Q))
+		KF.Get(KEYFILE_MONT_Q, _MontQ, _Q);
+	else
+		_MontQ.Setup(_Q);
+}
+// Размер ключа в битах
+int RSAKey::KeySize() const
+{
+	return _KeySize;
+}
+// Записать ключ вместе с параметрами CRT и контекстами Монтгомери
+void RSAKey::Save(string FileName) const
+{
+	KeyFile KF;
+	KF.Put(KEYFILE_N, _N);
+	KF.Put(KEYFILE_E, _E);
+	KF.Put(KEYFILE_D, _D);
+	KF.Put(KEYFILE_P, _P);
+	KF.Put(KEYFILE_Q, _Q);
+	KF.Put(KEYFILE_DP, _DP);
+	KF.Put(KEYFILE_DQ, _DQ);
+	KF.Put(KEYFILE_QP, _QP);
+	KF.Put(KEYFILE_MONT_N, _MontN);
+	KF.Put(KEYFILE_MONT_P, _MontP);
+	KF.Put(KEYFILE_MONT_Q, _MontQ);
+	KF.Save(FileName, _KeySize);
+}
+// Сгенерировать ключ: P, Q, E, D и параметры CRT
+void RSAKey::_GenKey(int KeySize, int PublicExp)
+{
+	// Фиксированная E задается до P и Q: простые подбираются под нее
+	if (PublicExp != 0)
+		_E = PublicExp;
+	// Размеры, заданные в PrimePool::Default(), берут готовые простые
+	// из пула; неподходящие под E отбрасываются
+	if (PrimePool::Default().Has(KeySize))
+	{
+		_P = _TakePrimeForE(KeySize);
+		do
+		{
+			_Q = _TakePrimeForE(KeySize);
+		} while (_Q == _P);
+	}
+	else
+	{
+		// Начальные точки P и Q выбираются здесь, а сами поиски идут
+		// одновременно в ThreadPool::Default(), каждый в половине потоков.
+		// ParallelFor дожидается обоих и передает исключение вызывающему
+		BigInteger StartP = _P.PrimeStart(KeySize);
+		BigInteger StartQ = _Q.PrimeStart(KeySize);
+		int Threads = ThreadPool::Default().Threads() / 2;
+		if (Threads < 1)
+			Threads = 1;
+		ThreadPool::Default().ParallelFor(2, [&](size_t i)
+		{
+			if (i == 0)
+				_P = _NextPrimeForE(StartP, Threads);
+			else
+				_Q = _NextPrimeForE(StartQ, Threads);
+		}, 2);
+		while (_Q == _P)
+			_Q = _NextPrimeForE(_Q + 2, Threads);
+	}
+	_N = _P*_Q;
+	// H = lcm(P-1, Q-1): D по этому модулю короче, чем по (P-1)(Q-1)
+	_H = (_P - 1)*(_Q - 1) / (_P - 1).Gcd(_Q - 1);
+	if (PublicExp == 0)
+		_E = PrimePool::Default().Take(KeySize);
+	_D = _E.InvMod(_H);
+	_Prepare();
+}
+// Параметры CRT и контексты Монтгомери по N, D, P и Q
+void RSAKey::_Prepare()
+{
+	// Параметры CRT: dP = D mod (P-1), dQ = D mod (Q-1), qInv = Q^-1 mod P
+	_DP = _D % (_P - 1);
+	_DQ = _D % (_Q - 1);
+	_QP = _Q.InvMod(_P);
+	_MontN.Setup(_N);
+	_MontP.Setup(_P);
+	_MontQ.Setup(_Q);
+}
+// Простое P из пула, такое что gcd(E, P-1) = 1
+BigInteger RSAKey::_TakePrimeForE(int KeySize)
+{
+	BigInteger P = PrimePool::Default().Take(KeySize);
+	if (mpi_cmp_int(&_E._MPI, 0) == 0)
+		return P;
+	while (!((P - 1).Gcd(_E) == 1))
+		P = PrimePool::Default().Take(KeySize);
+	return P;
+}
+// Первое простое P, не меньшее Start, такое что gcd(E, P-1) = 1
+BigInteger RSAKey::_NextPrimeForE(BigInteger Start, int Threads)
+{
+	BigInteger P = Start.NextPrime(Threads);
+	// Случайная E (еще не задана) взаимно проста с P-1 по построению
+	if (mpi_cmp_int(&_E._MPI, 0) == 0)
+		return P;
+	while (!((P - 1).Gcd(_E) == 1))
+		P = (P + 2).NextPrime(Threads);
+	return P;
+}
+// Операция с закрытым ключом: X^D mod N
+BigInteger RSACrypter::_PrivateOp(RSAKey const & K, BigInteger & X) const
+{
+#if defined(POLARSSL_RSA_NO_CRT)
+	return X.PowAndMod(K._D, K._MontN);
+#else
+	BigInteger M1, M2, H;
+	// M1 = X^dP mod P, M2 = X^dQ mod Q
+	if (_ParallelCRT)
+	{
+		// Половины считаются в ThreadPool::Default(): ParallelFor дожидается
+		// обеих при любом исходе и передает исключение вызывающему
+		ThreadPool::Default().ParallelFor(2, [&](size_t i)
+		{
+			if (i == 0)
+				M1 = X.PowAndMod(K._DP, K._MontP);
+			else
+				M2 = X.PowAndMod(K._DQ, K._MontQ);
+		}, 2);
+	}
+	else
+	{
+		M1 = X.PowAndMod(K._DP, K._MontP);
+		M2 = X.PowAndMod(K._DQ, K._MontQ);
+	}
+	// Garner: H = qInv * (M1 - M2) mod P, X^D = M2 + H * Q
+	H = (M1 - M2) * K._QP % K._P;
+	// На месте: присваивание в непустой BigInteger оставило бы старые limb-ы
+	if (H < 0 && mpi_add_mpi(&H._MPI, &H._MPI, &K._P._MPI) != 0)
+		throw exception("Memory allocation failed");
+	return M2 + H * K._Q;
+#endif
+}
+// Хэш SHA-256 сообщения, дополненный до длины N по PKCS #1 v1.5:
+// 00 01 FF..FF 00 DigestInfo H
+BigInteger RSACrypter::_EncodeDigest(RSAKey const & K, string M)
+{
+	// DigestInfo для SHA-256 (RFC 8017, 9.2)
+	static const unsigned char Prefix[19] = {
+		0x30, 0x31, 0x30, 0x0D, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01,
+		0x65, 0x03, 0x04, 0x02, 0x01, 0x05, 0x00, 0x04, 0x20 };
+	size_t Len = mpi_size(&K._N._MPI);
+	// Не меньше 8 байт FF
+	if (Len < 3 + 8 + sizeof(Prefix) + 32)
+		throw exception("Key is too short for SHA-256 signature");
+	string EM(Len, '\xFF');
+	EM[0] = '\0';
+	EM[1] = '\x01';
+	size_t Pos = Len - 32 - sizeof(Prefix) - 1;
+	EM[Pos++] = '\0';
+	EM.replace(Pos, sizeof(Prefix), (const char *)Prefix, sizeof(Prefix));
+	Pos += sizeof(Prefix);
+	unsigned char Hash[32];
+	sha2((const unsigned char *)M.data(), M.length(), Hash, 0);
+	EM.replace(Pos, 32, (const char *)Hash, 32);
+	BigInteger Res;
+	return Res.FromRawString(EM);
+}
+// Гибридное шифрование: обертка ключа, тег, шифртекст.
+// Ключ ChaCha20 случаен для каждого сообщения, поэтому nonce нулевой.
+// Обертка - ключ, дополненный по PKCS #1 v1.5 (00 02 PS 00 K), в степени E;
+// она же - дополнительные данные тега
+string RSACrypter::_EncryptHybrid(RSAKey const & K, string M) const
+{
+	size_t Len = mpi_size(&K._N._MPI);
+	if (Len < 11 + CHACHA20_KEY_SIZE)
+		throw exception("Key is too short for hybrid encryption");
+
+	chacha_drbg_context Rng;
+	if (chacha_drbg_seed_os(&Rng) != 0)
+		throw exception("Random source failed");
+	unsigned char Key[CHACHA20_KEY_SIZE];
+	chacha_drbg_random(&Rng, Key, sizeof(Key));
+	string EM(Len, '\0');
+	EM[1] = '\x02';
+	size_t PadEnd = Len - CHACHA20_KEY_SIZE - 1;
+	for (size_t i = 2; i < PadEnd; i++)
+	{
+		// Байты дополнения ненулевые: первый ноль отделяет ключ
+		unsigned char B = 0;
+		while (B == 0)
+			chacha_drbg_random(&Rng, &B, 1);
+		EM[i] = (char)B;
+	}
+	chacha_drbg_free(&Rng);
+	EM.replace(PadEnd + 1, CHACHA20_KEY_SIZE, (const char *)Key, CHACHA20_KEY_SIZE);
+
+	BigInteger EMInt;
+	EMInt = EMInt.FromRawString(EM);
+	EM.assign(EM.length(), '\0');
+
+	static const unsigned char Nonce[CHACHA20_NONCE_SIZE] = { 0 };
+	string Res(Len + POLY1305_MAC_SIZE + M.length(), '\0');
+	unsigned char *Out = (unsigned char *)&Res[0];
+	_WriteBlock(EMInt.PowAndMod(K._E, K._MontN), Out, Len);
+	chachapoly_encrypt(Key, Nonce, Out, Len, M.length(), (const unsigned char *)M.data(),
+		Out + Len + POLY1305_MAC_SIZE, Out + Len);
+	memset(Key, 0, sizeof(Key));
+	return Res;
+}
+string RSACrypter::_DecryptHybrid(RSAKey const & K, string C) const
+{
+	size_t Len = mpi_size(&K._N._MPI);
+	if (Len < 11 + CHACHA20_KEY_SIZE)
+		throw exception("Key is too short for hybrid encryption");
+	if (C.length() < Len + POLY1305_MAC_SIZE)
+		throw exception("Bad input data: wrong size of chipertext");
+
+	// Неявный отказ: при неверном дополнении вместо ключа из обертки берется
+	// ключ SHA-256(D, обертка), и расшифрование идет дальше без ветвлений.
+	// Любая ошибка - это ошибка тега с одним и тем же сообщением, так что
+	// расшифрование не становится оракулом дополнения (Bleichenbacher)
+	static const char *Failed = "Bad input data: authentication failed";
+	BigInteger WrappedInt;
+	WrappedInt = WrappedInt.FromRawString(string(C, 0, Len));
+	if (mpi_cmp_mpi(&WrappedInt._MPI, &K._N._MPI) >= 0)
+		throw exception(Failed);
+	// Прямо в EM: ToRawString оставил бы в куче незатертую копию ключа
+	string EM(Len, '\0');
+	_WriteBlock(_PrivateOp(K, WrappedInt), (unsigned char *)&EM[0], Len);
+
+	unsigned char Fallback[32];
+	sha2_context Sha;
+	sha2_starts(&Sha, 0);
+	sha2_update(&Sha, (const unsigned char *)K._D._MPI.p, K._D._MPI.n * sizeof(t_uint));
+	sha2_update(&Sha, (const unsigned char *)C.data(), Len);
+	sha2_finish(&Sha, Fallback);
+	memset(&Sha, 0, sizeof(Sha));
+
+	// 00 02, ненулевое дополнение (не меньше 8 байт), 00, ключ. Длина ключа
+	// постоянна, поэтому место разделителя известно заранее
+	const unsigned char *B = (const unsigned char *)EM.data();
+	size_t Sep = Len - CHACHA20_KEY_SIZE - 1;
+	unsigned char Bad = B[0] | (B[1] ^ 0x02) | B[Sep];
+	for (size_t i = 2; i < Sep; i++)
+		Bad |= (unsigned char)(((unsigned)B[i] - 1) >> 8);
+	// 0xFF при верном дополнении, иначе 0
+	unsigned char Good = (unsigned char)((((unsigned)Bad | (0u - (unsigned)Bad)) >> 31) - 1);
+	unsigned char Key[CHACHA20_KEY_SIZE];
+	for (size_t i = 0; i < CHACHA20_KEY_SIZE; i++)
+		Key[i] = (B[Sep + 1 + i] & Good) | (Fallback[i] & (unsigned char)~Good);
+	EM.assign(EM.length(), '\0');
+	memset(Fallback, 0, sizeof(Fallback));
+
+	static const unsigned char Nonce[CHACHA20_NONCE_SIZE] = { 0 };
+	const unsigned char *In = (const unsigned char *)C.data();
+	size_t MLen = C.length() - Len - POLY1305_MAC_SIZE;
+	string Res(MLen, '\0');
+	int ret = chachapoly_decrypt(Key, Nonce, In, Len, In + Len, MLen,
+		In + Len + POLY1305_MAC_SIZE, (unsigned char *)&Res[0]);
+	memset(Key, 0, sizeof(Key));
+	if (ret != 0)
+		throw exception(Failed);
+	return Res;
+}
+// Размеры блока открытого текста и шифртекста. CRYPT_BLOCKS: KeySize/8
+// байт и вдвое больше (DELTA). CRYPT_PACKED: блок открытого текста на байт
+// короче N, поэтому всегда меньше N, а блок шифртекста ровно mpi_size(N)
+// байт. Последний блок дополняется _FillChar в обоих режимах
+void RSACrypter::_BlockSizes(RSAKey const & K, size_t & PlainBytes, size_t & CipherBytes) const
+{
+	if (_CryptMode == CRYPT_PACKED)
+	{
+		CipherBytes = mpi_size(&K._N._MPI);
+		PlainBytes = CipherBytes - 1;
+	}
+	else
+	{
+		PlainBytes = K._KeySize / 8;
+		CipherBytes = PlainBytes * DELTA;
+	}
+}
+// Зашифровать Count блоков открытого текста In в блоки шифртекста Out
+void RSACrypter::_EncryptBlocks(RSAKey const & K, const unsigned char *In, size_t Count,
+	unsigned char *Out) const
+{
+	size_t PlainBytes, CipherBytes;
+	_BlockSizes(K, PlainBytes, CipherBytes);
+	_ForEachBlock(Count, [&](size_t i)
+	{
+		BigInteger MessageInt;
+		MessageInt = MessageInt.FromRawString(string((const char *)In + i * PlainBytes, PlainBytes));
+		BigInteger EncInt = MessageInt.PowAndMod(K._E, K._MontN);
+		_WriteBlock(EncInt, Out + i * CipherBytes, CipherBytes);
+	});
+}
+// Расшифровать Count блоков шифртекста In в блоки открытого текста Out
+void RSACrypter::_DecryptBlocks(RSAKey const & K, const unsigned char *In, size_t Count,
+	unsigned char *Out) const
+{
+	size_t PlainBytes, CipherBytes;
+	_BlockSizes(K, PlainBytes, CipherBytes);
+	_ForEachBlock(Count, [&](size_t i)
+	{
+		BigInteger ChiperInt;
+		ChiperInt = ChiperInt.FromRawString(string((const char *)In + i * CipherBytes, CipherBytes));
+		if (mpi_cmp_mpi(&ChiperInt._MPI, &K._N._MPI) >= 0)
+			throw exception("Bad input data: block is not less than N");
+		BigInteger DecInt = _PrivateOp(K, ChiperInt);
+		// Блок не из Encrypt: открытый текст не помещается в блок
+		if (mpi_size(&DecInt._MPI) > PlainBytes)
+			throw exception("Bad input data: decrypted block is too long");
+		_WriteBlock(DecInt, Out + i * PlainBytes, PlainBytes);
+	});
+}
+// Выполнить Body для блоков 0 .. Count-1: в вызывающем потоке или в
+// ThreadPool::Default() не больше чем в _Threads потоках
+void RSACrypter::_ForEachBlock(size_t Count, function<void(size_t)> const & Body) const
+{
+	if (_Threads == 1)
+	{
+		for (size_t i = 0; i < Count; i++)
+			Body(i);
+		return;
+	}
+	ThreadPool::Default().ParallelFor(Count, Body, _Threads);
+}
+// Записать X в Size байт по адресу Out (старшие байты первыми)
+void RSACrypter::_WriteBlock(BigInteger const & X, unsigned char *Out, size_t Size)
+{
+	mpi_write_binary(&X._MPI, Out, Size);
 }
@@ -1,29 +1,169 @@
 #pragma once
 #include "MpiBigInt.h"
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
 
+// Ключ RSA: N, E, D, P, Q, параметры CRT и контексты Монтгомери. После
+// построения не меняется, поэтому один объект разделяют любые RSACrypter
+// в любых потоках без блокировок
+class RSAKey
+{
+	friend class RSACrypter;
+	friend class KeyStore;
+public:
+	// Сгенерировать ключ. PublicExp - фиксированная открытая экспонента,
+	// 0 - случайное простое число длиной KeySize бит
+	RSAKey(int KeySize, int PublicExp);
+	// Готовый ключ; параметры CRT и контексты Монтгомери вычисляются
+	RSAKey(int KeySize, BigInteger const & N, BigInteger const & E, BigInteger const & D,
+		BigInteger const & P, BigInteger const & Q);
+	// Ключ из файла, записанного Save; недостающие параметры вычисляются
+	RSAKey(string FileName);
+	// Размер ключа в битах
+	int KeySize() const;
+	// Записать ключ вместе с параметрами CRT и контекстами Монтгомери
+	void Save(string FileName) const;
+
+private:
+	int _KeySize;
+	BigInteger _P, _Q, _N, _H, _D, _E;
+	// Параметры CRT: D mod (P-1), D mod (Q-1), Q^-1 mod P
+	BigInteger _DP, _DQ, _QP;
+	// Контекст Монтгомери для модуля _N, строится один раз на ключ
+	MontgomeryContext _MontN;
+	// Контексты Монтгомери для половин CRT
+	MontgomeryContext _MontP, _MontQ;
+
+	RSAKey(RSAKey const &);
+	RSAKey operator= (RSAKey const &);
+	// Сгенерировать ключ: P, Q, E, D и параметры CRT
+	void _GenKey(int KeySize, int PublicExp);
+	// Параметры CRT и контексты Монтгомери по N, D, P и Q
+	void _Prepare();
+	// Простое P из пула, такое что gcd(E, P-1) = 1
+	BigInteger _TakePrimeForE(int KeySize);
+	// Первое простое P, не меньшее Start, такое что gcd(E, P-1) = 1
+	BigInteger _NextPrimeForE(BigInteger Start, int Threads);
+};
+
+// Шифрование и подпись ключом RSAKey. Encrypt, Decryt, Sign, Verify и
+// остальные const-методы можно вызывать для одного объекта из многих
+// потоков одновременно: ключ не меняется, рабочие числа у каждого вызова
+// свои. Set-методы меняют настройки объекта и вызываются до того, как
+// он станет общим; копия разделяет ключ и стоит дешево, поэтому потоку со
+// своими настройками проще взять копию
 class RSACrypter
 {
+	friend class KeyStore;
+	friend class RSAStream;
 public:
+	// Режим генерации ключа:
+	// KEYGEN_SYNC  - в конструкторе;
+	// KEYGEN_ASYNC - в фоновом потоке, конструктор возвращается сразу;
+	// KEYGEN_LAZY  - при первой операции или KeyFuture().get(),
+	//                неиспользованный ключ не генерируется вовсе.
+	// Операции шифрования и подписи дожидаются ключа сами
+	enum KeyGenMode { KEYGEN_SYNC, KEYGEN_ASYNC, KEYGEN_LAZY };
+	// Режим подписи:
+	// SIGN_BLOCKS - каждый блок сообщения возводится в степень D;
+	// SIGN_SHA256 - подписывается только хэш SHA-256 сообщения
+	//               (PKCS #1 v1.5), одно возведение в степень на сообщение
+	enum SignMode { SIGN_BLOCKS, SIGN_SHA256 };
+	// Режим шифрования:
+	// CRYPT_BLOCKS - каждый блок сообщения возводится в степень E;
+	// CRYPT_HYBRID - RSA шифрует только случайный ключ, сообщение
+	//                шифруется ChaCha20-Poly1305 под этим ключом;
+	// CRYPT_PACKED - блоки по mpi_size(N)-1 байт, шифртекст по mpi_size(N)
+	//                байт на блок, без удвоения DELTA
+	enum CryptMode { CRYPT_BLOCKS, CRYPT_HYBRID, CRYPT_PACKED };
+
 	RSACrypter();
 	RSACrypter(int KeySize);
 	RSACrypter(int KeySize, char FillChar);
-	~RSACrypter();
-	string Encrypt(string M);
-	string Decryt(string C);
-	string Sign(string M);
-	bool Verify(string M, string S);
+	// PublicExp - фиксированная открытая экспонента (3, 65537, ...),
+	// 0 - случайное простое число длиной KeySize бит
+	RSACrypter(int KeySize, char FillChar, int PublicExp);
+	RSACrypter(int KeySize, char FillChar, int PublicExp, KeyGenMode Mode);
+	// Ключ из файла, записанного SaveKey
+	RSACrypter(string KeyFileName);
+	RSACrypter(string KeyFileName, char FillChar);
+	// Готовый ключ, общий с другими RSACrypter
+	RSACrypter(shared_ptr<const RSAKey> Key);
+	RSACrypter(shared_ptr<const RSAKey> Key, char FillChar);
+	// Копия разделяет ключ (и его генерацию) с исходным объектом
+	RSACrypter(RSACrypter const & R);
+	string Encrypt(string M) const;
+	string Decryt(string C) const;
+	string Sign(string M) const;
+	bool Verify(string M, string S) const;
+	// Готов ли ключ. Не ждет и не запускает отложенную генерацию
+	bool Ready() const;
+	// Результат генерации ключа: get() дожидается его (в режиме KEYGEN_LAZY
+	// запускает генерацию) и передает ее исключение
+	shared_future<shared_ptr<const RSAKey> > KeyFuture() const;
+	// Ключ; дожидается генерации
+	shared_ptr<const RSAKey> Key() const;
+	// Включить или выключить вычисление половин CRT в двух потоках
+	// ThreadPool::Default()
+	void SetParallelCRT(bool Parallel);
+	// Выбрать режим подписи для Sign и Verify
+	void SetSignMode(SignMode Mode);
+	// Потоков для блоков Encrypt, Decryt, Sign и Verify: 1 - только
+	// вызывающий (по умолчанию), 0 - все потоки ThreadPool::Default()
+	void SetThreads(int Threads);
+	// Выбрать режим шифрования для Encrypt и Decryt
+	void SetCryptMode(CryptMode Mode);
+	// Записать ключ вместе с параметрами CRT и контекстами Монтгомери
+	void SaveKey(string FileName) const;
 
 private:
-	//     ( )
+	// Размер ключа в битах (по умолчанию)
 	const int DEFAULT_KEY_SIZE = 512;
-	//     1  ( MPI)
-	// - .  mpi_write_binary  mpi_read_binary
+	// Количество байт для хранения 1 символа (особенности MPI)
+	// - см. функции mpi_write_binary и mpi_read_binary
 	const int DELTA = 2;
-	int _KeySize;
 	char _FillChar;
-	BigInteger _P, _Q, _N, _H, _D, _E;
-	BigInteger MessageInt, EncInt, DecInt;
-	BigInteger SignedInt;
-	
+	// Считать половины CRT в двух потоках
+	bool _ParallelCRT;
+	// Режим Sign и Verify
+	SignMode _SignMode;
+	// Режим Encrypt и Decryt
+	CryptMode _CryptMode;
+	// Потоков для блоков (SetThreads)
+	int _Threads;
+
+	// Ключ, которого дожидаются операции
+	shared_future<shared_ptr<const RSAKey> > _KeyReady;
+	// Готовый ключ из _KeyReady: после первой операции следующие берут его
+	// без обращения к future
+	mutable atomic<RSAKey const *> _KeyPtr;
 
+	RSACrypter operator= (RSACrypter const &);
+	// Настройки по умолчанию
+	void _Defaults(char FillChar);
+	// Запустить генерацию ключа в заданном режиме
+	void _StartKey(int KeySize, int PublicExp, KeyGenMode Mode);
+	// Ключ готов
+	void _SetKeyReady(shared_ptr<const RSAKey> Key);
+	// Ключ; при первом обращении дожидается генерации
+	RSAKey const & _Key() const;
+	// Операция с закрытым ключом: X^D mod N
+	BigInteger _PrivateOp(RSAKey const & K, BigInteger & X) const;
+	// Хэш SHA-256 сообщения, дополненный до длины N по PKCS #1 v1.5
+	static BigInteger _EncodeDigest(RSAKey const & K, string M);
+	// Гибридное шифрование: обертка ключа, тег, шифртекст
+	string _EncryptHybrid(RSAKey const & K, string M) const;
+	string _DecryptHybrid(RSAKey const & K, string C) const;
+	// Размеры блока открытого текста и шифртекста в CRYPT_BLOCKS и CRYPT_PACKED
+	void _BlockSizes(RSAKey const & K, size_t & PlainBytes, size_t & CipherBytes) const;
+	// Зашифровать Count блоков открытого текста In в блоки шифртекста Out
+	void _EncryptBlocks(RSAKey const & K, const unsigned char *In, size_t Count, unsigned char *Out) const;
+	// Расшифровать Count блоков шифртекста In в блоки открытого текста Out
+	void _DecryptBlocks(RSAKey const & K, const unsigned char *In, size_t Count, unsigned char *Out) const;
+	// Выполнить Body для блоков 0 .. Count-1 в _Threads потоках
+	void _ForEachBlock(size_t Count, function<void(size_t)> const & Body) const;
+	// Записать X в Size байт по адресу Out (старшие байты первыми)
+	static void _WriteBlock(BigInteger const & X, unsigned char *Out, size_t Size);
 };
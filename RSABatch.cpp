@@ -0,0 +1,103 @@
+#include "RSABatch.h"
+#include <algorithm>
+
+RSABatch::RSABatch(KeyStore & Store, ThreadPool & Pool) : _Store(Store), _Pool(Pool)
+{
+}
+
+RSABatch::~RSABatch()
+{
+	Submit();
+}
+// Добавить операцию с результатом типа T
+template <class T> future<T> RSABatch::_add(string Id, function<T(RSACrypter const &)> Op)
+{
+	shared_ptr<promise<T> > Result = make_shared<promise<T> >();
+	_Op O;
+	O.Id = Id;
+	O.Run = [Result, Op](RSACrypter const *R, exception_ptr Error)
+	{
+		if (Error)
+		{
+			Result->set_exception(Error);
+			return;
+		}
+		try
+		{
+			Result->set_value(Op(*R));
+		}
+		catch (...)
+		{
+			Result->set_exception(current_exception());
+		}
+	};
+	_Ops.push_back(O);
+	return Result->get_future();
+}
+// Зашифровать M ключом Id
+future<string> RSABatch::Encrypt(string Id, string M)
+{
+	return _add<string>(Id, [M](RSACrypter const & R) { return R.Encrypt(M); });
+}
+// Расшифровать C ключом Id
+future<string> RSABatch::Decryt(string Id, string C)
+{
+	return _add<string>(Id, [C](RSACrypter const & R) { return R.Decryt(C); });
+}
+// Подписать M ключом Id
+future<string> RSABatch::Sign(string Id, string M)
+{
+	return _add<string>(Id, [M](RSACrypter const & R) { return R.Sign(M); });
+}
+// Проверить подпись S сообщения M ключом Id
+future<bool> RSABatch::Verify(string Id, string M, string S)
+{
+	return _add<bool>(Id, [M, S](RSACrypter const & R) { return R.Verify(M, S); });
+}
+// Отправить накопленные операции в пул
+void RSABatch::Submit()
+{
+	if (_Ops.empty())
+		return;
+	shared_ptr<vector<_Op> > Ops = make_shared<vector<_Op> >();
+	Ops->swap(_Ops);
+	// Операции одного ключа подряд, в порядке добавления
+	stable_sort(Ops->begin(), Ops->end(), [](_Op const & A, _Op const & B) { return A.Id < B.Id; });
+
+	KeyStore *Store = &_Store;
+	size_t Threads = _Pool.Threads();
+	for (size_t Begin = 0; Begin < Ops->size(); )
+	{
+		size_t End = Begin;
+		while (End < Ops->size() && (*Ops)[End].Id == (*Ops)[Begin].Id)
+			End++;
+		// Группа делится на части, чтобы один ключ мог занять все потоки
+		size_t Parts = min(End - Begin, Threads);
+		size_t PartSize = (End - Begin + Parts - 1) / Parts;
+		for (size_t From = Begin; From < End; From += PartSize)
+		{
+			size_t To = min(From + PartSize, End);
+			_Pool.Submit([Ops, Store, From, To]()
+			{
+				shared_ptr<const RSACrypter> R;
+				exception_ptr Error;
+				try
+				{
+					R = Store->Get((*Ops)[From].Id);
+				}
+				catch (...)
+				{
+					Error = current_exception();
+				}
+				for (size_t i = From; i < To; i++)
+					(*Ops)[i].Run(R.get(), Error);
+			});
+		}
+		Begin = End;
+	}
+}
+// Операций, ожидающих Submit()
+size_t RSABatch::Pending()
+{
+	return _Ops.size();
+}
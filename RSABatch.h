@@ -0,0 +1,51 @@
+#pragma once
+#include "KeyStore.h"
+#include "ThreadPool.h"
+#include <future>
+#include <memory>
+#include <vector>
+
+// Пакет независимых операций RSA над ключами из KeyStore. Encrypt, Decryt,
+// Sign и Verify только добавляют операцию и сразу возвращают future
+// результата; Submit() отправляет накопленное в пул.
+//
+// Операции группируются по ключу: операции одного ключа идут подряд одной
+// задачей пула, которая берет ключ из KeyStore один раз, так что его
+// параметры и контексты Монтгомери остаются в кэше. Большая группа делится
+// на части по числу потоков пула, простаивающие потоки забирают части
+// у занятых. KeyStore должно жить, пока все future не готовы.
+class RSABatch
+{
+public:
+	RSABatch(KeyStore & Store, ThreadPool & Pool = ThreadPool::Default());
+	// Отправляет то, что не было отправлено
+	~RSABatch();
+	// Зашифровать M ключом Id
+	future<string> Encrypt(string Id, string M);
+	// Расшифровать C ключом Id
+	future<string> Decryt(string Id, string C);
+	// Подписать M ключом Id
+	future<string> Sign(string Id, string M);
+	// Проверить подпись S сообщения M ключом Id
+	future<bool> Verify(string Id, string M, string S);
+	// Отправить накопленные операции в пул
+	void Submit();
+	// Операций, ожидающих Submit()
+	size_t Pending();
+private:
+	// Одна операция. Run получает ключ или ошибку его получения
+	struct _Op
+	{
+		string Id;
+		function<void(RSACrypter const *, exception_ptr)> Run;
+	};
+
+	KeyStore & _Store;
+	ThreadPool & _Pool;
+	vector<_Op> _Ops;
+
+	RSABatch(RSABatch const &);
+	RSABatch operator= (RSABatch const &);
+	// Добавить операцию с результатом типа T
+	template <class T> future<T> _add(string Id, function<T(RSACrypter const &)> Op);
+};
@@ -0,0 +1,87 @@
+#include "RSAStream.h"
+#include "ThreadPool.h"
+#include <algorithm>
+
+RSAStream::RSAStream(RSACrypter const & R, Direction Dir, SinkFunc Sink) : _Crypter(R)
+{
+	if (R._CryptMode == RSACrypter::CRYPT_HYBRID)
+		throw exception("Streaming is not supported in hybrid mode");
+	_Key = R.Key();
+	_Dir = Dir;
+	_Sink = Sink;
+	size_t PlainBytes, CipherBytes;
+	_Crypter._BlockSizes(*_Key, PlainBytes, CipherBytes);
+	_InBlock = (Dir == STREAM_ENCRYPT) ? PlainBytes : CipherBytes;
+	_OutBlock = (Dir == STREAM_ENCRYPT) ? CipherBytes : PlainBytes;
+	// По несколько блоков на поток, чтобы потоки пула не простаивали
+	int Threads = R._Threads;
+	if (Threads == 0 || Threads > ThreadPool::Default().Threads())
+		Threads = ThreadPool::Default().Threads();
+	_Batch = 4 * Threads;
+	_Partial.reserve(_InBlock);
+	_Out.reserve(_Batch * _OutBlock);
+	_Written = 0;
+	_Finished = false;
+}
+// Обработать очередной кусок входа
+void RSAStream::Update(const char *Data, size_t Length)
+{
+	if (_Finished)
+		throw exception("Stream is finished");
+	// Сначала дополняется неполный блок от прошлого вызова
+	if (!_Partial.empty())
+	{
+		size_t Take = min(Length, _InBlock - _Partial.size());
+		_Partial.append(Data, Take);
+		Data += Take;
+		Length -= Take;
+		if (_Partial.size() < _InBlock)
+			return;
+		_process(_Partial.data(), 1);
+		_Partial.clear();
+	}
+	// Целые блоки обрабатываются прямо из входа, без копирования
+	while (Length >= _InBlock)
+	{
+		size_t Count = min(Length / _InBlock, _Batch);
+		_process(Data, Count);
+		Data += Count * _InBlock;
+		Length -= Count * _InBlock;
+	}
+	_Partial.assign(Data, Length);
+}
+
+void RSAStream::Update(string const & Data)
+{
+	Update(Data.data(), Data.length());
+}
+// Закончить поток
+void RSAStream::Finish()
+{
+	if (_Finished)
+		return;
+	_Finished = true;
+	if (_Partial.empty())
+		return;
+	if (_Dir == STREAM_DECRYPT)
+		throw exception("Bad input data: wrong size of chipertext");
+	_Partial.append(_InBlock - _Partial.size(), _Crypter._FillChar);
+	_process(_Partial.data(), 1);
+	_Partial.clear();
+}
+// Байт, отданных в Sink
+unsigned long long RSAStream::Written()
+{
+	return _Written;
+}
+// Обработать Count целых блоков и отдать результат в Sink
+void RSAStream::_process(const char *In, size_t Count)
+{
+	_Out.resize(Count * _OutBlock);
+	if (_Dir == STREAM_ENCRYPT)
+		_Crypter._EncryptBlocks(*_Key, (const unsigned char *)In, Count, (unsigned char *)&_Out[0]);
+	else
+		_Crypter._DecryptBlocks(*_Key, (const unsigned char *)In, Count, (unsigned char *)&_Out[0]);
+	_Sink(_Out.data(), _Out.length());
+	_Written += _Out.length();
+}
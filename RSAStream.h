@@ -0,0 +1,50 @@
+#pragma once
+#include "RSA.h"
+#include <functional>
+#include <string>
+
+// Потоковое шифрование и расшифрование в режимах CRYPT_BLOCKS и
+// CRYPT_PACKED. Вход подается кусками любой длины, готовые блоки сразу
+// уходят в Sink; между вызовами хранится только неполный блок. Память -
+// несколько блоков независимо от длины сообщения, результат тот же, что
+// у Encrypt и Decryt для всего сообщения.
+//
+// Настройки и ключ берутся из RSACrypter при создании потока.
+class RSAStream
+{
+public:
+	// Направление потока
+	enum Direction { STREAM_ENCRYPT, STREAM_DECRYPT };
+	// Приемник готовых данных
+	typedef function<void(const char *Data, size_t Length)> SinkFunc;
+
+	RSAStream(RSACrypter const & R, Direction Dir, SinkFunc Sink);
+	// Обработать очередной кусок входа
+	void Update(const char *Data, size_t Length);
+	void Update(string const & Data);
+	// Закончить поток: при шифровании последний блок дополняется
+	// FillChar, при расшифровании вход должен кончаться на границе блока
+	void Finish();
+	// Байт, отданных в Sink
+	unsigned long long Written();
+private:
+	RSACrypter _Crypter;
+	shared_ptr<const RSAKey> _Key;
+	Direction _Dir;
+	SinkFunc _Sink;
+	// Размеры блоков входа и выхода
+	size_t _InBlock, _OutBlock;
+	// Блоков за один проход через пул потоков
+	size_t _Batch;
+	// Неполный блок входа
+	string _Partial;
+	// Выход одного прохода
+	string _Out;
+	unsigned long long _Written;
+	bool _Finished;
+
+	RSAStream(RSAStream const &);
+	RSAStream operator= (RSAStream const &);
+	// Обработать Count целых блоков и отдать результат в Sink
+	void _process(const char *In, size_t Count);
+};
@@ -0,0 +1,196 @@
+#include "ThreadPool.h"
+
+// Пул и номер очереди текущего потока пула
+static thread_local ThreadPool *_CurrentPool = NULL;
+static thread_local size_t _CurrentQueue = 0;
+
+ThreadPool::ThreadPool(int Threads)
+{
+	if (Threads <= 0)
+		Threads = thread::hardware_concurrency();
+	if (Threads < 1)
+		Threads = 1;
+	_NextQueue = 0;
+	_Pending = 0;
+	_Sleeping = 0;
+	_Stop = false;
+	for (int i = 1; i < Threads; i++)
+		_Queues.push_back(unique_ptr<_Queue>(new _Queue));
+	for (size_t i = 0; i < _Queues.size(); i++)
+		_Workers.push_back(thread(&ThreadPool::_work, this, i));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		lock_guard<mutex> Guard(_SleepLock);
+		_Stop = true;
+	}
+	_Wake.notify_all();
+	for (size_t i = 0; i < _Workers.size(); i++)
+		_Workers[i].join();
+}
+// Потоков вместе с вызывающим
+int ThreadPool::Threads()
+{
+	return (int)_Workers.size() + 1;
+}
+// Поставить задачу в очередь
+void ThreadPool::Submit(function<void()> Task)
+{
+	if (_Queues.empty())
+	{
+		try
+		{
+			Task();
+		}
+		catch (...)
+		{
+		}
+		return;
+	}
+	size_t Index;
+	if (_CurrentPool == this)
+		Index = _CurrentQueue;
+	else
+		Index = _NextQueue++ % _Queues.size();
+	_Pending++;
+	{
+		lock_guard<mutex> Guard(_Queues[Index]->Lock);
+		_Queues[Index]->Tasks.push_back(move(Task));
+	}
+	// Поток, увеличивший _Sleeping, после этого еще раз проверит _Pending,
+	// поэтому будить надо только если кто-то уже засыпает
+	if (_Sleeping > 0)
+	{
+		{
+			lock_guard<mutex> Guard(_SleepLock);
+		}
+		_Wake.notify_one();
+	}
+}
+// Выполнить Body для блоков 0 .. Count-1 не больше чем в MaxThreads
+// потоках (0 - во всех)
+void ThreadPool::ParallelFor(size_t Count, function<void(size_t)> const & Body, int MaxThreads)
+{
+	if (MaxThreads <= 0 || MaxThreads > Threads())
+		MaxThreads = Threads();
+	if ((size_t)MaxThreads > Count)
+		MaxThreads = (int)Count;
+	// Один поток: без задания и синхронизации
+	if (MaxThreads <= 1)
+	{
+		for (size_t i = 0; i < Count; i++)
+			Body(i);
+		return;
+	}
+
+	shared_ptr<_Job> Job = make_shared<_Job>();
+	Job->Body = &Body;
+	Job->Count = Count;
+	Job->Next = 0;
+	Job->Done = 0;
+	Job->Failed = false;
+	for (int i = 1; i < MaxThreads; i++)
+		Submit([Job]() { _run(*Job); });
+
+	_run(*Job);
+
+	// Блоки розданы, ждем завершения взятых другими потоками
+	{
+		unique_lock<mutex> Guard(Job->Lock);
+		while (Job->Done < Job->Count)
+			Job->Finished.wait(Guard);
+	}
+	if (Job->Error)
+		rethrow_exception(Job->Error);
+}
+// Общий пул, в котором RSACrypter обрабатывает блоки
+ThreadPool & ThreadPool::Default()
+{
+	static ThreadPool Pool;
+	return Pool;
+}
+// Выполнять блоки задания, пока они не кончатся
+void ThreadPool::_run(_Job & Job)
+{
+	for (;;)
+	{
+		size_t i = Job.Next++;
+		if (i >= Job.Count)
+			return;
+		if (!Job.Failed)
+		{
+			try
+			{
+				(*Job.Body)(i);
+			}
+			catch (...)
+			{
+				lock_guard<mutex> Guard(Job.Lock);
+				if (!Job.Error)
+					Job.Error = current_exception();
+				Job.Failed = true;
+			}
+		}
+		if (++Job.Done == Job.Count)
+		{
+			lock_guard<mutex> Guard(Job.Lock);
+			Job.Finished.notify_all();
+		}
+	}
+}
+// Взять задачу: свою с конца, иначе чужую с начала
+bool ThreadPool::_take(size_t Index, function<void()> & Task)
+{
+	for (size_t k = 0; k < _Queues.size(); k++)
+	{
+		_Queue & Q = *_Queues[(Index + k) % _Queues.size()];
+		lock_guard<mutex> Guard(Q.Lock);
+		if (Q.Tasks.empty())
+			continue;
+		if (k == 0)
+		{
+			Task = move(Q.Tasks.back());
+			Q.Tasks.pop_back();
+		}
+		else
+		{
+			Task = move(Q.Tasks.front());
+			Q.Tasks.pop_front();
+		}
+		_Pending--;
+		return true;
+	}
+	return false;
+}
+// Цикл потока пула
+void ThreadPool::_work(size_t Index)
+{
+	_CurrentPool = this;
+	_CurrentQueue = Index;
+	function<void()> Task;
+	for (;;)
+	{
+		if (_take(Index, Task))
+		{
+			try
+			{
+				Task();
+			}
+			catch (...)
+			{
+			}
+			Task = nullptr;
+			continue;
+		}
+		// Очереди пусты: при остановке выходим, иначе спим до новой задачи
+		unique_lock<mutex> Guard(_SleepLock);
+		if (_Stop)
+			return;
+		_Sleeping++;
+		if (_Pending == 0)
+			_Wake.wait(Guard);
+		_Sleeping--;
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// Пул потоков с перехватом работы (work stealing). У каждого потока пула
+// своя очередь задач под своей блокировкой: поток берет задачи с конца
+// своей очереди, а когда она пуста - крадет с начала чужих. Общей
+// блокировки на пути задачи нет, потоки создаются один раз в
+// конструкторе, а не на каждый вызов.
+//
+// ParallelFor(Count, Body) вызывает Body(0) .. Body(Count-1); номера
+// блоков раздаются через атомарный счетчик, вызывающий поток работает
+// наравне с потоками пула.
+class ThreadPool
+{
+public:
+	// Threads - потоков вместе с вызывающим (0 - по числу ядер)
+	ThreadPool(int Threads = 0);
+	~ThreadPool();
+	// Потоков вместе с вызывающим
+	int Threads();
+	// Поставить задачу в очередь. Из потока пула - в его собственную
+	// очередь, иначе - в очереди потоков по кругу. В пуле без потоков
+	// задача выполняется сразу. Исключения задачи не передаются, результат
+	// возвращайте через promise
+	void Submit(function<void()> Task);
+	// Выполнить Body для блоков 0 .. Count-1 не больше чем в MaxThreads
+	// потоках (0 - во всех). Первое исключение из Body передается
+	// вызывающему после завершения остальных блоков
+	void ParallelFor(size_t Count, function<void(size_t)> const & Body, int MaxThreads = 0);
+
+	// Общий пул, в котором RSACrypter обрабатывает блоки
+	static ThreadPool & Default();
+private:
+	// Очередь задач одного потока пула
+	struct _Queue
+	{
+		deque<function<void()> > Tasks;
+		mutex Lock;
+	};
+	// Один вызов ParallelFor. Помощники в очередях держат его через
+	// shared_ptr и могут запуститься после возврата из ParallelFor - тогда
+	// блоков им уже не достанется и Body они не трогают
+	struct _Job
+	{
+		function<void(size_t)> const * Body;
+		size_t Count;
+		// Следующий свободный блок
+		atomic<size_t> Next;
+		// Завершенных блоков
+		atomic<size_t> Done;
+		// После ошибки оставшиеся блоки пропускаются
+		atomic<bool> Failed;
+		exception_ptr Error;
+		mutex Lock;
+		condition_variable Finished;
+	};
+
+	vector<thread> _Workers;
+	vector<unique_ptr<_Queue> > _Queues;
+	// Очередь для следующей задачи извне пула
+	atomic<size_t> _NextQueue;
+	// Задач в очередях
+	atomic<size_t> _Pending;
+	// Потоков, собирающихся уснуть
+	atomic<int> _Sleeping;
+	atomic<bool> _Stop;
+	// Только для сна простаивающих потоков
+	mutex _SleepLock;
+	condition_variable _Wake;
+
+	ThreadPool(ThreadPool const &);
+	ThreadPool operator= (ThreadPool const &);
+	// Цикл потока пула
+	void _work(size_t Index);
+	// Взять задачу: свою с конца, иначе чужую с начала
+	bool _take(size_t Index, function<void()> & Task);
+	// Выполнять блоки задания, пока они не кончатся
+	static void _run(_Job & Job);
+};
@@ -36,6 +36,7 @@
 
 #include "bignum.h"
 #include "bn_mul.h"
+#include "bn_avx.h"
 
 #include <stdlib.h>
 
@@ -927,13 +928,54 @@ int mpi_sub_int( mpi *X, const mpi *A, t_sint b )
     return( mpi_sub_mpi( X, A, &_B ) );
 }
 
+#if defined(MULADDC_HUIT_ADX)
+
+#include <cpuid.h>
+
+/*
+ * Check for BMI2 (mulx) and ADX (adcx, adox): CPUID.(EAX=7,ECX=0):EBX
+ * bits 8 and 19
+ */
+static int mpi_check_adx( void )
+{
+    unsigned int a, b, c, d;
+
+    if( __get_cpuid_max( 0, NULL ) < 7 )
+        return( 0 );
+
+    __cpuid_count( 7, 0, a, b, c, d );
+
+    return( ( b & ( 1u << 8 ) ) != 0 && ( b & ( 1u << 19 ) ) != 0 );
+}
+
+static int mpi_has_adx( void )
+{
+    static const int has_adx = mpi_check_adx();
+
+    return( has_adx );
+}
+
+#endif
+
 /*
  * Helper for mpi multiplication
- */ 
+ */
 static void mpi_mul_hlp( size_t i, t_uint *s, t_uint *d, t_uint b )
 {
     t_uint c = 0, t = 0;
 
+#if defined(MULADDC_HUIT_ADX)
+    if( mpi_has_adx() )
+    {
+        for( ; i >= 8; i -= 8 )
+        {
+            MULADDC_INIT
+            MULADDC_HUIT_ADX
+            MULADDC_STOP
+        }
+    }
+#endif
+
 #if defined(MULADDC_HUIT)
     for( ; i >= 8; i -= 8 )
     {
@@ -991,13 +1033,221 @@ static void mpi_mul_hlp( size_t i, t_uint *s, t_uint *d, t_uint b )
     while( c != 0 );
 }
 
+/*
+ * Helper for Karatsuba multiplication: d = s + d over n limbs,
+ * the carry is propagated into d beyond n limbs
+ */
+static void mpi_add_hlp( size_t n, const t_uint *s, t_uint *d )
+{
+    size_t i;
+    t_uint c, t;
+
+    for( i = c = 0; i < n; i++, s++, d++ )
+    {
+        t = *s + c;  c  = ( t < c );
+        *d += t;     c += ( *d < t );
+    }
+
+    while( c != 0 )
+    {
+        *d += c; c = ( *d < c ); d++;
+    }
+}
+
+/*
+ * Helper for Karatsuba multiplication: d = |x - y|, where x has xn limbs,
+ * y has yn <= xn limbs and d has room for xn limbs.
+ * Returns 1 if x >= y, -1 otherwise.
+ */
+static int mpi_absdiff_hlp( t_uint *d, const t_uint *x, size_t xn,
+                            const t_uint *y, size_t yn )
+{
+    size_t i;
+    int s = 1;
+
+    for( i = xn; i > 0; i-- )
+    {
+        t_uint yi = ( i <= yn ) ? y[i - 1] : 0;
+
+        if( x[i - 1] != yi )
+        {
+            s = ( x[i - 1] > yi ) ? 1 : -1;
+            break;
+        }
+    }
+
+    if( s > 0 )
+    {
+        memcpy( d, x, xn * ciL );
+        mpi_sub_hlp( yn, (t_uint *) y, d );
+    }
+    else
+    {
+        /* x < y implies that the top xn - yn limbs of x are zero */
+        memcpy( d, y, yn * ciL );
+        memset( d + yn, 0, ( xn - yn ) * ciL );
+        mpi_sub_hlp( xn, (t_uint *) x, d );
+    }
+
+    return( s );
+}
+
+/*
+ * Scratch space (in limbs) needed by mpi_kara_mul() for n-limb operands
+ */
+static size_t mpi_kara_ws( size_t n )
+{
+    size_t h;
+
+    if( n < POLARSSL_MPI_KARATSUBA_CUTOFF )
+        return( 0 );
+
+    h = n - n / 2;
+
+    return( 6 * h + 1 + mpi_kara_ws( h ) );
+}
+
+/*
+ * Karatsuba multiplication: r[0..2n) = a[0..n) * b[0..n)
+ *
+ * With a = a1*B^m + a0 and b = b1*B^m + b0, the middle term is computed
+ * as a0*b0 + a1*b1 - (a1 - a0)*(b1 - b0), so that every partial product
+ * stays within the operand size (no carry limb on the half sums).
+ * ws must hold mpi_kara_ws( n ) limbs and must not overlap r, a or b.
+ */
+static void mpi_kara_mul( t_uint *r, const t_uint *a, const t_uint *b,
+                          size_t n, t_uint *ws )
+{
+    size_t m, h;
+    int sa, sb;
+    t_uint *da, *db, *t, *mid;
+
+    if( n < POLARSSL_MPI_KARATSUBA_CUTOFF )
+    {
+        memset( r, 0, 2 * n * ciL );
+
+        for( m = n; m > 0; m-- )
+            mpi_mul_hlp( n, (t_uint *) a, r + m - 1, b[m - 1] );
+
+        return;
+    }
+
+    m = n / 2;
+    h = n - m;
+
+    da  = ws;
+    db  = da + h;
+    t   = db + h;
+    mid = t + 2 * h;
+    ws  = mid + 2 * h + 1;
+
+    sa = mpi_absdiff_hlp( da, a + m, h, a, m );
+    sb = mpi_absdiff_hlp( db, b + m, h, b, m );
+
+    /*
+     * r = a1*b1 * B^2m + a0*b0, t = |a1 - a0| * |b1 - b0|
+     */
+    mpi_kara_mul( r, a, b, m, ws );
+    mpi_kara_mul( r + 2 * m, a + m, b + m, h, ws );
+    mpi_kara_mul( t, da, db, h, ws );
+
+    /*
+     * mid = a0*b0 + a1*b1 -/+ t = a0*b1 + a1*b0
+     */
+    memcpy( mid, r + 2 * m, 2 * h * ciL );
+    mid[2 * h] = 0;
+    mpi_add_hlp( 2 * m, r, mid );
+
+    if( sa == sb )
+        mpi_sub_hlp( 2 * h, t, mid );
+    else
+        mpi_add_hlp( 2 * h, t, mid );
+
+    mpi_add_hlp( 2 * h + 1, mid, r + m );
+}
+
+/*
+ * Helper for mpi squaring: r[0..2n) += a[0..n)^2, r must be zeroed
+ *
+ * The cross products a[i]*a[j], i < j, are accumulated once and doubled
+ * with a one bit shift, then the squares a[i]^2 are added on the diagonal.
+ */
+static void mpi_sqr_hlp( size_t n, const t_uint *a, t_uint *r )
+{
+    size_t i;
+    t_uint c, t;
+
+    if( n == 0 )
+        return;
+
+    for( i = 0; i < n - 1; i++ )
+        mpi_mul_hlp( n - i - 1, (t_uint *) a + i + 1, r + 2 * i + 1, a[i] );
+
+    for( i = c = 0; i < 2 * n; i++ )
+    {
+        t = r[i] >> ( biL - 1 );
+        r[i] = ( r[i] << 1 ) | c;
+        c = t;
+    }
+
+    for( i = 0; i < n; i++ )
+        mpi_mul_hlp( 1, (t_uint *) a + i, r + 2 * i, a[i] );
+}
+
+/*
+ * Karatsuba squaring: r[0..2n) = a[0..n)^2
+ *
+ * Same as mpi_kara_mul() with a == b: the middle term is
+ * a0^2 + a1^2 - (a1 - a0)^2, so that the subtraction is unconditional.
+ * ws must hold mpi_kara_ws( n ) limbs and must not overlap r or a.
+ */
+static void mpi_kara_sqr( t_uint *r, const t_uint *a, size_t n, t_uint *ws )
+{
+    size_t m, h;
+    t_uint *da, *t, *mid;
+
+    if( n < POLARSSL_MPI_KARATSUBA_CUTOFF )
+    {
+        memset( r, 0, 2 * n * ciL );
+        mpi_sqr_hlp( n, a, r );
+        return;
+    }
+
+    m = n / 2;
+    h = n - m;
+
+    da  = ws;
+    t   = da + 2 * h;
+    mid = t + 2 * h;
+    ws  = mid + 2 * h + 1;
+
+    mpi_absdiff_hlp( da, a + m, h, a, m );
+
+    mpi_kara_sqr( r, a, m, ws );
+    mpi_kara_sqr( r + 2 * m, a + m, h, ws );
+    mpi_kara_sqr( t, da, h, ws );
+
+    memcpy( mid, r + 2 * m, 2 * h * ciL );
+    mid[2 * h] = 0;
+    mpi_add_hlp( 2 * m, r, mid );
+    mpi_sub_hlp( 2 * h, t, mid );
+
+    mpi_add_hlp( 2 * h + 1, mid, r + m );
+}
+
 /*
  * Baseline multiplication: X = A * B  (HAC 14.12)
+ *
+ * Operands of at least POLARSSL_MPI_KARATSUBA_CUTOFF limbs are multiplied
+ * with Karatsuba, the longer one being split in chunks the size of the
+ * shorter one.
  */
 int mpi_mul_mpi( mpi *X, const mpi *A, const mpi *B )
 {
     int ret;
-    size_t i, j;
+    size_t i, j, k, off, wsn = 0;
+    const t_uint *L, *S;
+    t_uint *ws = NULL;
     mpi TA, TB;
 
     mpi_init( &TA ); mpi_init( &TB );
@@ -1016,18 +1266,104 @@ int mpi_mul_mpi( mpi *X, const mpi *A, const mpi *B )
     MPI_CHK( mpi_grow( X, i + j ) );
     MPI_CHK( mpi_lset( X, 0 ) );
 
-    for( i++; j > 0; j-- )
-        mpi_mul_hlp( i - 1, A->p, X->p + j - 1, B->p[j - 1] );
+    if( i >= POLARSSL_MPI_KARATSUBA_CUTOFF &&
+        j >= POLARSSL_MPI_KARATSUBA_CUTOFF )
+    {
+        /*
+         * From here on the longer operand L has i limbs, the shorter S k
+         */
+        if( i >= j ) { L = A->p; S = B->p; k = j; }
+        else         { L = B->p; S = A->p; k = i; i = j; }
+
+        wsn = 2 * k + mpi_kara_ws( k );
+
+        if( ( ws = (t_uint *) malloc( wsn * ciL ) ) == NULL )
+        {
+            ret = POLARSSL_ERR_MPI_MALLOC_FAILED;
+            goto cleanup;
+        }
+
+        for( off = 0; off + k <= i; off += k )
+        {
+            mpi_kara_mul( ws, L + off, S, k, ws + 2 * k );
+            mpi_add_hlp( 2 * k, ws, X->p + off );
+        }
+
+        for( ; off < i; off++ )
+            mpi_mul_hlp( k, (t_uint *) S, X->p + off, L[off] );
+    }
+    else
+    {
+        for( i++; j > 0; j-- )
+            mpi_mul_hlp( i - 1, A->p, X->p + j - 1, B->p[j - 1] );
+    }
 
     X->s = A->s * B->s;
 
 cleanup:
 
+    if( ws != NULL )
+    {
+        memset( ws, 0, wsn * ciL );
+        free( ws );
+    }
+
     mpi_free( &TB ); mpi_free( &TA );
 
     return( ret );
 }
 
+/*
+ * Squaring: X = A * A  (HAC 14.16)
+ */
+int mpi_sqr( mpi *X, const mpi *A )
+{
+    int ret;
+    size_t i, wsn = 0;
+    t_uint *ws = NULL;
+    mpi TA;
+
+    mpi_init( &TA );
+
+    if( X == A ) { MPI_CHK( mpi_copy( &TA, A ) ); A = &TA; }
+
+    for( i = A->n; i > 0; i-- )
+        if( A->p[i - 1] != 0 )
+            break;
+
+    MPI_CHK( mpi_grow( X, 2 * i ) );
+    MPI_CHK( mpi_lset( X, 0 ) );
+
+    if( i >= POLARSSL_MPI_KARATSUBA_CUTOFF )
+    {
+        wsn = mpi_kara_ws( i );
+
+        if( ( ws = (t_uint *) malloc( wsn * ciL ) ) == NULL )
+        {
+            ret = POLARSSL_ERR_MPI_MALLOC_FAILED;
+            goto cleanup;
+        }
+
+        mpi_kara_sqr( X->p, A->p, i, ws );
+    }
+    else
+        mpi_sqr_hlp( i, A->p, X->p );
+
+    X->s = 1;
+
+cleanup:
+
+    if( ws != NULL )
+    {
+        memset( ws, 0, wsn * ciL );
+        free( ws );
+    }
+
+    mpi_free( &TA );
+
+    return( ret );
+}
+
 /*
  * Baseline multiplication: X = A * b
  */
@@ -1363,6 +1699,43 @@ static void mpi_montmul( mpi *A, const mpi *B, const mpi *N, t_uint mm, const mp
         mpi_sub_hlp( n, A->p, T->p );
 }
 
+/*
+ * Montgomery squaring: A = A * A * R^-1 mod N
+ *
+ * The square is computed first with mpi_sqr_hlp(), then reduced
+ * one limb at a time (separated operand scanning).
+ * T must hold at least 2 * N->n + 2 limbs.
+ */
+static void mpi_montsqr( mpi *A, const mpi *N, t_uint mm, const mpi *T )
+{
+    size_t i, n;
+    t_uint u, *d;
+
+    memset( T->p, 0, T->n * ciL );
+
+    d = T->p;
+    n = N->n;
+
+    mpi_sqr_hlp( n, A->p, d );
+
+    for( i = 0; i < n; i++ )
+    {
+        /*
+         * T = T + u*N*2^(i*biL), clears limb i of T
+         */
+        u = d[i] * mm;
+        mpi_mul_hlp( n, N->p, d + i, u );
+    }
+
+    memcpy( A->p, d + n, (n + 1) * ciL );
+
+    if( mpi_cmp_abs( A, N ) >= 0 )
+        mpi_sub_hlp( n, N->p, A->p );
+    else
+        /* prevent timing attacks */
+        mpi_sub_hlp( n, A->p, T->p );
+}
+
 /*
  * Montgomery reduction: A = A * R^-1 mod N
  */
@@ -1378,95 +1751,285 @@ static void mpi_montred( mpi *A, const mpi *N, t_uint mm, const mpi *T )
 }
 
 /*
- * Sliding-window exponentiation: X = A^E mod N  (HAC 14.85)
+ * Fixed-size Montgomery arithmetic for the usual RSA modulus sizes
+ *
+ * L is the limb count of the modulus, known at compile time: all loops
+ * have constant bounds and every temporary lives on the stack, so the
+ * exponentiation runs without mpi_grow(), heap buffers or per-call
+ * memset() of T. Operands are arrays of L limbs, fully reduced mod N.
  */
-int mpi_exp_mod( mpi *X, const mpi *A, const mpi *E, const mpi *N, mpi *_RR )
+template<size_t L>
+class FixedMont
 {
-    int ret;
-    size_t wbits, wsize, one = 1;
-    size_t i, j, nblimbs;
-    size_t bufsize, nbits;
-    t_uint ei, mm, state;
-    mpi RR, T, W[ 2 << POLARSSL_MPI_WINDOW_SIZE ];
+public:
+    FixedMont( const mpi *N, t_uint mm );
+    ~FixedMont();
 
-    if( mpi_cmp_int( N, 0 ) < 0 || ( N->p[0] & 1 ) == 0 )
-        return( POLARSSL_ERR_MPI_BAD_INPUT_DATA );
+    /* X = A * B * R^-1 mod N, X may alias A or B */
+    void mul( t_uint *X, const t_uint *A, const t_uint *B ) const;
 
-    /*
-     * Init temps and window size
-     */
-    mpi_montg_init( &mm, N );
-    mpi_init( &RR ); mpi_init( &T );
-    memset( W, 0, sizeof( W ) );
+    /* X = A * A * R^-1 mod N, X may alias A */
+    void sqr( t_uint *X, const t_uint *A ) const;
 
-    i = mpi_msb( E );
+    /* X = A * R^-1 mod N, X may alias A */
+    void red( t_uint *X, const t_uint *A ) const;
 
-    wsize = ( i > 671 ) ? 6 : ( i > 239 ) ? 5 :
-            ( i >  79 ) ? 4 : ( i >  23 ) ? 3 : 1;
+private:
+    static t_uint mla( const t_uint *src, t_uint *d, t_uint b );
+    void sub( t_uint *X, const t_uint *T ) const;
 
-    if( wsize > POLARSSL_MPI_WINDOW_SIZE )
-        wsize = POLARSSL_MPI_WINDOW_SIZE;
+    t_uint _N[L];
+    t_uint _mm;
+};
 
-    j = N->n + 1;
-    MPI_CHK( mpi_grow( X, j ) );
-    MPI_CHK( mpi_grow( &W[1],  j ) );
-    MPI_CHK( mpi_grow( &T, j * 2 ) );
+template<size_t L>
+FixedMont<L>::FixedMont( const mpi *N, t_uint mm )
+{
+    size_t i;
 
-    /*
-     * If 1st call, pre-compute R^2 mod N
-     */
-    if( _RR == NULL || _RR->p == NULL )
-    {
-        MPI_CHK( mpi_lset( &RR, 1 ) );
-        MPI_CHK( mpi_shift_l( &RR, N->n * 2 * biL ) );
-        MPI_CHK( mpi_mod_mpi( &RR, &RR, N ) );
+    for( i = 0; i < L; i++ )
+        _N[i] = ( i < N->n ) ? N->p[i] : 0;
 
-        if( _RR != NULL )
-            memcpy( _RR, &RR, sizeof( mpi ) );
-    }
-    else
-        memcpy( &RR, _RR, sizeof( mpi ) );
+    _mm = mm;
+}
 
-    /*
-     * W[1] = A * R^2 * R^-1 mod N = A * R mod N
-     */
-    if( mpi_cmp_mpi( A, N ) >= 0 )
-        mpi_mod_mpi( &W[1], A, N );
-    else   mpi_copy( &W[1], A );
+template<size_t L>
+FixedMont<L>::~FixedMont()
+{
+    size_t i;
 
-    mpi_montmul( &W[1], &RR, N, mm, &T );
+    for( i = 0; i < L; i++ )
+        _N[i] = 0;
+}
 
-    /*
-     * X = R^2 * R^-1 mod N = R mod N
-     */
-    MPI_CHK( mpi_copy( X, &RR ) );
-    mpi_montred( X, N, mm, &T );
+/*
+ * d[0..L) += src[0..L) * b, returns the carry out of d[L - 1]
+ */
+template<size_t L>
+t_uint FixedMont<L>::mla( const t_uint *src, t_uint *d, t_uint b )
+{
+    size_t i;
+    t_uint c = 0, t = 0, *s = (t_uint *) src;
 
-    if( wsize > 1 )
+#if defined(MULADDC_HUIT_ADX)
+    if( mpi_has_adx() )
     {
-        /*
-         * W[1 << (wsize - 1)] = W[1] ^ (wsize - 1)
-         */
-        j =  one << (wsize - 1);
-
-        MPI_CHK( mpi_grow( &W[j], N->n + 1 ) );
-        MPI_CHK( mpi_copy( &W[j], &W[1]    ) );
+        for( i = 0; i < L / 8; i++ )
+        {
+            MULADDC_INIT
+            MULADDC_HUIT_ADX
+            MULADDC_STOP
+        }
 
-        for( i = 0; i < wsize - 1; i++ )
-            mpi_montmul( &W[j], &W[j], N, mm, &T );
-    
-        /*
-         * W[i] = W[i - 1] * W[1]
-         */
-        for( i = j + 1; i < (one << wsize); i++ )
+        for( i = 0; i < L % 8; i++ )
         {
-            MPI_CHK( mpi_grow( &W[i], N->n + 1 ) );
-            MPI_CHK( mpi_copy( &W[i], &W[i - 1] ) );
+            MULADDC_INIT
+            MULADDC_CORE
+            MULADDC_STOP
+        }
 
-            mpi_montmul( &W[i], &W[1], N, mm, &T );
+        return( c );
+    }
+#endif
+
+#if defined(MULADDC_HUIT)
+    for( i = 0; i < L / 8; i++ )
+    {
+        MULADDC_INIT
+        MULADDC_HUIT
+        MULADDC_STOP
+    }
+#else
+    for( i = 0; i < L / 8; i++ )
+    {
+        MULADDC_INIT
+        MULADDC_CORE   MULADDC_CORE
+        MULADDC_CORE   MULADDC_CORE
+
+        MULADDC_CORE   MULADDC_CORE
+        MULADDC_CORE   MULADDC_CORE
+        MULADDC_STOP
+    }
+#endif
+
+    for( i = 0; i < L % 8; i++ )
+    {
+        MULADDC_INIT
+        MULADDC_CORE
+        MULADDC_STOP
+    }
+
+    t++;
+
+    return( c );
+}
+
+/*
+ * X = T - N if T[0..L] >= N, else X = T; both differences are computed
+ * so that the timing does not depend on the result
+ */
+template<size_t L>
+void FixedMont<L>::sub( t_uint *X, const t_uint *T ) const
+{
+    size_t i;
+    t_uint S[L], b, t, z, mask;
+
+    for( i = 0, b = 0; i < L; i++ )
+    {
+        t = T[i] - b;
+        b = ( T[i] < b );
+        z = t - _N[i];
+        b += ( t < _N[i] );
+        S[i] = z;
+    }
+
+    mask = (t_uint) 0 - (t_uint)( T[L] >= b );
+
+    for( i = 0; i < L; i++ )
+        X[i] = ( S[i] & mask ) | ( T[i] & ~mask );
+}
+
+/*
+ * Same as mpi_montmul(): T = (T + u0*B + u1*N) / 2^biL, L times.
+ * Only the L + 2 limbs ahead of d are live, so only those are cleared.
+ */
+template<size_t L>
+void FixedMont<L>::mul( t_uint *X, const t_uint *A, const t_uint *B ) const
+{
+    size_t i;
+    t_uint T[2 * L + 2], u0, u1, c, *d = T;
+
+    for( i = 0; i < L + 2; i++ )
+        T[i] = 0;
+
+    for( i = 0; i < L; i++ )
+    {
+        u0 = A[i];
+        u1 = ( d[0] + u0 * B[0] ) * _mm;
+
+        c = mla( B, d, u0 );
+        d[L] += c; d[L + 1] += ( d[L] < c );
+
+        c = mla( _N, d, u1 );
+        d[L] += c; d[L + 1] += ( d[L] < c );
+
+        d++; d[L + 1] = 0;
+    }
+
+    sub( X, d );
+}
+
+/*
+ * Same as mpi_montsqr(): square, then reduce one limb at a time
+ */
+template<size_t L>
+void FixedMont<L>::sqr( t_uint *X, const t_uint *A ) const
+{
+    size_t i, j;
+    t_uint T[2 * L + 1], c;
+
+    for( i = 0; i < 2 * L + 1; i++ )
+        T[i] = 0;
+
+    mpi_sqr_hlp( L, A, T );
+
+    for( i = 0; i < L; i++ )
+    {
+        c = mla( _N, T + i, T[i] * _mm );
+
+        for( j = i + L; c != 0; j++ )
+        {
+            T[j] += c; c = ( T[j] < c );
         }
     }
 
+    sub( X, T + L );
+}
+
+template<size_t L>
+void FixedMont<L>::red( t_uint *X, const t_uint *A ) const
+{
+    t_uint U[L] = { 1 };
+
+    mul( X, A, U );
+}
+
+/*
+ * T = W[idx] from a table of count entries of L limbs. Every entry is
+ * read and masked, so the memory access pattern does not depend on the
+ * (secret) window value.
+ */
+template<size_t L>
+static void fixed_select( t_uint *T, const t_uint (*W)[L], size_t count, size_t idx )
+{
+    size_t i, j;
+    t_uint x, mask;
+
+    for( j = 0; j < L; j++ )
+        T[j] = 0;
+
+    for( i = 0; i < count; i++ )
+    {
+        x = (t_uint)( i ^ idx );
+        mask = ( ( x | ( (t_uint) 0 - x ) ) >> ( biL - 1 ) ) - 1;
+
+        for( j = 0; j < L; j++ )
+            T[j] |= W[i][j] & mask;
+    }
+}
+
+/*
+ * Sliding-window exponentiation on FixedMont<L>, same steps as
+ * mpi_exp_mod(). A must be reduced mod N, RR = R^2 mod N with
+ * R = 2^(L * biL).
+ */
+template<size_t L>
+static int mpi_exp_mod_fixed( mpi *X, const mpi *A, const mpi *E,
+                              const mpi *N, t_uint mm, const mpi *RR )
+{
+    int ret;
+    size_t wbits, wsize, one = 1;
+    size_t i, nblimbs;
+    size_t bufsize, nbits;
+    t_uint ei, state;
+    t_uint x[L], w1[L], rr[L], t[L];
+    t_uint W[ 1 << ( POLARSSL_MPI_WINDOW_SIZE - 1 ) ][L];
+    FixedMont<L> M( N, mm );
+
+    i = mpi_msb( E );
+
+    wsize = ( i > 671 ) ? 6 : ( i > 239 ) ? 5 :
+            ( i >  79 ) ? 4 : ( i >  23 ) ? 3 : 1;
+
+    if( wsize > POLARSSL_MPI_WINDOW_SIZE )
+        wsize = POLARSSL_MPI_WINDOW_SIZE;
+
+    for( i = 0; i < L; i++ )
+    {
+        x[i]  = ( i < A->n  ) ? A->p[i]  : 0;
+        rr[i] = ( i < RR->n ) ? RR->p[i] : 0;
+    }
+
+    /*
+     * W[1] = A * R mod N, X = R mod N
+     */
+    M.mul( w1, x, rr );
+    M.red( x, rr );
+
+    /*
+     * W[i] is kept at W[i - 2^(wsize - 1)]
+     */
+    if( wsize > 1 )
+    {
+        M.sqr( W[0], w1 );
+
+        for( i = 1; i < wsize - 1; i++ )
+            M.sqr( W[0], W[0] );
+
+        for( i = 1; i < ( one << ( wsize - 1 ) ); i++ )
+            M.mul( W[i], W[i - 1], w1 );
+    }
+
     nblimbs = E->n;
     bufsize = 0;
     nbits   = 0;
@@ -1487,24 +2050,15 @@ int mpi_exp_mod( mpi *X, const mpi *A, const mpi *E, const mpi *N, mpi *_RR )
 
         ei = (E->p[nblimbs] >> bufsize) & 1;
 
-        /*
-         * skip leading 0s
-         */
         if( ei == 0 && state == 0 )
             continue;
 
         if( ei == 0 && state == 1 )
         {
-            /*
-             * out of window, square X
-             */
-            mpi_montmul( X, X, N, mm, &T );
+            M.sqr( x, x );
             continue;
         }
 
-        /*
-         * add ei to current window
-         */
         state = 2;
 
         nbits++;
@@ -1512,16 +2066,17 @@ int mpi_exp_mod( mpi *X, const mpi *A, const mpi *E, const mpi *N, mpi *_RR )
 
         if( nbits == wsize )
         {
-            /*
-             * X = X^wsize R^-1 mod N
-             */
             for( i = 0; i < wsize; i++ )
-                mpi_montmul( X, X, N, mm, &T );
+                M.sqr( x, x );
 
-            /*
-             * X = X * W[wbits] R^-1 mod N
-             */
-            mpi_montmul( X, &W[wbits], N, mm, &T );
+            if( wsize > 1 )
+            {
+                fixed_select<L>( t, W, one << ( wsize - 1 ),
+                                 wbits - ( one << ( wsize - 1 ) ) );
+                M.mul( x, x, t );
+            }
+            else
+                M.mul( x, x, w1 );
 
             state--;
             nbits = 0;
@@ -1529,88 +2084,672 @@ int mpi_exp_mod( mpi *X, const mpi *A, const mpi *E, const mpi *N, mpi *_RR )
         }
     }
 
-    /*
-     * process the remaining bits
-     */
     for( i = 0; i < nbits; i++ )
     {
-        mpi_montmul( X, X, N, mm, &T );
+        M.sqr( x, x );
 
         wbits <<= 1;
 
         if( (wbits & (one << wsize)) != 0 )
-            mpi_montmul( X, &W[1], N, mm, &T );
+            M.mul( x, x, w1 );
     }
 
-    /*
-     * X = A^E * R * R^-1 mod N = A^E mod N
-     */
-    mpi_montred( X, N, mm, &T );
-
-cleanup:
+    M.red( x, x );
 
-    for( i = (one << (wsize - 1)); i < (one << wsize); i++ )
-        mpi_free( &W[i] );
+    MPI_CHK( mpi_grow( X, L ) );
+    MPI_CHK( mpi_lset( X, 0 ) );
+    memcpy( X->p, x, L * ciL );
 
-    mpi_free( &W[1] ); mpi_free( &T );
+cleanup:
 
-    if( _RR == NULL )
-        mpi_free( &RR );
+    memset( W, 0, sizeof( W ) );
+    memset( x, 0, sizeof( x ) );
+    memset( w1, 0, sizeof( w1 ) );
+    memset( t, 0, sizeof( t ) );
 
     return( ret );
 }
 
 /*
- * Greatest common divisor: G = gcd(A, B)  (HAC 14.54)
+ * Sliding-window exponentiation: X = A^E mod N  (HAC 14.85)
+ *
+ * mm = -N^-1 mod 2^biL; _RR as for mpi_exp_mod()
  */
-int mpi_gcd( mpi *G, const mpi *A, const mpi *B )
+static int mpi_exp_mod_hlp( mpi *X, const mpi *A, const mpi *E, const mpi *N,
+                            t_uint mm, mpi *_RR )
 {
     int ret;
-    size_t lz, lzt;
-    mpi TG, TA, TB;
+    size_t wbits, wsize, one = 1;
+    size_t i, j, nblimbs;
+    size_t bufsize, nbits, ebits;
+    t_uint ei, state;
+    mpi RR, T, W[ 2 << POLARSSL_MPI_WINDOW_SIZE ];
 
-    mpi_init( &TG ); mpi_init( &TA ); mpi_init( &TB );
+    /*
+     * Init temps and window size
+     */
+    mpi_init( &RR ); mpi_init( &T );
+    memset( W, 0, sizeof( W ) );
 
-    MPI_CHK( mpi_copy( &TA, A ) );
-    MPI_CHK( mpi_copy( &TB, B ) );
+    i = mpi_msb( E );
 
-    lz = mpi_lsb( &TA );
-    lzt = mpi_lsb( &TB );
+    wsize = ( i > 671 ) ? 6 : ( i > 239 ) ? 5 :
+            ( i >  79 ) ? 4 : ( i >  23 ) ? 3 : 1;
 
-    if ( lzt < lz )
-        lz = lzt;
+    if( wsize > POLARSSL_MPI_WINDOW_SIZE )
+        wsize = POLARSSL_MPI_WINDOW_SIZE;
 
-    MPI_CHK( mpi_shift_r( &TA, lz ) );
-    MPI_CHK( mpi_shift_r( &TB, lz ) );
+    j = N->n + 1;
+    MPI_CHK( mpi_grow( X, j ) );
+    MPI_CHK( mpi_grow( &W[1],  j ) );
+    MPI_CHK( mpi_grow( &T, j * 2 ) );
 
-    TA.s = TB.s = 1;
+    /*
+     * If 1st call, pre-compute R^2 mod N
+     */
+    if( _RR == NULL || _RR->p == NULL )
+    {
+        MPI_CHK( mpi_lset( &RR, 1 ) );
+        MPI_CHK( mpi_shift_l( &RR, N->n * 2 * biL ) );
+        MPI_CHK( mpi_mod_mpi( &RR, &RR, N ) );
 
-    while( mpi_cmp_int( &TA, 0 ) != 0 )
+        if( _RR != NULL )
+            memcpy( _RR, &RR, sizeof( mpi ) );
+    }
+    else
+        memcpy( &RR, _RR, sizeof( mpi ) );
+
+    /*
+     * W[1] = A * R^2 * R^-1 mod N = A * R mod N
+     */
+    if( mpi_cmp_mpi( A, N ) >= 0 )
+        mpi_mod_mpi( &W[1], A, N );
+    else   mpi_copy( &W[1], A );
+
+    /*
+     * Short exponents: a straight chain of squarings and multiplications
+     * by W[1], starting from W[1] for the top bit
+     */
+    ebits = mpi_msb( E );
+
+    if( ebits > 0 && ebits <= POLARSSL_MPI_SHORT_EXP_BITS )
     {
-        MPI_CHK( mpi_shift_r( &TA, mpi_lsb( &TA ) ) );
-        MPI_CHK( mpi_shift_r( &TB, mpi_lsb( &TB ) ) );
+        mpi_montmul( &W[1], &RR, N, mm, &T );
 
-        if( mpi_cmp_mpi( &TA, &TB ) >= 0 )
-        {
-            MPI_CHK( mpi_sub_abs( &TA, &TA, &TB ) );
-            MPI_CHK( mpi_shift_r( &TA, 1 ) );
-        }
-        else
+        MPI_CHK( mpi_copy( X, &W[1] ) );
+        MPI_CHK( mpi_grow( X, N->n + 1 ) );
+        X->s = 1;
+
+        for( i = ebits - 1; i > 0; i-- )
         {
-            MPI_CHK( mpi_sub_abs( &TB, &TB, &TA ) );
-            MPI_CHK( mpi_shift_r( &TB, 1 ) );
+            mpi_montsqr( X, N, mm, &T );
+
+            if( mpi_get_bit( (mpi *) E, i - 1 ) )
+                mpi_montmul( X, &W[1], N, mm, &T );
         }
+
+        mpi_montred( X, N, mm, &T );
+        goto cleanup;
     }
 
-    MPI_CHK( mpi_shift_l( &TB, lz ) );
-    MPI_CHK( mpi_copy( G, &TB ) );
+    /*
+     * Moduli of the usual RSA sizes go to the fixed-size kernels
+     */
+    switch( N->n )
+    {
+        case  512 / biL:
+            ret = mpi_exp_mod_fixed< 512 / biL>( X, &W[1], E, N, mm, &RR );
+            goto cleanup;
 
-cleanup:
+        case 1024 / biL:
+            ret = mpi_exp_mod_fixed<1024 / biL>( X, &W[1], E, N, mm, &RR );
+            goto cleanup;
 
-    mpi_free( &TG ); mpi_free( &TA ); mpi_free( &TB );
+        case 2048 / biL:
+            ret = mpi_exp_mod_fixed<2048 / biL>( X, &W[1], E, N, mm, &RR );
+            goto cleanup;
 
-    return( ret );
-}
+        case 3072 / biL:
+            ret = mpi_exp_mod_fixed<3072 / biL>( X, &W[1], E, N, mm, &RR );
+            goto cleanup;
+
+        case 4096 / biL:
+            ret = mpi_exp_mod_fixed<4096 / biL>( X, &W[1], E, N, mm, &RR );
+            goto cleanup;
+
+        default:
+            break;
+    }
+
+    mpi_montmul( &W[1], &RR, N, mm, &T );
+
+    /*
+     * X = R^2 * R^-1 mod N = R mod N
+     */
+    MPI_CHK( mpi_copy( X, &RR ) );
+    mpi_montred( X, N, mm, &T );
+
+    if( wsize > 1 )
+    {
+        /*
+         * W[1 << (wsize - 1)] = W[1] ^ (wsize - 1)
+         */
+        j =  one << (wsize - 1);
+
+        MPI_CHK( mpi_grow( &W[j], N->n + 1 ) );
+        MPI_CHK( mpi_copy( &W[j], &W[1]    ) );
+
+        for( i = 0; i < wsize - 1; i++ )
+            mpi_montsqr( &W[j], N, mm, &T );
+    
+        /*
+         * W[i] = W[i - 1] * W[1]
+         */
+        for( i = j + 1; i < (one << wsize); i++ )
+        {
+            MPI_CHK( mpi_grow( &W[i], N->n + 1 ) );
+            MPI_CHK( mpi_copy( &W[i], &W[i - 1] ) );
+
+            mpi_montmul( &W[i], &W[1], N, mm, &T );
+        }
+    }
+
+    nblimbs = E->n;
+    bufsize = 0;
+    nbits   = 0;
+    wbits   = 0;
+    state   = 0;
+
+    while( 1 )
+    {
+        if( bufsize == 0 )
+        {
+            if( nblimbs-- == 0 )
+                break;
+
+            bufsize = sizeof( t_uint ) << 3;
+        }
+
+        bufsize--;
+
+        ei = (E->p[nblimbs] >> bufsize) & 1;
+
+        /*
+         * skip leading 0s
+         */
+        if( ei == 0 && state == 0 )
+            continue;
+
+        if( ei == 0 && state == 1 )
+        {
+            /*
+             * out of window, square X
+             */
+            mpi_montsqr( X, N, mm, &T );
+            continue;
+        }
+
+        /*
+         * add ei to current window
+         */
+        state = 2;
+
+        nbits++;
+        wbits |= (ei << (wsize - nbits));
+
+        if( nbits == wsize )
+        {
+            /*
+             * X = X^wsize R^-1 mod N
+             */
+            for( i = 0; i < wsize; i++ )
+                mpi_montsqr( X, N, mm, &T );
+
+            /*
+             * X = X * W[wbits] R^-1 mod N
+             */
+            mpi_montmul( X, &W[wbits], N, mm, &T );
+
+            state--;
+            nbits = 0;
+            wbits = 0;
+        }
+    }
+
+    /*
+     * process the remaining bits
+     */
+    for( i = 0; i < nbits; i++ )
+    {
+        mpi_montsqr( X, N, mm, &T );
+
+        wbits <<= 1;
+
+        if( (wbits & (one << wsize)) != 0 )
+            mpi_montmul( X, &W[1], N, mm, &T );
+    }
+
+    /*
+     * X = A^E * R * R^-1 mod N = A^E mod N
+     */
+    mpi_montred( X, N, mm, &T );
+
+cleanup:
+
+    for( i = (one << (wsize - 1)); i < (one << wsize); i++ )
+        mpi_free( &W[i] );
+
+    mpi_free( &W[1] ); mpi_free( &T );
+
+    if( _RR == NULL )
+        mpi_free( &RR );
+
+    return( ret );
+}
+
+/*
+ * Sliding-window exponentiation: X = A^E mod N
+ */
+int mpi_exp_mod( mpi *X, const mpi *A, const mpi *E, const mpi *N, mpi *_RR )
+{
+    t_uint mm;
+
+    if( mpi_cmp_int( N, 0 ) < 0 || ( N->p[0] & 1 ) == 0 )
+        return( POLARSSL_ERR_MPI_BAD_INPUT_DATA );
+
+#if defined(POLARSSL_MPI_HAVE_AVX2)
+    /*
+     * Hand 1024 to 4096-bit moduli to the IFMA engine if the CPU has it.
+     * The AVX2 engine is not faster than mpi_montmul() on the scalar
+     * multiply-accumulate kernels, so it is not used here. Neither is
+     * worth its window table for short exponents.
+     */
+    if( A->s > 0 && mpi_msb( E ) > POLARSSL_MPI_SHORT_EXP_BITS &&
+        mpi_avx_engine( mpi_msb( N ) ) == POLARSSL_MPI_ENGINE_IFMA )
+        return( mpi_exp_mod_avx( POLARSSL_MPI_ENGINE_IFMA, X, A, E, N, NULL ) );
+#endif
+
+    mpi_montg_init( &mm, N );
+
+    return( mpi_exp_mod_hlp( X, A, E, N, mm, _RR ) );
+}
+
+/*
+ * Montgomery context
+ */
+void mpi_mont_init( mpi_mont_ctx *ctx )
+{
+    if( ctx == NULL )
+        return;
+
+    mpi_init( &ctx->N );
+    mpi_init( &ctx->RR );
+    mpi_init( &ctx->RRs );
+    ctx->mm = 0;
+    ctx->engine = 0;
+}
+
+void mpi_mont_free( mpi_mont_ctx *ctx )
+{
+    if( ctx == NULL )
+        return;
+
+    mpi_free( &ctx->RRs );
+    mpi_free( &ctx->RR );
+    mpi_free( &ctx->N );
+    ctx->mm = 0;
+    ctx->engine = 0;
+}
+
+int mpi_mont_setup( mpi_mont_ctx *ctx, const mpi *N )
+{
+    int ret;
+
+    if( mpi_cmp_int( N, 0 ) < 0 || ( N->p[0] & 1 ) == 0 )
+        return( POLARSSL_ERR_MPI_BAD_INPUT_DATA );
+
+    /*
+     * Start from empty MPIs so that N.n is the significant limb count,
+     * which both RR and the fixed-size kernels depend on
+     */
+    mpi_mont_free( ctx );
+
+    MPI_CHK( mpi_copy( &ctx->N, N ) );
+    mpi_montg_init( &ctx->mm, &ctx->N );
+
+    MPI_CHK( mpi_lset( &ctx->RR, 1 ) );
+    MPI_CHK( mpi_shift_l( &ctx->RR, ctx->N.n * 2 * biL ) );
+    MPI_CHK( mpi_mod_mpi( &ctx->RR, &ctx->RR, &ctx->N ) );
+
+#if defined(POLARSSL_MPI_HAVE_AVX2)
+    /*
+     * Same engine choice as mpi_exp_mod()
+     */
+    if( mpi_avx_engine( mpi_msb( N ) ) == POLARSSL_MPI_ENGINE_IFMA )
+    {
+        ctx->engine = POLARSSL_MPI_ENGINE_IFMA;
+        MPI_CHK( mpi_avx_rr( ctx->engine, &ctx->RRs, &ctx->N ) );
+    }
+#endif
+
+cleanup:
+
+    if( ret != 0 )
+        mpi_mont_free( ctx );
+
+    return( ret );
+}
+
+int mpi_mont_copy( mpi_mont_ctx *dst, const mpi_mont_ctx *src )
+{
+    int ret;
+
+    mpi_mont_free( dst );
+
+    /*
+     * mpi_copy() needs at least one limb in the source
+     */
+    if( src->N.p == NULL )
+        return( 0 );
+
+    MPI_CHK( mpi_copy( &dst->N, &src->N ) );
+    MPI_CHK( mpi_copy( &dst->RR, &src->RR ) );
+
+    if( src->RRs.p != NULL )
+        MPI_CHK( mpi_copy( &dst->RRs, &src->RRs ) );
+
+    dst->mm = src->mm;
+    dst->engine = src->engine;
+
+cleanup:
+
+    if( ret != 0 )
+        mpi_mont_free( dst );
+
+    return( ret );
+}
+
+/*
+ * Check a context from outside: mm * N = -1 mod 2^biL and
+ * RR * R^-1 * R^-1 = 1, the same for RRs in the engine's radix
+ */
+int mpi_mont_check( const mpi_mont_ctx *ctx )
+{
+    int ret;
+    mpi T;
+
+    if( ctx->N.p == NULL || mpi_cmp_int( &ctx->N, 1 ) <= 0 ||
+        (t_uint)( ctx->mm * ctx->N.p[0] ) != (t_uint) -1 ||
+        ctx->RR.p == NULL || mpi_cmp_int( &ctx->RR, 0 ) < 0 ||
+        mpi_cmp_mpi( &ctx->RR, &ctx->N ) >= 0 )
+        return( POLARSSL_ERR_MPI_BAD_INPUT_DATA );
+
+    mpi_init( &T );
+
+    MPI_CHK( mpi_mont_from( &T, &ctx->RR, ctx ) );
+    MPI_CHK( mpi_mont_from( &T, &T, ctx ) );
+
+    if( mpi_cmp_int( &T, 1 ) != 0 )
+    {
+        ret = POLARSSL_ERR_MPI_BAD_INPUT_DATA;
+        goto cleanup;
+    }
+
+#if defined(POLARSSL_MPI_HAVE_AVX2)
+    if( ctx->engine != POLARSSL_MPI_ENGINE_NONE )
+        MPI_CHK( mpi_avx_check_rr( ctx->engine, &ctx->RRs, &ctx->N ) );
+#else
+    if( ctx->engine != 0 )
+        ret = POLARSSL_ERR_MPI_BAD_INPUT_DATA;
+#endif
+
+cleanup:
+
+    mpi_free( &T );
+
+    return( ret );
+}
+
+/*
+ * Exponentiation with a prepared context: X = A^E mod N
+ */
+int mpi_exp_mod_ctx( mpi *X, const mpi *A, const mpi *E,
+                     const mpi_mont_ctx *ctx )
+{
+    if( ctx->N.p == NULL )
+        return( POLARSSL_ERR_MPI_BAD_INPUT_DATA );
+
+#if defined(POLARSSL_MPI_HAVE_AVX2)
+    if( A->s > 0 && ctx->engine != 0 && mpi_msb( E ) > POLARSSL_MPI_SHORT_EXP_BITS )
+        return( mpi_exp_mod_avx( ctx->engine, X, A, E, &ctx->N, &ctx->RRs ) );
+#endif
+
+    /*
+     * RR is already set, so mpi_exp_mod_hlp() only reads it
+     */
+    return( mpi_exp_mod_hlp( X, A, E, &ctx->N, ctx->mm, (mpi *) &ctx->RR ) );
+}
+
+/*
+ * Montgomery form: X = A * R mod N
+ */
+int mpi_mont_to( mpi *X, const mpi *A, const mpi_mont_ctx *ctx )
+{
+    int ret;
+    mpi T;
+
+    if( ctx->N.p == NULL )
+        return( POLARSSL_ERR_MPI_BAD_INPUT_DATA );
+
+    mpi_init( &T );
+
+    MPI_CHK( mpi_mod_mpi( &T, A, &ctx->N ) );
+    MPI_CHK( mpi_mont_mul( X, &T, &ctx->RR, ctx ) );
+
+cleanup:
+
+    mpi_free( &T );
+
+    return( ret );
+}
+
+/*
+ * Back from Montgomery form: X = A * R^-1 mod N
+ */
+int mpi_mont_from( mpi *X, const mpi *A, const mpi_mont_ctx *ctx )
+{
+    int ret;
+    mpi T;
+
+    if( ctx->N.p == NULL )
+        return( POLARSSL_ERR_MPI_BAD_INPUT_DATA );
+
+    mpi_init( &T );
+
+    MPI_CHK( mpi_grow( &T, ctx->N.n * 2 + 2 ) );
+    MPI_CHK( mpi_copy( X, A ) );
+    MPI_CHK( mpi_grow( X, ctx->N.n + 1 ) );
+
+    mpi_montred( X, &ctx->N, ctx->mm, &T );
+
+cleanup:
+
+    mpi_free( &T );
+
+    return( ret );
+}
+
+/*
+ * Montgomery multiplication: X = A * B * R^-1 mod N
+ */
+int mpi_mont_mul( mpi *X, const mpi *A, const mpi *B, const mpi_mont_ctx *ctx )
+{
+    int ret;
+    mpi T;
+
+    if( ctx->N.p == NULL )
+        return( POLARSSL_ERR_MPI_BAD_INPUT_DATA );
+
+    mpi_init( &T );
+
+    MPI_CHK( mpi_grow( &T, ctx->N.n * 2 + 2 ) );
+
+    /*
+     * mpi_montmul() works in place on its first operand
+     */
+    if( X == B )
+    {
+        B = A;
+        A = X;
+    }
+
+    MPI_CHK( mpi_copy( X, A ) );
+    MPI_CHK( mpi_grow( X, ctx->N.n + 1 ) );
+
+    if( A == B )
+        mpi_montsqr( X, &ctx->N, ctx->mm, &T );
+    else
+        mpi_montmul( X, B, &ctx->N, ctx->mm, &T );
+
+cleanup:
+
+    mpi_free( &T );
+
+    return( ret );
+}
+
+/*
+ * Modular addition, also valid in Montgomery form: X = A + B mod N
+ */
+int mpi_mont_add( mpi *X, const mpi *A, const mpi *B, const mpi_mont_ctx *ctx )
+{
+    int ret;
+
+    MPI_CHK( mpi_add_mpi( X, A, B ) );
+
+    if( mpi_cmp_mpi( X, &ctx->N ) >= 0 )
+        MPI_CHK( mpi_sub_abs( X, X, &ctx->N ) );
+
+cleanup:
+
+    return( ret );
+}
+
+/*
+ * Modular subtraction, also valid in Montgomery form: X = A - B mod N
+ */
+int mpi_mont_sub( mpi *X, const mpi *A, const mpi *B, const mpi_mont_ctx *ctx )
+{
+    int ret;
+
+    MPI_CHK( mpi_sub_mpi( X, A, B ) );
+
+    if( mpi_cmp_int( X, 0 ) < 0 )
+        MPI_CHK( mpi_add_mpi( X, X, &ctx->N ) );
+
+cleanup:
+
+    return( ret );
+}
+
+/*
+ * Multi-buffer exponentiation: X[i] = A[i]^E[i] mod N[i]
+ */
+int mpi_exp_mod_multi( mpi *X[], const mpi *A[], const mpi *E[],
+                       const mpi *N[], size_t count )
+{
+    int ret = 0;
+    size_t i, k, n;
+
+    for( i = 0; i < count; i++ )
+        if( mpi_cmp_int( N[i], 0 ) < 0 || ( N[i]->p[0] & 1 ) == 0 )
+            return( POLARSSL_ERR_MPI_BAD_INPUT_DATA );
+
+    for( i = 0; i < count; i += n )
+    {
+#if defined(POLARSSL_MPI_HAVE_IFMA)
+        n = ( count - i < POLARSSL_MPI_MULTI_LANES ) ?
+            count - i : POLARSSL_MPI_MULTI_LANES;
+
+        /*
+         * Groups the lane engine can't take (no IFMA, moduli of different
+         * sizes, negative bases) fall back to one call per operation
+         */
+        if( n > 1 )
+        {
+            ret = mpi_exp_mod_multi_avx( X + i, A + i, E + i, N + i, n );
+            if( ret != POLARSSL_ERR_MPI_NOT_ACCEPTABLE )
+            {
+                MPI_CHK( ret );
+                continue;
+            }
+        }
+#else
+        n = count - i;
+#endif
+
+        for( k = 0; k < n; k++ )
+            MPI_CHK( mpi_exp_mod( X[i + k], A[i + k], E[i + k], N[i + k], NULL ) );
+    }
+
+    ret = 0;
+
+cleanup:
+
+    return( ret );
+}
+
+/*
+ * Greatest common divisor: G = gcd(A, B)  (HAC 14.54)
+ */
+int mpi_gcd( mpi *G, const mpi *A, const mpi *B )
+{
+    int ret;
+    size_t lz, lzt;
+    mpi TG, TA, TB;
+
+    mpi_init( &TG ); mpi_init( &TA ); mpi_init( &TB );
+
+    MPI_CHK( mpi_copy( &TA, A ) );
+    MPI_CHK( mpi_copy( &TB, B ) );
+
+    lz = mpi_lsb( &TA );
+    lzt = mpi_lsb( &TB );
+
+    if ( lzt < lz )
+        lz = lzt;
+
+    MPI_CHK( mpi_shift_r( &TA, lz ) );
+    MPI_CHK( mpi_shift_r( &TB, lz ) );
+
+    TA.s = TB.s = 1;
+
+    while( mpi_cmp_int( &TA, 0 ) != 0 )
+    {
+        MPI_CHK( mpi_shift_r( &TA, mpi_lsb( &TA ) ) );
+        MPI_CHK( mpi_shift_r( &TB, mpi_lsb( &TB ) ) );
+
+        if( mpi_cmp_mpi( &TA, &TB ) >= 0 )
+        {
+            MPI_CHK( mpi_sub_abs( &TA, &TA, &TB ) );
+            MPI_CHK( mpi_shift_r( &TA, 1 ) );
+        }
+        else
+        {
+            MPI_CHK( mpi_sub_abs( &TB, &TB, &TA ) );
+            MPI_CHK( mpi_shift_r( &TB, 1 ) );
+        }
+    }
+
+    MPI_CHK( mpi_shift_l( &TB, lz ) );
+    MPI_CHK( mpi_copy( G, &TB ) );
+
+cleanup:
+
+    mpi_free( &TG ); mpi_free( &TA ); mpi_free( &TB );
+
+    return( ret );
+}
 
 int mpi_fill_random( mpi *X, size_t size,
                      int (*f_rng)(void *, unsigned char *, size_t),
@@ -1618,147 +2757,607 @@ int mpi_fill_random( mpi *X, size_t size,
 {
     int ret;
 
-    MPI_CHK( mpi_grow( X, CHARS_TO_LIMBS( size ) ) );
-    MPI_CHK( mpi_lset( X, 0 ) );
+    MPI_CHK( mpi_grow( X, CHARS_TO_LIMBS( size ) ) );
+    MPI_CHK( mpi_lset( X, 0 ) );
+
+    MPI_CHK( f_rng( p_rng, (unsigned char *) X->p, size ) );
+
+cleanup:
+    return( ret );
+}
+
+#if defined(POLARSSL_GENPRIME)
+
+/*
+ * Modular inverse: X = A^-1 mod N  (HAC 14.61 / 14.64)
+ */
+int mpi_inv_mod( mpi *X, const mpi *A, const mpi *N )
+{
+    int ret;
+    mpi G, TA, TU, U1, U2, TB, TV, V1, V2;
+
+    if( mpi_cmp_int( N, 0 ) <= 0 )
+        return( POLARSSL_ERR_MPI_BAD_INPUT_DATA );
+
+    mpi_init( &TA ); mpi_init( &TU ); mpi_init( &U1 ); mpi_init( &U2 );
+    mpi_init( &G ); mpi_init( &TB ); mpi_init( &TV );
+    mpi_init( &V1 ); mpi_init( &V2 );
+
+    MPI_CHK( mpi_gcd( &G, A, N ) );
+
+    if( mpi_cmp_int( &G, 1 ) != 0 )
+    {
+        ret = POLARSSL_ERR_MPI_NOT_ACCEPTABLE;
+        goto cleanup;
+    }
+
+    MPI_CHK( mpi_mod_mpi( &TA, A, N ) );
+    MPI_CHK( mpi_copy( &TU, &TA ) );
+    MPI_CHK( mpi_copy( &TB, N ) );
+    MPI_CHK( mpi_copy( &TV, N ) );
+
+    MPI_CHK( mpi_lset( &U1, 1 ) );
+    MPI_CHK( mpi_lset( &U2, 0 ) );
+    MPI_CHK( mpi_lset( &V1, 0 ) );
+    MPI_CHK( mpi_lset( &V2, 1 ) );
+
+    do
+    {
+        while( ( TU.p[0] & 1 ) == 0 )
+        {
+            MPI_CHK( mpi_shift_r( &TU, 1 ) );
+
+            if( ( U1.p[0] & 1 ) != 0 || ( U2.p[0] & 1 ) != 0 )
+            {
+                MPI_CHK( mpi_add_mpi( &U1, &U1, &TB ) );
+                MPI_CHK( mpi_sub_mpi( &U2, &U2, &TA ) );
+            }
+
+            MPI_CHK( mpi_shift_r( &U1, 1 ) );
+            MPI_CHK( mpi_shift_r( &U2, 1 ) );
+        }
+
+        while( ( TV.p[0] & 1 ) == 0 )
+        {
+            MPI_CHK( mpi_shift_r( &TV, 1 ) );
+
+            if( ( V1.p[0] & 1 ) != 0 || ( V2.p[0] & 1 ) != 0 )
+            {
+                MPI_CHK( mpi_add_mpi( &V1, &V1, &TB ) );
+                MPI_CHK( mpi_sub_mpi( &V2, &V2, &TA ) );
+            }
+
+            MPI_CHK( mpi_shift_r( &V1, 1 ) );
+            MPI_CHK( mpi_shift_r( &V2, 1 ) );
+        }
+
+        if( mpi_cmp_mpi( &TU, &TV ) >= 0 )
+        {
+            MPI_CHK( mpi_sub_mpi( &TU, &TU, &TV ) );
+            MPI_CHK( mpi_sub_mpi( &U1, &U1, &V1 ) );
+            MPI_CHK( mpi_sub_mpi( &U2, &U2, &V2 ) );
+        }
+        else
+        {
+            MPI_CHK( mpi_sub_mpi( &TV, &TV, &TU ) );
+            MPI_CHK( mpi_sub_mpi( &V1, &V1, &U1 ) );
+            MPI_CHK( mpi_sub_mpi( &V2, &V2, &U2 ) );
+        }
+    }
+    while( mpi_cmp_int( &TU, 0 ) != 0 );
+
+    while( mpi_cmp_int( &V1, 0 ) < 0 )
+        MPI_CHK( mpi_add_mpi( &V1, &V1, N ) );
+
+    while( mpi_cmp_mpi( &V1, N ) >= 0 )
+        MPI_CHK( mpi_sub_mpi( &V1, &V1, N ) );
+
+    MPI_CHK( mpi_copy( X, &V1 ) );
+
+cleanup:
+
+    mpi_free( &TA ); mpi_free( &TU ); mpi_free( &U1 ); mpi_free( &U2 );
+    mpi_free( &G ); mpi_free( &TB ); mpi_free( &TV );
+    mpi_free( &V1 ); mpi_free( &V2 );
+
+    return( ret );
+}
+
+static const int small_prime[] =
+{
+        3,    5,    7,   11,   13,   17,   19,   23,
+       29,   31,   37,   41,   43,   47,   53,   59,
+       61,   67,   71,   73,   79,   83,   89,   97,
+      101,  103,  107,  109,  113,  127,  131,  137,
+      139,  149,  151,  157,  163,  167,  173,  179,
+      181,  191,  193,  197,  199,  211,  223,  227,
+      229,  233,  239,  241,  251,  257,  263,  269,
+      271,  277,  281,  283,  293,  307,  311,  313,
+      317,  331,  337,  347,  349,  353,  359,  367,
+      373,  379,  383,  389,  397,  401,  409,  419,
+      421,  431,  433,  439,  443,  449,  457,  461,
+      463,  467,  479,  487,  491,  499,  503,  509,
+      521,  523,  541,  547,  557,  563,  569,  571,
+      577,  587,  593,  599,  601,  607,  613,  617,
+      619,  631,  641,  643,  647,  653,  659,  661,
+      673,  677,  683,  691,  701,  709,  719,  727,
+      733,  739,  743,  751,  757,  761,  769,  773,
+      787,  797,  809,  811,  821,  823,  827,  829,
+      839,  853,  857,  859,  863,  877,  881,  883,
+      887,  907,  911,  919,  929,  937,  941,  947,
+      953,  967,  971,  977,  983,  991,  997, -103
+};
+
+/*
+ * State shared by the strong probable prime tests of one candidate X:
+ * W = X - 1 = 2^s * R, and R^2, 1 and X - 1 in Montgomery form so that
+ * the squarings stay in Montgomery form
+ */
+typedef struct
+{
+    mpi W, R;                   /*!<  X - 1, ( X - 1 ) >> s  */
+    size_t s;                   /*!<  lsb( X - 1 )           */
+    t_uint mm;                  /*!<  -X^-1 mod 2^biL        */
+    mpi RR;                     /*!<  R^2 mod X              */
+    mpi M1, MW;                 /*!<  R mod X, -R mod X      */
+    mpi T;                      /*!<  montmul scratch        */
+}
+mpi_prime_ctx;
+
+static void mpi_prime_free( mpi_prime_ctx *ctx )
+{
+    mpi_free( &ctx->W ); mpi_free( &ctx->R ); mpi_free( &ctx->RR );
+    mpi_free( &ctx->M1 ); mpi_free( &ctx->MW ); mpi_free( &ctx->T );
+}
+
+static int mpi_prime_setup( mpi_prime_ctx *ctx, const mpi *X )
+{
+    int ret;
+
+    mpi_init( &ctx->W ); mpi_init( &ctx->R ); mpi_init( &ctx->RR );
+    mpi_init( &ctx->M1 ); mpi_init( &ctx->MW ); mpi_init( &ctx->T );
+
+    MPI_CHK( mpi_sub_int( &ctx->W, X, 1 ) );
+    ctx->s = mpi_lsb( &ctx->W );
+    MPI_CHK( mpi_copy( &ctx->R, &ctx->W ) );
+    MPI_CHK( mpi_shift_r( &ctx->R, ctx->s ) );
+
+    mpi_montg_init( &ctx->mm, X );
+
+    /*
+     * Same R as mpi_exp_mod(), which reuses RR
+     */
+    MPI_CHK( mpi_lset( &ctx->RR, 1 ) );
+    MPI_CHK( mpi_shift_l( &ctx->RR, X->n * 2 * biL ) );
+    MPI_CHK( mpi_mod_mpi( &ctx->RR, &ctx->RR, X ) );
+
+    MPI_CHK( mpi_lset( &ctx->M1, 1 ) );
+    MPI_CHK( mpi_shift_l( &ctx->M1, X->n * biL ) );
+    MPI_CHK( mpi_mod_mpi( &ctx->M1, &ctx->M1, X ) );
+    MPI_CHK( mpi_sub_mpi( &ctx->MW, X, &ctx->M1 ) );
+
+    MPI_CHK( mpi_grow( &ctx->T, X->n * 2 + 2 ) );
+
+cleanup:
+
+    if( ret != 0 )
+        mpi_prime_free( ctx );
+
+    return( ret );
+}
+
+/*
+ * Strong probable prime test to base A (HAC 4.24, step 2), A destroyed
+ */
+static int mpi_prime_strong( mpi_prime_ctx *ctx, const mpi *X, mpi *A )
+{
+    int ret;
+    size_t j;
+
+    /*
+     * A = A^R mod |X|
+     */
+    MPI_CHK( mpi_exp_mod( A, A, &ctx->R, X, &ctx->RR ) );
+
+    if( mpi_cmp_mpi( A, &ctx->W ) == 0 ||
+        mpi_cmp_int( A,  1 ) == 0 )
+        return( 0 );
+
+    /*
+     * A = A * R mod |X|, then square in Montgomery form and compare
+     * with the Montgomery forms of 1 and |X| - 1
+     */
+    MPI_CHK( mpi_grow( A, X->n + 1 ) );
+    mpi_montmul( A, &ctx->RR, X, ctx->mm, &ctx->T );
+
+    j = 1;
+    while( j < ctx->s && mpi_cmp_mpi( A, &ctx->MW ) != 0 )
+    {
+        mpi_montsqr( A, X, ctx->mm, &ctx->T );
+
+        if( mpi_cmp_mpi( A, &ctx->M1 ) == 0 )
+            break;
+
+        j++;
+    }
+
+    /*
+     * not prime if A != |X| - 1 or A == 1
+     */
+    if( mpi_cmp_mpi( A, &ctx->MW ) != 0 ||
+        mpi_cmp_mpi( A, &ctx->M1 ) == 0 )
+        ret = POLARSSL_ERR_MPI_NOT_ACCEPTABLE;
+
+cleanup:
+
+    return( ret );
+}
+
+#if !defined(POLARSSL_MPI_BPSW)
+/*
+ * Miller-Rabin rounds only, X odd and larger than the small primes
+ * (HAC 4.24)
+ */
+static int mpi_miller_rabin( const mpi *X,
+                             int (*f_rng)(void *, unsigned char *, size_t),
+                             void *p_rng )
+{
+    int ret;
+    size_t i, j, n;
+    mpi A;
+    mpi_prime_ctx ctx;
+
+    mpi_init( &A );
+
+    MPI_CHK( mpi_prime_setup( &ctx, X ) );
+
+    i = mpi_msb( X );
+    /*
+     * HAC, table 4.4
+     */
+    n = ( ( i >= 1300 ) ?  2 : ( i >=  850 ) ?  3 :
+          ( i >=  650 ) ?  4 : ( i >=  350 ) ?  8 :
+          ( i >=  250 ) ? 12 : ( i >=  150 ) ? 18 : 27 );
+
+    for( i = 0; i < n; i++ )
+    {
+        /*
+         * pick a random A, 1 < A < |X| - 1
+         */
+        MPI_CHK( mpi_fill_random( &A, X->n * ciL, f_rng, p_rng ) );
+
+        if( mpi_cmp_mpi( &A, &ctx.W ) >= 0 )
+        {
+            j = mpi_msb( &A ) - mpi_msb( &ctx.W );
+            MPI_CHK( mpi_shift_r( &A, j + 1 ) );
+        }
+        A.p[0] |= 3;
+
+        if( ( ret = mpi_prime_strong( &ctx, X, &A ) ) != 0 )
+            break;
+    }
+
+cleanup:
+
+    mpi_free( &A );
+    mpi_prime_free( &ctx );
+
+    return( ret );
+}
+#else
+/*
+ * Jacobi symbol ( a / N ) for a small odd a and an odd N > 0
+ */
+static int mpi_jacobi_int( int *j, t_sint a, const mpi *N )
+{
+    int ret, s = 1;
+    t_uint m, r, t;
+
+    m = ( a < 0 ) ? (t_uint) -a : (t_uint) a;
+
+    /*
+     * ( -1 / N ) = -1 for N = 3 mod 4, then quadratic reciprocity
+     * for ( m / N ) = ( N mod m / m )
+     */
+    if( a < 0 && ( N->p[0] & 3 ) == 3 )
+        s = -s;
+
+    if( ( m & 3 ) == 3 && ( N->p[0] & 3 ) == 3 )
+        s = -s;
+
+    MPI_CHK( mpi_mod_int( &r, N, (t_sint) m ) );
+
+    while( r != 0 )
+    {
+        while( ( r & 1 ) == 0 )
+        {
+            r >>= 1;
+            if( ( m & 7 ) == 3 || ( m & 7 ) == 5 )
+                s = -s;
+        }
+
+        t = r; r = m; m = t;
+
+        if( ( r & 3 ) == 3 && ( m & 3 ) == 3 )
+            s = -s;
+
+        r %= m;
+    }
+
+    *j = ( m == 1 ) ? s : 0;
+
+cleanup:
+
+    return( ret );
+}
+
+/*
+ * Set *sq if X is a perfect square (Newton iteration for isqrt)
+ */
+static int mpi_is_square( const mpi *X, int *sq )
+{
+    int ret;
+    mpi S, Q;
+
+    mpi_init( &S ); mpi_init( &Q );
+
+    MPI_CHK( mpi_lset( &S, 1 ) );
+    MPI_CHK( mpi_shift_l( &S, ( mpi_msb( X ) + 1 ) / 2 ) );
+
+    while( 1 )
+    {
+        MPI_CHK( mpi_div_mpi( &Q, NULL, X, &S ) );
+        MPI_CHK( mpi_add_mpi( &Q, &Q, &S ) );
+        MPI_CHK( mpi_shift_r( &Q, 1 ) );
+
+        if( mpi_cmp_mpi( &Q, &S ) >= 0 )
+            break;
+
+        mpi_swap( &Q, &S );
+    }
+
+    MPI_CHK( mpi_mul_mpi( &Q, &S, &S ) );
+    *sq = ( mpi_cmp_mpi( &Q, X ) == 0 );
+
+cleanup:
+
+    mpi_free( &S ); mpi_free( &Q );
+
+    return( ret );
+}
+
+/*
+ * Montgomery form of a small signed integer: X = v * R mod N
+ */
+static int mpi_prime_small( mpi_prime_ctx *ctx, mpi *X, t_sint v, const mpi *N )
+{
+    int ret;
+
+    MPI_CHK( mpi_lset( X, ( v < 0 ) ? -v : v ) );
+    MPI_CHK( mpi_grow( X, N->n + 1 ) );
+    mpi_montmul( X, &ctx->RR, N, ctx->mm, &ctx->T );
+
+    if( v < 0 && mpi_cmp_int( X, 0 ) != 0 )
+        MPI_CHK( mpi_sub_mpi( X, N, X ) );
+
+cleanup:
+
+    return( ret );
+}
+
+/*
+ * X = X / 2 mod N, X in [0, N)
+ */
+static int mpi_prime_half( mpi *X, const mpi *N )
+{
+    int ret;
+
+    if( X->p[0] & 1 )
+        MPI_CHK( mpi_add_abs( X, X, N ) );
+
+    MPI_CHK( mpi_shift_r( X, 1 ) );
+
+cleanup:
+
+    return( ret );
+}
+
+/*
+ * V = V * V - 2 * Qk mod N, Qk = Qk * Qk, all in Montgomery form
+ */
+static int mpi_prime_vdouble( mpi_prime_ctx *ctx, mpi *V, mpi *Qk, const mpi *N )
+{
+    int ret;
+    int k;
+
+    MPI_CHK( mpi_grow( V, N->n + 1 ) );
+    mpi_montsqr( V, N, ctx->mm, &ctx->T );
+
+    for( k = 0; k < 2; k++ )
+    {
+        MPI_CHK( mpi_sub_mpi( V, V, Qk ) );
+        if( mpi_cmp_int( V, 0 ) < 0 )
+            MPI_CHK( mpi_add_mpi( V, V, N ) );
+    }
 
-    MPI_CHK( f_rng( p_rng, (unsigned char *) X->p, size ) );
+    MPI_CHK( mpi_grow( Qk, N->n + 1 ) );
+    mpi_montsqr( Qk, N, ctx->mm, &ctx->T );
 
 cleanup:
+
     return( ret );
 }
 
-#if defined(POLARSSL_GENPRIME)
-
 /*
- * Modular inverse: X = A^-1 mod N  (HAC 14.61 / 14.64)
+ * Strong Lucas probable prime test with Selfridge's parameters:
+ * the first D in 5, -7, 9, -11, ... with ( D / N ) = -1, P = 1,
+ * Q = ( 1 - D ) / 4. N + 1 = d * 2^k; N passes if U_d = 0 or
+ * V_(d * 2^r) = 0 for some 0 <= r < k. The sequences are kept in
+ * Montgomery form.
  */
-int mpi_inv_mod( mpi *X, const mpi *A, const mpi *N )
+static int mpi_prime_lucas( mpi_prime_ctx *ctx, const mpi *N )
 {
-    int ret;
-    mpi G, TA, TU, U1, U2, TB, TV, V1, V2;
+    int ret, j, sq;
+    size_t i, k;
+    t_sint D;
+    mpi d, U, V, Qk, Qm, Dm, Z;
 
-    if( mpi_cmp_int( N, 0 ) <= 0 )
-        return( POLARSSL_ERR_MPI_BAD_INPUT_DATA );
-
-    mpi_init( &TA ); mpi_init( &TU ); mpi_init( &U1 ); mpi_init( &U2 );
-    mpi_init( &G ); mpi_init( &TB ); mpi_init( &TV );
-    mpi_init( &V1 ); mpi_init( &V2 );
-
-    MPI_CHK( mpi_gcd( &G, A, N ) );
+    mpi_init( &d ); mpi_init( &U ); mpi_init( &V ); mpi_init( &Qk );
+    mpi_init( &Qm ); mpi_init( &Dm ); mpi_init( &Z );
 
-    if( mpi_cmp_int( &G, 1 ) != 0 )
+    for( D = 5, i = 0; ; i++ )
     {
-        ret = POLARSSL_ERR_MPI_NOT_ACCEPTABLE;
-        goto cleanup;
-    }
-
-    MPI_CHK( mpi_mod_mpi( &TA, A, N ) );
-    MPI_CHK( mpi_copy( &TU, &TA ) );
-    MPI_CHK( mpi_copy( &TB, N ) );
-    MPI_CHK( mpi_copy( &TV, N ) );
+        MPI_CHK( mpi_jacobi_int( &j, D, N ) );
 
-    MPI_CHK( mpi_lset( &U1, 1 ) );
-    MPI_CHK( mpi_lset( &U2, 0 ) );
-    MPI_CHK( mpi_lset( &V1, 0 ) );
-    MPI_CHK( mpi_lset( &V2, 1 ) );
+        if( j == -1 )
+            break;
 
-    do
-    {
-        while( ( TU.p[0] & 1 ) == 0 )
+        if( j == 0 && mpi_cmp_int( N, ( D < 0 ) ? -D : D ) != 0 )
         {
-            MPI_CHK( mpi_shift_r( &TU, 1 ) );
+            ret = POLARSSL_ERR_MPI_NOT_ACCEPTABLE;
+            goto cleanup;
+        }
 
-            if( ( U1.p[0] & 1 ) != 0 || ( U2.p[0] & 1 ) != 0 )
+        /*
+         * No such D exists for a perfect square
+         */
+        if( i == 5 )
+        {
+            MPI_CHK( mpi_is_square( N, &sq ) );
+            if( sq != 0 )
             {
-                MPI_CHK( mpi_add_mpi( &U1, &U1, &TB ) );
-                MPI_CHK( mpi_sub_mpi( &U2, &U2, &TA ) );
+                ret = POLARSSL_ERR_MPI_NOT_ACCEPTABLE;
+                goto cleanup;
             }
-
-            MPI_CHK( mpi_shift_r( &U1, 1 ) );
-            MPI_CHK( mpi_shift_r( &U2, 1 ) );
         }
 
-        while( ( TV.p[0] & 1 ) == 0 )
-        {
-            MPI_CHK( mpi_shift_r( &TV, 1 ) );
+        D = ( D < 0 ) ? 2 - D : -2 - D;
+    }
 
-            if( ( V1.p[0] & 1 ) != 0 || ( V2.p[0] & 1 ) != 0 )
-            {
-                MPI_CHK( mpi_add_mpi( &V1, &V1, &TB ) );
-                MPI_CHK( mpi_sub_mpi( &V2, &V2, &TA ) );
-            }
+    MPI_CHK( mpi_prime_small( ctx, &Dm, D, N ) );
+    MPI_CHK( mpi_prime_small( ctx, &Qm, ( 1 - D ) / 4, N ) );
 
-            MPI_CHK( mpi_shift_r( &V1, 1 ) );
-            MPI_CHK( mpi_shift_r( &V2, 1 ) );
-        }
+    MPI_CHK( mpi_add_int( &d, N, 1 ) );
+    k = mpi_lsb( &d );
+    MPI_CHK( mpi_shift_r( &d, k ) );
 
-        if( mpi_cmp_mpi( &TU, &TV ) >= 0 )
-        {
-            MPI_CHK( mpi_sub_mpi( &TU, &TU, &TV ) );
-            MPI_CHK( mpi_sub_mpi( &U1, &U1, &V1 ) );
-            MPI_CHK( mpi_sub_mpi( &U2, &U2, &V2 ) );
-        }
-        else
-        {
-            MPI_CHK( mpi_sub_mpi( &TV, &TV, &TU ) );
-            MPI_CHK( mpi_sub_mpi( &V1, &V1, &U1 ) );
-            MPI_CHK( mpi_sub_mpi( &V2, &V2, &U2 ) );
-        }
+    /*
+     * U_1 = 1, V_1 = P = 1, Q^1
+     */
+    MPI_CHK( mpi_copy( &U, &ctx->M1 ) );
+    MPI_CHK( mpi_copy( &V, &ctx->M1 ) );
+    MPI_CHK( mpi_copy( &Qk, &Qm ) );
+
+    for( i = mpi_msb( &d ) - 1; i > 0; i-- )
+    {
+        /*
+         * U_2m = U_m * V_m, V_2m = V_m^2 - 2 Q^m
+         */
+        MPI_CHK( mpi_grow( &U, N->n + 1 ) );
+        mpi_montmul( &U, &V, N, ctx->mm, &ctx->T );
+        MPI_CHK( mpi_prime_vdouble( ctx, &V, &Qk, N ) );
+
+        if( mpi_get_bit( &d, i - 1 ) == 0 )
+            continue;
+
+        /*
+         * U_m+1 = ( P U_m + V_m ) / 2, V_m+1 = ( D U_m + P V_m ) / 2
+         */
+        MPI_CHK( mpi_copy( &Z, &U ) );
+        MPI_CHK( mpi_grow( &Z, N->n + 1 ) );
+        mpi_montmul( &Z, &Dm, N, ctx->mm, &ctx->T );
+        MPI_CHK( mpi_add_mpi( &Z, &Z, &V ) );
+        if( mpi_cmp_mpi( &Z, N ) >= 0 )
+            MPI_CHK( mpi_sub_mpi( &Z, &Z, N ) );
+
+        MPI_CHK( mpi_add_mpi( &U, &U, &V ) );
+        if( mpi_cmp_mpi( &U, N ) >= 0 )
+            MPI_CHK( mpi_sub_mpi( &U, &U, N ) );
+
+        MPI_CHK( mpi_prime_half( &U, N ) );
+        MPI_CHK( mpi_prime_half( &Z, N ) );
+        mpi_swap( &V, &Z );
+
+        MPI_CHK( mpi_grow( &Qk, N->n + 1 ) );
+        mpi_montmul( &Qk, &Qm, N, ctx->mm, &ctx->T );
     }
-    while( mpi_cmp_int( &TU, 0 ) != 0 );
 
-    while( mpi_cmp_int( &V1, 0 ) < 0 )
-        MPI_CHK( mpi_add_mpi( &V1, &V1, N ) );
+    if( mpi_cmp_int( &U, 0 ) == 0 || mpi_cmp_int( &V, 0 ) == 0 )
+        goto cleanup;
 
-    while( mpi_cmp_mpi( &V1, N ) >= 0 )
-        MPI_CHK( mpi_sub_mpi( &V1, &V1, N ) );
+    for( i = 1; i < k; i++ )
+    {
+        MPI_CHK( mpi_prime_vdouble( ctx, &V, &Qk, N ) );
 
-    MPI_CHK( mpi_copy( X, &V1 ) );
+        if( mpi_cmp_int( &V, 0 ) == 0 )
+            goto cleanup;
+    }
+
+    ret = POLARSSL_ERR_MPI_NOT_ACCEPTABLE;
 
 cleanup:
 
-    mpi_free( &TA ); mpi_free( &TU ); mpi_free( &U1 ); mpi_free( &U2 );
-    mpi_free( &G ); mpi_free( &TB ); mpi_free( &TV );
-    mpi_free( &V1 ); mpi_free( &V2 );
+    mpi_free( &d ); mpi_free( &U ); mpi_free( &V ); mpi_free( &Qk );
+    mpi_free( &Qm ); mpi_free( &Dm ); mpi_free( &Z );
 
     return( ret );
 }
 
-static const int small_prime[] =
+/*
+ * Baillie-PSW: strong probable prime to base 2 and strong Lucas
+ * probable prime, X odd and larger than the small primes
+ */
+static int mpi_bpsw( const mpi *X )
 {
-        3,    5,    7,   11,   13,   17,   19,   23,
-       29,   31,   37,   41,   43,   47,   53,   59,
-       61,   67,   71,   73,   79,   83,   89,   97,
-      101,  103,  107,  109,  113,  127,  131,  137,
-      139,  149,  151,  157,  163,  167,  173,  179,
-      181,  191,  193,  197,  199,  211,  223,  227,
-      229,  233,  239,  241,  251,  257,  263,  269,
-      271,  277,  281,  283,  293,  307,  311,  313,
-      317,  331,  337,  347,  349,  353,  359,  367,
-      373,  379,  383,  389,  397,  401,  409,  419,
-      421,  431,  433,  439,  443,  449,  457,  461,
-      463,  467,  479,  487,  491,  499,  503,  509,
-      521,  523,  541,  547,  557,  563,  569,  571,
-      577,  587,  593,  599,  601,  607,  613,  617,
-      619,  631,  641,  643,  647,  653,  659,  661,
-      673,  677,  683,  691,  701,  709,  719,  727,
-      733,  739,  743,  751,  757,  761,  769,  773,
-      787,  797,  809,  811,  821,  823,  827,  829,
-      839,  853,  857,  859,  863,  877,  881,  883,
-      887,  907,  911,  919,  929,  937,  941,  947,
-      953,  967,  971,  977,  983,  991,  997, -103
-};
+    int ret;
+    mpi A;
+    mpi_prime_ctx ctx;
+
+    mpi_init( &A );
+
+    MPI_CHK( mpi_prime_setup( &ctx, X ) );
+
+    MPI_CHK( mpi_lset( &A, 2 ) );
+
+    if( ( ret = mpi_prime_strong( &ctx, X, &A ) ) == 0 )
+        ret = mpi_prime_lucas( &ctx, X );
+
+cleanup:
+
+    mpi_free( &A );
+    mpi_prime_free( &ctx );
+
+    return( ret );
+}
+#endif /* POLARSSL_MPI_BPSW */
+
+/*
+ * Probable prime test after trial division: Baillie-PSW if enabled,
+ * Miller-Rabin with random bases otherwise
+ */
+static int mpi_prime_test( const mpi *X,
+                           int (*f_rng)(void *, unsigned char *, size_t),
+                           void *p_rng )
+{
+#if defined(POLARSSL_MPI_BPSW)
+    ((void) f_rng);
+    ((void) p_rng);
+
+    return( mpi_bpsw( X ) );
+#else
+    return( mpi_miller_rabin( X, f_rng, p_rng ) );
+#endif
+}
 
 /*
- * Miller-Rabin primality test  (HAC 4.24)
+ * Primality test: trial division, then mpi_prime_test()
  */
 int mpi_is_prime( mpi *X,
                   int (*f_rng)(void *, unsigned char *, size_t),
                   void *p_rng )
 {
     int ret, xs;
-    size_t i, j, n, s;
-    mpi W, R, T, A, RR;
+    size_t i;
 
     if( mpi_cmp_int( X, 0 ) == 0 ||
         mpi_cmp_int( X, 1 ) == 0 )
@@ -1767,102 +3366,260 @@ int mpi_is_prime( mpi *X,
     if( mpi_cmp_int( X, 2 ) == 0 )
         return( 0 );
 
-    mpi_init( &W ); mpi_init( &R ); mpi_init( &T ); mpi_init( &A );
-    mpi_init( &RR );
-
-    xs = X->s; X->s = 1;
-
     /*
      * test trivial factors first
      */
     if( ( X->p[0] & 1 ) == 0 )
         return( POLARSSL_ERR_MPI_NOT_ACCEPTABLE );
 
+    xs = X->s; X->s = 1;
+
     for( i = 0; small_prime[i] > 0; i++ )
     {
         t_uint r;
 
         if( mpi_cmp_int( X, small_prime[i] ) <= 0 )
-            return( 0 );
+        {
+            ret = 0;
+            goto cleanup;
+        }
 
         MPI_CHK( mpi_mod_int( &r, X, small_prime[i] ) );
 
         if( r == 0 )
-            return( POLARSSL_ERR_MPI_NOT_ACCEPTABLE );
+        {
+            ret = POLARSSL_ERR_MPI_NOT_ACCEPTABLE;
+            goto cleanup;
+        }
+    }
+
+    ret = mpi_prime_test( X, f_rng, p_rng );
+
+cleanup:
+
+    X->s = xs;
+
+    return( ret );
+}
+
+/*
+ * Odd primes below POLARSSL_MPI_SIEVE_BOUND, sieve of Eratosthenes,
+ * built on first use
+ */
+#define MPI_SIEVE_NPRIMES       ( POLARSSL_MPI_SIEVE_BOUND / 8 )
+
+static size_t mpi_sieve_build( unsigned int *primes )
+{
+    size_t i, j, n;
+    unsigned char *comp;
+
+    comp = (unsigned char *) calloc( POLARSSL_MPI_SIEVE_BOUND, 1 );
+    if( comp == NULL )
+        return( 0 );
+
+    for( i = 3, n = 0; i < POLARSSL_MPI_SIEVE_BOUND && n < MPI_SIEVE_NPRIMES; i += 2 )
+    {
+        if( comp[i] )
+            continue;
+
+        primes[n++] = (unsigned int) i;
+
+        for( j = i * i; j < POLARSSL_MPI_SIEVE_BOUND; j += 2 * i )
+            comp[j] = 1;
     }
 
+    free( comp );
+
+    return( n );
+}
+
+static const unsigned int *mpi_sieve_primes( size_t *n )
+{
+    static unsigned int primes[MPI_SIEVE_NPRIMES];
+    static const size_t count = mpi_sieve_build( primes );
+
+    *n = count;
+
+    return( primes );
+}
+
+/*
+ * Sieve search: first X + k * step, k >= 0, that is prime (and with
+ * (X - 1) / 2 prime if dh_flag is set), in the windows first,
+ * first + stride, ... only
+ *
+ * Window w covers X + k * step for w * WINDOW <= k < ( w + 1 ) * WINDOW.
+ * The residues of its base modulo the sieve primes are computed once;
+ * each window gets a bitmap in which the multiples of every sieve prime
+ * are struck out by stepping k by p, then the residues are moved on to
+ * the next window of the stride with one addition. Miller-Rabin only
+ * runs on the survivors.
+ */
+int mpi_gen_prime_search( mpi *X, int dh_flag, size_t first, size_t stride,
+                          int (*f_rng)(void *, unsigned char *, size_t),
+                          void *p_rng,
+                          int (*f_abort)(void *, size_t),
+                          void *p_abort )
+{
+    int ret;
+    size_t i, k, w, np, last;
+    t_uint r, p, step, inv, z, adv;
+    const unsigned int *primes;
+    t_uint *res = NULL;
+    unsigned char map[POLARSSL_MPI_SIEVE_WINDOW / 8];
+    mpi B, C, D, Y;
+
+    if( stride == 0 || X->s < 0 ||
+        mpi_cmp_int( X, POLARSSL_MPI_SIEVE_BOUND ) <= 0 ||
+        ( X->p[0] & ( dh_flag == 0 ? 1 : 3 ) ) != ( dh_flag == 0 ? 1 : 3 ) )
+        return( POLARSSL_ERR_MPI_BAD_INPUT_DATA );
+
+    primes = mpi_sieve_primes( &np );
+    if( np == 0 )
+        return( POLARSSL_ERR_MPI_MALLOC_FAILED );
+
     /*
-     * W = |X| - 1
-     * R = W >> lsb( W )
+     * Safe primes need (X - 1) / 2 odd as well: X = 3 mod 4
      */
-    MPI_CHK( mpi_sub_int( &W, X, 1 ) );
-    s = mpi_lsb( &W );
-    MPI_CHK( mpi_copy( &R, &W ) );
-    MPI_CHK( mpi_shift_r( &R, s ) );
+    step = ( dh_flag == 0 ) ? 2 : 4;
+
+    mpi_init( &B ); mpi_init( &C ); mpi_init( &D ); mpi_init( &Y );
+
+    res = (t_uint *) malloc( np * sizeof( t_uint ) );
+    if( res == NULL )
+    {
+        ret = POLARSSL_ERR_MPI_MALLOC_FAILED;
+        goto cleanup;
+    }
 
-    i = mpi_msb( X );
     /*
-     * HAC, table 4.4
+     * B = X + first * WINDOW * step, D = stride * WINDOW * step
      */
-    n = ( ( i >= 1300 ) ?  2 : ( i >=  850 ) ?  3 :
-          ( i >=  650 ) ?  4 : ( i >=  350 ) ?  8 :
-          ( i >=  250 ) ? 12 : ( i >=  150 ) ? 18 : 27 );
+    MPI_CHK( mpi_lset( &D, (t_sint)( POLARSSL_MPI_SIEVE_WINDOW * step ) ) );
+    MPI_CHK( mpi_mul_int( &B, &D, (t_sint) first ) );
+    MPI_CHK( mpi_add_mpi( &B, &B, X ) );
+    MPI_CHK( mpi_mul_int( &D, &D, (t_sint) stride ) );
 
-    for( i = 0; i < n; i++ )
-    {
-        /*
-         * pick a random A, 1 < A < |X| - 1
-         */
-        MPI_CHK( mpi_fill_random( &A, X->n * ciL, f_rng, p_rng ) );
+    for( i = 0; i < np; i++ )
+        MPI_CHK( mpi_mod_int( &res[i], &B, (t_sint) primes[i] ) );
 
-        if( mpi_cmp_mpi( &A, &W ) >= 0 )
+    for( w = first; ; w += stride )
+    {
+        if( f_abort != NULL && f_abort( p_abort, w ) != 0 )
         {
-            j = mpi_msb( &A ) - mpi_msb( &W );
-            MPI_CHK( mpi_shift_r( &A, j + 1 ) );
+            ret = POLARSSL_ERR_MPI_ABORTED;
+            goto cleanup;
         }
-        A.p[0] |= 3;
-
-        /*
-         * A = A^R mod |X|
-         */
-        MPI_CHK( mpi_exp_mod( &A, &A, &R, X, &RR ) );
 
-        if( mpi_cmp_mpi( &A, &W ) == 0 ||
-            mpi_cmp_int( &A,  1 ) == 0 )
-            continue;
+        memset( map, 0, sizeof( map ) );
 
-        j = 1;
-        while( j < s && mpi_cmp_mpi( &A, &W ) != 0 )
+        for( i = 0; i < np; i++ )
         {
+            p = primes[i];
+            r = res[i];
+
             /*
-             * A = A * A mod |X|
+             * inv = step^-1 mod p; B + k * step = 0 mod p for
+             * k = -r * inv mod p, and = 1 mod p (Y = 0 mod p) for
+             * k = (1 - r) * inv mod p
              */
-            MPI_CHK( mpi_mul_mpi( &T, &A, &A ) );
-            MPI_CHK( mpi_mod_mpi( &A, &T, X  ) );
+            inv = ( p + 1 ) / 2;
+            if( step == 4 )
+                inv = ( inv * inv ) % p;
 
-            if( mpi_cmp_int( &A, 1 ) == 0 )
-                break;
+            z = ( ( p - r ) % p ) * inv % p;
+
+            for( k = (size_t) z; k < POLARSSL_MPI_SIEVE_WINDOW; k += (size_t) p )
+                map[k >> 3] |= (unsigned char)( 1 << ( k & 7 ) );
+
+            if( dh_flag != 0 )
+            {
+                z = ( ( p + 1 - r ) % p ) * inv % p;
 
-            j++;
+                for( k = (size_t) z; k < POLARSSL_MPI_SIEVE_WINDOW; k += (size_t) p )
+                    map[k >> 3] |= (unsigned char)( 1 << ( k & 7 ) );
+            }
+
+            adv = ( (t_uint) POLARSSL_MPI_SIEVE_WINDOW * step ) % p;
+            adv = adv * ( (t_uint) stride % p ) % p;
+            res[i] = ( r + adv ) % p;
         }
 
-        /*
-         * not prime if A != |X| - 1 or A == 1
-         */
-        if( mpi_cmp_mpi( &A, &W ) != 0 ||
-            mpi_cmp_int( &A,  1 ) == 0 )
+        MPI_CHK( mpi_copy( &C, &B ) );
+
+        for( k = 0, last = 0; k < POLARSSL_MPI_SIEVE_WINDOW; k++ )
         {
-            ret = POLARSSL_ERR_MPI_NOT_ACCEPTABLE;
-            break;
+            if( map[k >> 3] & ( 1 << ( k & 7 ) ) )
+                continue;
+
+            if( f_abort != NULL && f_abort( p_abort, w ) != 0 )
+            {
+                ret = POLARSSL_ERR_MPI_ABORTED;
+                goto cleanup;
+            }
+
+            MPI_CHK( mpi_add_int( &C, &C, (t_sint)( ( k - last ) * step ) ) );
+            last = k;
+
+            ret = mpi_prime_test( &C, f_rng, p_rng );
+
+            if( ret == 0 && dh_flag != 0 )
+            {
+                MPI_CHK( mpi_copy( &Y, &C ) );
+                MPI_CHK( mpi_shift_r( &Y, 1 ) );
+                ret = mpi_prime_test( &Y, f_rng, p_rng );
+            }
+
+            if( ret == 0 )
+            {
+                MPI_CHK( mpi_copy( X, &C ) );
+                goto cleanup;
+            }
+
+            if( ret != POLARSSL_ERR_MPI_NOT_ACCEPTABLE )
+                goto cleanup;
         }
+
+        MPI_CHK( mpi_add_mpi( &B, &B, &D ) );
+    }
+
+cleanup:
+
+    if( res != NULL )
+    {
+        memset( res, 0, np * sizeof( t_uint ) );
+        free( res );
     }
 
-cleanup:
+    mpi_free( &B ); mpi_free( &C ); mpi_free( &D ); mpi_free( &Y );
+
+    return( ret );
+}
+
+/*
+ * Random starting point for the prime search
+ */
+int mpi_gen_prime_start( mpi *X, size_t nbits,
+                         int (*f_rng)(void *, unsigned char *, size_t),
+                         void *p_rng )
+{
+    int ret;
+    size_t k, n;
+
+    if( nbits < 3 || nbits > POLARSSL_MPI_MAX_BITS )
+        return( POLARSSL_ERR_MPI_BAD_INPUT_DATA );
 
-    X->s = xs;
+    n = BITS_TO_LIMBS( nbits );
+
+    MPI_CHK( mpi_fill_random( X, n * ciL, f_rng, p_rng ) );
+
+    k = mpi_msb( X );
+    if( k < nbits ) MPI_CHK( mpi_shift_l( X, nbits - k ) );
+    if( k > nbits ) MPI_CHK( mpi_shift_r( X, k - nbits ) );
+
+    X->p[0] |= 3;
 
-    mpi_free( &W ); mpi_free( &R ); mpi_free( &T ); mpi_free( &A );
-    mpi_free( &RR );
+cleanup:
 
     return( ret );
 }
@@ -1875,7 +3632,6 @@ int mpi_gen_prime( mpi *X, size_t nbits, int dh_flag,
                    void *p_rng )
 {
     int ret;
-    size_t k, n;
     mpi Y;
 
     if( nbits < 3 || nbits > POLARSSL_MPI_MAX_BITS )
@@ -1883,15 +3639,16 @@ int mpi_gen_prime( mpi *X, size_t nbits, int dh_flag,
 
     mpi_init( &Y );
 
-    n = BITS_TO_LIMBS( nbits );
-
-    MPI_CHK( mpi_fill_random( X, n * ciL, f_rng, p_rng ) );
-
-    k = mpi_msb( X );
-    if( k < nbits ) MPI_CHK( mpi_shift_l( X, nbits - k ) );
-    if( k > nbits ) MPI_CHK( mpi_shift_r( X, k - nbits ) );
+    MPI_CHK( mpi_gen_prime_start( X, nbits, f_rng, p_rng ) );
 
-    X->p[0] |= 3;
+    /*
+     * Candidates well above the sieve primes go through the sieve
+     */
+    if( nbits >= POLARSSL_MPI_SIEVE_MIN_BITS )
+    {
+        ret = mpi_gen_prime_search( X, dh_flag, 0, 1, f_rng, p_rng, NULL, NULL );
+        goto cleanup;
+    }
 
     if( dh_flag == 0 )
     {
@@ -1948,6 +3705,239 @@ static const int gcd_pairs[GCD_PAIR_COUNT][3] =
     { 768454923, 542167814, 1 }
 };
 
+/*
+ * Deterministic n-limb operand for the self test
+ */
+static int mpi_self_test_fill( mpi *X, size_t n, t_uint seed )
+{
+    int ret;
+    size_t i;
+
+    MPI_CHK( mpi_grow( X, n ) );
+    MPI_CHK( mpi_lset( X, 0 ) );
+
+    for( i = 0; i < n; i++ )
+    {
+        seed = seed * (t_uint) 6364136223846793005ULL +
+               (t_uint) 1442695040888963407ULL;
+        X->p[i] = seed ^ ( seed >> ( biL / 2 ) );
+    }
+
+    X->p[n - 1] |= (t_uint) 1 << ( biL - 1 );
+
+cleanup:
+
+    return( ret );
+}
+
+/*
+ * Reference product built limb by limb with mpi_mul_int(), which never
+ * reaches the Karatsuba path: X = A * B
+ */
+static int mpi_self_test_mul( mpi *X, const mpi *A, const mpi *B )
+{
+    int ret;
+    size_t j;
+    mpi T;
+
+    mpi_init( &T );
+
+    MPI_CHK( mpi_lset( X, 0 ) );
+
+    for( j = B->n; j > 0; j-- )
+    {
+        MPI_CHK( mpi_shift_l( X, biL ) );
+        MPI_CHK( mpi_mul_int( &T, A, (t_sint) B->p[j - 1] ) );
+        MPI_CHK( mpi_add_abs( X, X, &T ) );
+    }
+
+cleanup:
+
+    mpi_free( &T );
+
+    return( ret );
+}
+
+/*
+ * Deterministic RNG for the self test, *p_rng is the state
+ */
+static int mpi_self_test_rand( void *p_rng, unsigned char *output, size_t len )
+{
+    t_uint *state = (t_uint *) p_rng;
+
+    while( len-- > 0 )
+    {
+        *state = *state * (t_uint) 6364136223846793005ULL +
+                 (t_uint) 1442695040888963407ULL;
+        *output++ = (unsigned char)( *state >> ( biL - 8 ) );
+    }
+
+    return( 0 );
+}
+
+#define PSEUDO_COUNT    14
+
+/*
+ * Composites that fool one half of Baillie-PSW, Carmichael and Chernick
+ * numbers, and two primes. All are above the trial division primes, so
+ * each reaches the probable prime tests.
+ * Flags: prime, strong probable prime to base 2, strong Lucas probable prime
+ */
+static const char *pseudo_primes[PSEUDO_COUNT] =
+{
+    /* strong pseudoprimes to base 2 */
+    "3215031751", "3825123056546413051",
+    /* strong Lucas pseudoprimes */
+    "5459", "5777", "10877",
+    /* Carmichael numbers, the last two strong pseudoprimes to base 2 */
+    "1105", "1729", "15841", "29341",
+    /* Chernick numbers (6k+1)(12k+1)(18k+1), k = 51, 276 and 2^40 + 1840,
+       the last two strong pseudoprimes to base 2 */
+    "172947529", "27278026129",
+    "1722679495698579782078264212756705940929",
+    /* primes: a factor of the second number and 2^127 - 1 */
+    "34233211", "170141183460469231731687303715884105727"
+};
+
+static const int pseudo_flags[PSEUDO_COUNT][3] =
+{
+    { 0, 1, 0 }, { 0, 1, 0 },
+    { 0, 0, 1 }, { 0, 0, 1 }, { 0, 0, 1 },
+    { 0, 0, 0 }, { 0, 0, 0 }, { 0, 1, 0 }, { 0, 1, 0 },
+    { 0, 0, 0 }, { 0, 1, 0 }, { 0, 1, 0 },
+    { 1, 1, 1 }, { 1, 1, 1 }
+};
+
+/*
+ * Check mpi_is_prime() and the strong test to base 2 on X, and with
+ * Baillie-PSW also the strong Lucas test and mpi_bpsw(), against the
+ * expected outcomes. X odd and larger than the small primes.
+ * Returns 0, 1 on a wrong outcome or an error code.
+ */
+static int mpi_self_test_prime( mpi *X, int prime, int base2, int lucas,
+                                t_uint *rng_state )
+{
+    int ret, res[4];
+    size_t i, n;
+    mpi A;
+    mpi_prime_ctx ctx;
+
+    mpi_init( &A );
+
+    MPI_CHK( mpi_prime_setup( &ctx, X ) );
+
+    res[0] = mpi_is_prime( X, mpi_self_test_rand, rng_state );
+
+    MPI_CHK( mpi_lset( &A, 2 ) );
+    res[1] = mpi_prime_strong( &ctx, X, &A );
+
+    n = 2;
+#if defined(POLARSSL_MPI_BPSW)
+    res[n++] = mpi_prime_lucas( &ctx, X );
+    res[n++] = mpi_bpsw( X );
+#else
+    ((void) lucas);
+#endif
+
+    for( i = 0; i < n; i++ )
+    {
+        if( res[i] != 0 && res[i] != POLARSSL_ERR_MPI_NOT_ACCEPTABLE )
+        {
+            ret = res[i];
+            goto cleanup;
+        }
+    }
+
+    if( ( res[0] == 0 ) != prime || ( res[1] == 0 ) != base2 )
+        ret = 1;
+
+#if defined(POLARSSL_MPI_BPSW)
+    if( ( res[2] == 0 ) != lucas || ( res[3] == 0 ) != prime )
+        ret = 1;
+#endif
+
+cleanup:
+
+    mpi_free( &A );
+    mpi_prime_free( &ctx );
+
+    return( ret );
+}
+
+#define MULTI_COUNT     21
+
+/*
+ * mpi_exp_mod_multi() on a mixed batch against one scalar exponentiation
+ * per operation: two full groups of equal sizes for the lane engine, then
+ * a tail of different sizes and a short exponent for the per-operation
+ * fallback. One operation writes over its base.
+ * Returns 0, 1 on a wrong result or an error code.
+ */
+static int mpi_self_test_multi( void )
+{
+    static const size_t multi_bits[MULTI_COUNT] =
+    {
+        1024, 1024, 1024, 1024, 1024, 1024, 1024, 1024,
+        2048, 2048, 2048, 2048, 2048, 2048, 2048, 2048,
+        512, 1024, 2048, 1536, 3072
+    };
+    int ret;
+    size_t i;
+    t_uint mm;
+    mpi MX[MULTI_COUNT], MA[MULTI_COUNT], ME[MULTI_COUNT];
+    mpi MN[MULTI_COUNT], MR[MULTI_COUNT];
+    mpi *px[MULTI_COUNT];
+    const mpi *pa[MULTI_COUNT], *pe[MULTI_COUNT], *pn[MULTI_COUNT];
+
+    for( i = 0; i < MULTI_COUNT; i++ )
+    {
+        mpi_init( &MX[i] ); mpi_init( &MA[i] ); mpi_init( &ME[i] );
+        mpi_init( &MN[i] ); mpi_init( &MR[i] );
+
+        px[i] = &MX[i]; pa[i] = &MA[i]; pe[i] = &ME[i]; pn[i] = &MN[i];
+    }
+
+    for( i = 0; i < MULTI_COUNT; i++ )
+    {
+        MPI_CHK( mpi_self_test_fill( &MN[i], multi_bits[i] / biL, 23 + i ) );
+        MN[i].p[0] |= 1;
+        MPI_CHK( mpi_self_test_fill( &MA[i], multi_bits[i] / biL, 29 + i ) );
+        MPI_CHK( mpi_mod_mpi( &MA[i], &MA[i], &MN[i] ) );
+        MPI_CHK( mpi_self_test_fill( &ME[i], multi_bits[i] / biL, 31 + i ) );
+    }
+
+    MPI_CHK( mpi_lset( &ME[MULTI_COUNT - 2], 65537 ) );
+
+    for( i = 0; i < MULTI_COUNT; i++ )
+    {
+        mpi_montg_init( &mm, &MN[i] );
+        MPI_CHK( mpi_exp_mod_hlp( &MR[i], &MA[i], &ME[i], &MN[i], mm, NULL ) );
+    }
+
+    px[3] = &MA[3];
+
+    MPI_CHK( mpi_exp_mod_multi( px, pa, pe, pn, MULTI_COUNT ) );
+
+    for( i = 0; i < MULTI_COUNT; i++ )
+    {
+        if( mpi_cmp_mpi( px[i], &MR[i] ) != 0 )
+        {
+            ret = 1;
+            break;
+        }
+    }
+
+cleanup:
+
+    for( i = 0; i < MULTI_COUNT; i++ )
+    {
+        mpi_free( &MX[i] ); mpi_free( &MA[i] ); mpi_free( &ME[i] );
+        mpi_free( &MN[i] ); mpi_free( &MR[i] );
+    }
+
+    return( ret );
+}
+
 /*
  * Checkup routine
  */
@@ -2092,6 +4082,203 @@ int mpi_self_test( int verbose )
     if( verbose != 0 )
         printf( "passed\n" );
 
+    MPI_CHK( mpi_sqr( &X, &U ) );
+    MPI_CHK( mpi_mul_mpi( &Y, &U, &U ) );
+
+    if( verbose != 0 )
+        printf( "  MPI test #6 (sqr_mpi): " );
+
+    if( mpi_cmp_mpi( &X, &Y ) != 0 )
+    {
+        if( verbose != 0 )
+            printf( "failed\n" );
+
+        return( 1 );
+    }
+
+    if( verbose != 0 )
+        printf( "passed\n" );
+
+    /*
+     * Operands of at least POLARSSL_MPI_KARATSUBA_CUTOFF limbs: equal
+     * sizes, an odd size that splits unevenly, and a long operand cut
+     * into chunks of the short one
+     */
+    if( verbose != 0 )
+        printf( "  MPI test #7 (karatsuba): " );
+
+    {
+        /*
+         * Limbs: multiple of the cutoff and extra limbs, for each operand
+         */
+        static const size_t kara_sizes[3][4] =
+        {
+            { 1, 0, 1, 0 }, { 2, 1, 2, 1 }, { 3, 2, 1, 1 }
+        };
+        size_t n1, n2;
+
+        for( i = 0; i < 3; i++ )
+        {
+            n1 = kara_sizes[i][0] * POLARSSL_MPI_KARATSUBA_CUTOFF + kara_sizes[i][1];
+            n2 = kara_sizes[i][2] * POLARSSL_MPI_KARATSUBA_CUTOFF + kara_sizes[i][3];
+
+            MPI_CHK( mpi_self_test_fill( &A, n1, 1 + i ) );
+            MPI_CHK( mpi_self_test_fill( &E, n2, 7 + i ) );
+
+            MPI_CHK( mpi_mul_mpi( &X, &A, &E ) );
+            MPI_CHK( mpi_self_test_mul( &Y, &A, &E ) );
+            MPI_CHK( mpi_sqr( &U, &A ) );
+            MPI_CHK( mpi_self_test_mul( &V, &A, &A ) );
+
+            if( mpi_cmp_mpi( &X, &Y ) != 0 || mpi_cmp_mpi( &U, &V ) != 0 )
+            {
+                if( verbose != 0 )
+                    printf( "failed at %d\n", i );
+
+                return( 1 );
+            }
+        }
+    }
+
+    if( verbose != 0 )
+        printf( "passed\n" );
+
+#if defined(POLARSSL_MPI_HAVE_AVX2)
+    /*
+     * The SIMD engines are picked at run time: compare every engine this
+     * host has with the scalar Montgomery path
+     */
+    if( verbose != 0 )
+        printf( "  MPI test #8 (exp_mod_avx): " );
+
+    {
+        static const size_t avx_bits[3] = { 1024, 2048, 4096 };
+        t_uint mm;
+        int engine, tested = 0;
+
+        for( i = 0; i < 3; i++ )
+        {
+            MPI_CHK( mpi_self_test_fill( &N, avx_bits[i] / biL, 11 + i ) );
+            N.p[0] |= 1;
+            MPI_CHK( mpi_self_test_fill( &A, avx_bits[i] / biL, 13 + i ) );
+            MPI_CHK( mpi_mod_mpi( &A, &A, &N ) );
+            MPI_CHK( mpi_self_test_fill( &E, avx_bits[i] / biL, 17 + i ) );
+
+            mpi_montg_init( &mm, &N );
+            MPI_CHK( mpi_exp_mod_hlp( &Y, &A, &E, &N, mm, NULL ) );
+
+            for( engine = POLARSSL_MPI_ENGINE_AVX2;
+                 engine <= mpi_avx_engine( avx_bits[i] ); engine++ )
+            {
+                MPI_CHK( mpi_avx_rr( engine, &U, &N ) );
+                MPI_CHK( mpi_exp_mod_avx( engine, &X, &A, &E, &N, &U ) );
+
+                if( mpi_cmp_mpi( &X, &Y ) != 0 )
+                {
+                    if( verbose != 0 )
+                        printf( "failed at %d bits, engine %d\n",
+                                (int) avx_bits[i], engine );
+
+                    return( 1 );
+                }
+
+                tested++;
+            }
+        }
+
+        if( verbose != 0 )
+            printf( tested > 0 ? "passed\n" : "skipped (no engine)\n" );
+    }
+#endif
+
+    if( verbose != 0 )
+        printf( "  MPI test #9 (exp_mod_multi): " );
+
+    if( ( ret = mpi_self_test_multi() ) == 1 )
+    {
+        if( verbose != 0 )
+            printf( "failed\n" );
+
+        return( 1 );
+    }
+
+    MPI_CHK( ret );
+
+    if( verbose != 0 )
+        printf( "passed\n" );
+
+    /*
+     * Inputs that pass one half of Baillie-PSW must fail the other
+     */
+    if( verbose != 0 )
+        printf( "  MPI test #10 (pseudoprimes): " );
+
+    {
+        t_uint rng_state = 37;
+
+        for( i = 0; i < PSEUDO_COUNT; i++ )
+        {
+            MPI_CHK( mpi_read_string( &X, 10, pseudo_primes[i] ) );
+
+            if( ( ret = mpi_self_test_prime( &X, pseudo_flags[i][0],
+                    pseudo_flags[i][1], pseudo_flags[i][2], &rng_state ) ) == 1 )
+            {
+                if( verbose != 0 )
+                    printf( "failed at %d\n", i );
+
+                return( 1 );
+            }
+
+            MPI_CHK( ret );
+        }
+    }
+
+    if( verbose != 0 )
+        printf( "passed\n" );
+
+    /*
+     * Sizes from POLARSSL_MPI_SIEVE_MIN_BITS up go through the sieve in
+     * mpi_gen_prime_search(); the result is checked again test by test,
+     * and for dh_flag also ( X - 1 ) / 2
+     */
+    if( verbose != 0 )
+        printf( "  MPI test #11 (gen_prime): " );
+
+    {
+        t_uint rng_state = 41;
+        size_t nbits;
+
+        for( i = 0; i < 2; i++ )
+        {
+            nbits = ( 4 - 2 * i ) * POLARSSL_MPI_SIEVE_MIN_BITS;
+
+            MPI_CHK( mpi_gen_prime( &X, nbits, i, mpi_self_test_rand, &rng_state ) );
+            MPI_CHK( mpi_copy( &Y, &X ) );
+            MPI_CHK( mpi_shift_r( &Y, 1 ) );
+
+            ret = mpi_self_test_prime( &X, 1, 1, 1, &rng_state );
+
+            if( ret == 0 && mpi_msb( &X ) != nbits )
+                ret = 1;
+
+            if( ret == 0 && i == 1 )
+                ret = mpi_self_test_prime( &Y, 1, 1, 1, &rng_state );
+
+            if( ret == 1 )
+            {
+                if( verbose != 0 )
+                    printf( "failed\n" );
+
+                return( 1 );
+            }
+
+            MPI_CHK( ret );
+        }
+    }
+
+    if( verbose != 0 )
+        printf( "passed\n" );
+
 cleanup:
 
     if( ret != 0 && verbose != 0 )
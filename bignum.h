@@ -1,7 +1,7 @@
 /**
  * \file bignum.h
  *
- * :  Multi-precision integer library
+ * Описание:  Multi-precision integer library
  *
  *  Copyright (C) 2006-2010, Brainspark B.V.
  *
@@ -40,6 +40,7 @@
 #define POLARSSL_ERR_MPI_DIVISION_BY_ZERO                  -0x000C  /**< The input argument for division is zero, which is not allowed. */
 #define POLARSSL_ERR_MPI_NOT_ACCEPTABLE                    -0x000E  /**< The input arguments are not acceptable. */
 #define POLARSSL_ERR_MPI_MALLOC_FAILED                     -0x0010  /**< Memory allocation failed. */
+#define POLARSSL_ERR_MPI_ABORTED                           -0x0012  /**< The operation was cancelled by the caller. */
 
 #define MPI_CHK(f) if( ( ret = f ) != 0 ) goto cleanup
 
@@ -59,6 +60,34 @@
  */
 #define POLARSSL_MPI_WINDOW_SIZE                           6        /**< Maximum windows size used. */
 
+/*
+ * Operand size (in limbs) from which mpi_mul_mpi() switches from the
+ * schoolbook method to Karatsuba multiplication. Below the cutoff the
+ * Karatsuba recursion also falls back to the schoolbook base case.
+ * Measured crossover with 64-bit limbs: schoolbook is faster up to 40
+ * limbs, Karatsuba from 48.
+ * ( Default: 48 limbs => 3072 bits with 64-bit limbs )
+ *
+ * Minimum value: 2.
+ */
+#define POLARSSL_MPI_KARATSUBA_CUTOFF                      48       /**< Minimum operand size in limbs for Karatsuba. */
+
+/*
+ * Exponents of at most this many bits (e = 3, 65537, ...) are handled by
+ * mpi_exp_mod() with plain square-and-multiply, without a window table.
+ */
+#define POLARSSL_MPI_SHORT_EXP_BITS                        24       /**< Maximum exponent size for the short exponent path. */
+
+/*
+ * Prime sieve used by mpi_gen_prime(): candidates are sieved by all odd
+ * primes below POLARSSL_MPI_SIEVE_BOUND, POLARSSL_MPI_SIEVE_WINDOW at a
+ * time, before any Miller-Rabin test. Sizes below
+ * POLARSSL_MPI_SIEVE_MIN_BITS keep the plain X += 2 search.
+ */
+#define POLARSSL_MPI_SIEVE_BOUND                           65536    /**< Sieve primes are below this bound. */
+#define POLARSSL_MPI_SIEVE_WINDOW                          4096     /**< Candidates per sieve window, multiple of 8. */
+#define POLARSSL_MPI_SIEVE_MIN_BITS                        64       /**< Smallest prime size that uses the sieve. */
+
 /*
  * Maximum size of MPIs allowed in bits and bytes for user-MPIs.
  * ( Default: 512 bytes => 4096 bits )
@@ -115,7 +144,7 @@ typedef unsigned long  t_udbl;
 #endif
 
 /**
- * :          MPI structure
+ * Описание:          MPI structure
  */
 typedef struct
 {
@@ -125,387 +154,415 @@ typedef struct
 }
 mpi;
 
+/**
+ * Описание:          Montgomery context: everything mpi_exp_mod() derives from
+ *                 the modulus alone, computed once by mpi_mont_setup()
+ */
+typedef struct
+{
+    mpi N;              /*!<  modulus, odd                          */
+    t_uint mm;          /*!<  -N^-1 mod 2^biL                       */
+    mpi RR;             /*!<  R^2 mod N, R = 2^(biL * N.n)          */
+    int engine;         /*!<  SIMD engine for N, 0 if none          */
+    mpi RRs;            /*!<  R^2 mod N in the SIMD engine's radix  */
+}
+mpi_mont_ctx;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 /**
- * :           Initialize one MPI
+ * Описание:           Initialize one MPI
  *
- * . X         One MPI to initialize.
+ * Парам. X         One MPI to initialize.
  */
 void mpi_init( mpi *X );
 
 /**
- * :          Unallocate one MPI
+ * Описание:          Unallocate one MPI
  *
- * . X        One MPI to unallocate.
+ * Парам. X        One MPI to unallocate.
  */
 void mpi_free( mpi *X );
 
 /**
- * :          Enlarge to the specified number of limbs
+ * Описание:          Enlarge to the specified number of limbs
  *
- * . X        MPI to grow
- * . nblimbs  The target number of limbs
+ * Парам. X        MPI to grow
+ * Парам. nblimbs  The target number of limbs
  *
- * . :         0 if successful,
+ * Возвр. :         0 if successful,
  *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed
  */
 int mpi_grow( mpi *X, size_t nblimbs );
 
 /**
- * :          Copy the contents of Y into X
+ * Описание:          Copy the contents of Y into X
  *
- * . X        Destination MPI
- * . Y        Source MPI
+ * Парам. X        Destination MPI
+ * Парам. Y        Source MPI
  *
- * . :         0 if successful,
+ * Возвр. :         0 if successful,
  *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed
  */
 int mpi_copy( mpi *X, const mpi *Y );
 
 /**
- * :          Swap the contents of X and Y
+ * Описание:          Swap the contents of X and Y
  *
- * . X        First MPI value
- * . Y        Second MPI value
+ * Парам. X        First MPI value
+ * Парам. Y        Second MPI value
  */
 void mpi_swap( mpi *X, mpi *Y );
 
 /**
- * :          Set value from integer
+ * Описание:          Set value from integer
  *
- * . X        MPI to set
- * . z        Value to use
+ * Парам. X        MPI to set
+ * Парам. z        Value to use
  *
- * . :         0 if successful,
+ * Возвр. :         0 if successful,
  *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed
  */
 int mpi_lset( mpi *X, t_sint z );
 
 /*
- * :          Get a specific bit from X
+ * Описание:          Get a specific bit from X
  *
- * . X        MPI to use
- * . pos      Zero-based index of the bit in X
+ * Парам. X        MPI to use
+ * Парам. pos      Zero-based index of the bit in X
  *
- * . :         Either a 0 or a 1
+ * Возвр. :         Either a 0 or a 1
  */
 int mpi_get_bit( mpi *X, size_t pos );
 
 /*
- * :          Set a bit of X to a specific value of 0 or 1
+ * Описание:          Set a bit of X to a specific value of 0 or 1
  *
- * .:        Will grow X if necessary to set a bit to 1 in a not yet
+ * Допол.:        Will grow X if necessary to set a bit to 1 in a not yet
  *                 existing limb. Will not grow if bit should be set to 0
  *
- * . X        MPI to use
- * . pos      Zero-based index of the bit in X
- * . val      The value to set the bit to (0 or 1)
+ * Парам. X        MPI to use
+ * Парам. pos      Zero-based index of the bit in X
+ * Парам. val      The value to set the bit to (0 or 1)
  *
- * . :         0 if successful,
+ * Возвр. :         0 if successful,
  *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed,
  *                 POLARSSL_ERR_MPI_BAD_INPUT_DATA if val is not 0 or 1
  */
 int mpi_set_bit( mpi *X, size_t pos, unsigned char val );
 
 /**
- * :          Return the number of least significant bits
+ * Описание:          Return the number of least significant bits
  *
- * . X        MPI to use
+ * Парам. X        MPI to use
  */
 size_t mpi_lsb( const mpi *X );
 
 /**
- * :          Return the number of most significant bits
+ * Описание:          Return the number of most significant bits
  *
- * . X        MPI to use
+ * Парам. X        MPI to use
  */
 size_t mpi_msb( const mpi *X );
 
 /**
- * :          Return the total size in bytes
+ * Описание:          Return the total size in bytes
  *
- * . X        MPI to use
+ * Парам. X        MPI to use
  */
 size_t mpi_size( const mpi *X );
 
 /**
- * :          Import from an ASCII string
+ * Описание:          Import from an ASCII string
  *
- * . X        Destination MPI
- * . radix    Input numeric base
- * . s        Null-terminated string buffer
+ * Парам. X        Destination MPI
+ * Парам. radix    Input numeric base
+ * Парам. s        Null-terminated string buffer
  *
- * . :         0 if successful, or a POLARSSL_ERR_MPI_XXX error code
+ * Возвр. :         0 if successful, or a POLARSSL_ERR_MPI_XXX error code
  */
 int mpi_read_string( mpi *X, int radix, const char *s );
 
 /**
- * :          Export into an ASCII string
+ * Описание:          Export into an ASCII string
  *
- * . X        Source MPI
- * . radix    Output numeric base
- * . s        String buffer
- * . slen     String buffer size
+ * Парам. X        Source MPI
+ * Парам. radix    Output numeric base
+ * Парам. s        String buffer
+ * Парам. slen     String buffer size
  *
- * . :         0 if successful, or a POLARSSL_ERR_MPI_XXX error code.
+ * Возвр. :         0 if successful, or a POLARSSL_ERR_MPI_XXX error code.
  *                 *slen is always updated to reflect the amount
  *                 of data that has (or would have) been written.
  *
- * .:        Call this function with *slen = 0 to obtain the
+ * Допол.:        Call this function with *slen = 0 to obtain the
  *                 minimum required buffer size in *slen.
  */
 int mpi_write_string( const mpi *X, int radix, char *s, size_t *slen );
 
 /**
- * :          Read X from an opened file
+ * Описание:          Read X from an opened file
  *
- * . X        Destination MPI
- * . radix    Input numeric base
- * . fin      Input file handle
+ * Парам. X        Destination MPI
+ * Парам. radix    Input numeric base
+ * Парам. fin      Input file handle
  *
- * . :         0 if successful, POLARSSL_ERR_MPI_BUFFER_TOO_SMALL if
+ * Возвр. :         0 if successful, POLARSSL_ERR_MPI_BUFFER_TOO_SMALL if
  *                 the file read buffer is too small or a
  *                 POLARSSL_ERR_MPI_XXX error code
  */
 int mpi_read_file( mpi *X, int radix, FILE *fin );
 
 /**
- * :          Write X into an opened file, or stdout if fout is NULL
+ * Описание:          Write X into an opened file, or stdout if fout is NULL
  *
- * . p        Prefix, can be NULL
- * . X        Source MPI
- * . radix    Output numeric base
- * . fout     Output file handle (can be NULL)
+ * Парам. p        Prefix, can be NULL
+ * Парам. X        Source MPI
+ * Парам. radix    Output numeric base
+ * Парам. fout     Output file handle (can be NULL)
  *
- * . :         0 if successful, or a POLARSSL_ERR_MPI_XXX error code
+ * Возвр. :         0 if successful, or a POLARSSL_ERR_MPI_XXX error code
  *
- * .:        Set fout == NULL to print X on the console.
+ * Допол.:        Set fout == NULL to print X on the console.
  */
 int mpi_write_file( const char *p, const mpi *X, int radix, FILE *fout );
 
 /**
- * :          Import X from unsigned binary data, big endian
+ * Описание:          Import X from unsigned binary data, big endian
  *
- * . X        Destination MPI
- * . buf      Input buffer
- * . buflen   Input buffer size
+ * Парам. X        Destination MPI
+ * Парам. buf      Input buffer
+ * Парам. buflen   Input buffer size
  *
- * . :         0 if successful,
+ * Возвр. :         0 if successful,
  *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed
  */
 int mpi_read_binary( mpi *X, const unsigned char *buf, size_t buflen );
 
 /**
- * :          Export X into unsigned binary data, big endian
+ * Описание:          Export X into unsigned binary data, big endian
  *
- * . X        Source MPI
- * . buf      Output buffer
- * . buflen   Output buffer size
+ * Парам. X        Source MPI
+ * Парам. buf      Output buffer
+ * Парам. buflen   Output buffer size
  *
- * . :         0 if successful,
+ * Возвр. :         0 if successful,
  *                 POLARSSL_ERR_MPI_BUFFER_TOO_SMALL if buf isn't large enough
  */
 int mpi_write_binary( const mpi *X, unsigned char *buf, size_t buflen );
 
 /**
- * :          Left-shift: X <<= count
+ * Описание:          Left-shift: X <<= count
  *
- * . X        MPI to shift
- * . count    Amount to shift
+ * Парам. X        MPI to shift
+ * Парам. count    Amount to shift
  *
- * . :         0 if successful,
+ * Возвр. :         0 if successful,
  *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed
  */
 int mpi_shift_l( mpi *X, size_t count );
 
 /**
- * :          Right-shift: X >>= count
+ * Описание:          Right-shift: X >>= count
  *
- * . X        MPI to shift
- * . count    Amount to shift
+ * Парам. X        MPI to shift
+ * Парам. count    Amount to shift
  *
- * . :         0 if successful,
+ * Возвр. :         0 if successful,
  *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed
  */
 int mpi_shift_r( mpi *X, size_t count );
 
 /**
- * :          Compare unsigned values
+ * Описание:          Compare unsigned values
  *
- * . X        Left-hand MPI
- * . Y        Right-hand MPI
+ * Парам. X        Left-hand MPI
+ * Парам. Y        Right-hand MPI
  *
- * . :         1 if |X| is greater than |Y|,
+ * Возвр. :         1 if |X| is greater than |Y|,
  *                -1 if |X| is lesser  than |Y| or
  *                 0 if |X| is equal to |Y|
  */
 int mpi_cmp_abs( const mpi *X, const mpi *Y );
 
 /**
- * :          Compare signed values
+ * Описание:          Compare signed values
  *
- * . X        Left-hand MPI
- * . Y        Right-hand MPI
+ * Парам. X        Left-hand MPI
+ * Парам. Y        Right-hand MPI
  *
- * . :         1 if X is greater than Y,
+ * Возвр. :         1 if X is greater than Y,
  *                -1 if X is lesser  than Y or
  *                 0 if X is equal to Y
  */
 int mpi_cmp_mpi( const mpi *X, const mpi *Y );
 
 /**
- * :          Compare signed values
+ * Описание:          Compare signed values
  *
- * . X        Left-hand MPI
- * . z        The integer value to compare to
+ * Парам. X        Left-hand MPI
+ * Парам. z        The integer value to compare to
  *
- * . :         1 if X is greater than z,
+ * Возвр. :         1 if X is greater than z,
  *                -1 if X is lesser  than z or
  *                 0 if X is equal to z
  */
 int mpi_cmp_int( const mpi *X, t_sint z );
 
 /**
- * :          Unsigned addition: X = |A| + |B|
+ * Описание:          Unsigned addition: X = |A| + |B|
  *
- * . X        Destination MPI
- * . A        Left-hand MPI
- * . B        Right-hand MPI
+ * Парам. X        Destination MPI
+ * Парам. A        Left-hand MPI
+ * Парам. B        Right-hand MPI
  *
- * . :         0 if successful,
+ * Возвр. :         0 if successful,
  *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed
  */
 int mpi_add_abs( mpi *X, const mpi *A, const mpi *B );
 
 /**
- * :          Unsigned substraction: X = |A| - |B|
+ * Описание:          Unsigned substraction: X = |A| - |B|
  *
- * . X        Destination MPI
- * . A        Left-hand MPI
- * . B        Right-hand MPI
+ * Парам. X        Destination MPI
+ * Парам. A        Left-hand MPI
+ * Парам. B        Right-hand MPI
  *
- * . :         0 if successful,
+ * Возвр. :         0 if successful,
  *                 POLARSSL_ERR_MPI_NEGATIVE_VALUE if B is greater than A
  */
 int mpi_sub_abs( mpi *X, const mpi *A, const mpi *B );
 
 /**
- * :          Signed addition: X = A + B
+ * Описание:          Signed addition: X = A + B
  *
- * . X        Destination MPI
- * . A        Left-hand MPI
- * . B        Right-hand MPI
+ * Парам. X        Destination MPI
+ * Парам. A        Left-hand MPI
+ * Парам. B        Right-hand MPI
  *
- * . :         0 if successful,
+ * Возвр. :         0 if successful,
  *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed
  */
 int mpi_add_mpi( mpi *X, const mpi *A, const mpi *B );
 
 /**
- * :          Signed substraction: X = A - B
+ * Описание:          Signed substraction: X = A - B
  *
- * . X        Destination MPI
- * . A        Left-hand MPI
- * . B        Right-hand MPI
+ * Парам. X        Destination MPI
+ * Парам. A        Left-hand MPI
+ * Парам. B        Right-hand MPI
  *
- * . :         0 if successful,
+ * Возвр. :         0 if successful,
  *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed
  */
 int mpi_sub_mpi( mpi *X, const mpi *A, const mpi *B );
 
 /**
- * :          Signed addition: X = A + b
+ * Описание:          Signed addition: X = A + b
  *
- * . X        Destination MPI
- * . A        Left-hand MPI
- * . b        The integer value to add
+ * Парам. X        Destination MPI
+ * Парам. A        Left-hand MPI
+ * Парам. b        The integer value to add
  *
- * . :         0 if successful,
+ * Возвр. :         0 if successful,
  *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed
  */
 int mpi_add_int( mpi *X, const mpi *A, t_sint b );
 
 /**
- * :          Signed substraction: X = A - b
+ * Описание:          Signed substraction: X = A - b
  *
- * . X        Destination MPI
- * . A        Left-hand MPI
- * . b        The integer value to subtract
+ * Парам. X        Destination MPI
+ * Парам. A        Left-hand MPI
+ * Парам. b        The integer value to subtract
  *
- * . :         0 if successful,
+ * Возвр. :         0 if successful,
  *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed
  */
 int mpi_sub_int( mpi *X, const mpi *A, t_sint b );
 
 /**
- * :          Baseline multiplication: X = A * B
+ * Описание:          Baseline multiplication: X = A * B
  *
- * . X        Destination MPI
- * . A        Left-hand MPI
- * . B        Right-hand MPI
+ * Парам. X        Destination MPI
+ * Парам. A        Left-hand MPI
+ * Парам. B        Right-hand MPI
  *
- * . :         0 if successful,
+ * Возвр. :         0 if successful,
  *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed
  */
 int mpi_mul_mpi( mpi *X, const mpi *A, const mpi *B );
 
 /**
- * :          Baseline multiplication: X = A * b
+ * Описание:          Squaring: X = A * A
+ *                 Each cross product is only computed once, which saves
+ *                 close to half of the limb multiplications of
+ *                 mpi_mul_mpi( X, A, A ).
+ *
+ * Парам. X        Destination MPI
+ * Парам. A        Source MPI (can be X)
+ *
+ * Возвр. :         0 if successful,
+ *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed
+ */
+int mpi_sqr( mpi *X, const mpi *A );
+
+/**
+ * Описание:          Baseline multiplication: X = A * b
  *                 Note: b is an unsigned integer type, thus
  *                 Negative values of b are ignored.
  *
- * . X        Destination MPI
- * . A        Left-hand MPI
- * . b        The integer value to multiply with
+ * Парам. X        Destination MPI
+ * Парам. A        Left-hand MPI
+ * Парам. b        The integer value to multiply with
  *
- * . :         0 if successful,
+ * Возвр. :         0 if successful,
  *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed
  */
 int mpi_mul_int( mpi *X, const mpi *A, t_sint b );
 
 /**
- * :          Division by mpi: A = Q * B + R
+ * Описание:          Division by mpi: A = Q * B + R
  *
- * . Q        Destination MPI for the quotient
- * . R        Destination MPI for the rest value
- * . A        Left-hand MPI
- * . B        Right-hand MPI
+ * Парам. Q        Destination MPI for the quotient
+ * Парам. R        Destination MPI for the rest value
+ * Парам. A        Left-hand MPI
+ * Парам. B        Right-hand MPI
  *
- * . :         0 if successful,
+ * Возвр. :         0 if successful,
  *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed,
  *                 POLARSSL_ERR_MPI_DIVISION_BY_ZERO if B == 0
  *
- * .:        Either Q or R can be NULL.
+ * Допол.:        Either Q or R can be NULL.
  */
 int mpi_div_mpi( mpi *Q, mpi *R, const mpi *A, const mpi *B );
 
 /**
- * :          Division by int: A = Q * b + R
+ * Описание:          Division by int: A = Q * b + R
  *
- * . Q        Destination MPI for the quotient
- * . R        Destination MPI for the rest value
- * . A        Left-hand MPI
- * . b        Integer to divide by
+ * Парам. Q        Destination MPI for the quotient
+ * Парам. R        Destination MPI for the rest value
+ * Парам. A        Left-hand MPI
+ * Парам. b        Integer to divide by
  *
- * . :         0 if successful,
+ * Возвр. :         0 if successful,
  *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed,
  *                 POLARSSL_ERR_MPI_DIVISION_BY_ZERO if b == 0
  *
- * .:        Either Q or R can be NULL.
+ * Допол.:        Either Q or R can be NULL.
  */
 int mpi_div_int( mpi *Q, mpi *R, const mpi *A, t_sint b );
 
 /**
- * :          Modulo: R = A mod B
+ * Описание:          Modulo: R = A mod B
  *
- * . R        Destination MPI for the rest value
- * . A        Left-hand MPI
- * . B        Right-hand MPI
+ * Парам. R        Destination MPI for the rest value
+ * Парам. A        Left-hand MPI
+ * Парам. B        Right-hand MPI
  *
- * . :         0 if successful,
+ * Возвр. :         0 if successful,
  *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed,
  *                 POLARSSL_ERR_MPI_DIVISION_BY_ZERO if B == 0,
  *                 POLARSSL_ERR_MPI_NEGATIVE_VALUE if B < 0
@@ -513,13 +570,13 @@ int mpi_div_int( mpi *Q, mpi *R, const mpi *A, t_sint b );
 int mpi_mod_mpi( mpi *R, const mpi *A, const mpi *B );
 
 /**
- * :          Modulo: r = A mod b
+ * Описание:          Modulo: r = A mod b
  *
- * . r        Destination t_uint
- * . A        Left-hand MPI
- * . b        Integer to divide by
+ * Парам. r        Destination t_uint
+ * Парам. A        Left-hand MPI
+ * Парам. b        Integer to divide by
  *
- * . :         0 if successful,
+ * Возвр. :         0 if successful,
  *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed,
  *                 POLARSSL_ERR_MPI_DIVISION_BY_ZERO if b == 0,
  *                 POLARSSL_ERR_MPI_NEGATIVE_VALUE if b < 0
@@ -527,33 +584,201 @@ int mpi_mod_mpi( mpi *R, const mpi *A, const mpi *B );
 int mpi_mod_int( t_uint *r, const mpi *A, t_sint b );
 
 /**
- * :          Sliding-window exponentiation: X = A^E mod N
+ * Описание:          Sliding-window exponentiation: X = A^E mod N
  *
- * . X        Destination MPI 
- * . A        Left-hand MPI
- * . E        Exponent MPI
- * . N        Modular MPI
- * . _RR      Speed-up MPI used for recalculations
+ * Парам. X        Destination MPI 
+ * Парам. A        Left-hand MPI
+ * Парам. E        Exponent MPI
+ * Парам. N        Modular MPI
+ * Парам. _RR      Speed-up MPI used for recalculations
  *
- * . :         0 if successful,
+ * Возвр. :         0 if successful,
  *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed,
  *                 POLARSSL_ERR_MPI_BAD_INPUT_DATA if N is negative or even
  *
- * .:        _RR is used to avoid re-computing R*R mod N across
+ * Допол.:        _RR is used to avoid re-computing R*R mod N across
  *                 multiple calls, which speeds up things a bit. It can
  *                 be set to NULL if the extra performance is unneeded.
  */
 int mpi_exp_mod( mpi *X, const mpi *A, const mpi *E, const mpi *N, mpi *_RR );
 
 /**
- * :          Fill an MPI X with size bytes of random
+ * Описание:          Initialize a Montgomery context
+ *
+ * Парам. ctx      Context to initialize
+ */
+void mpi_mont_init( mpi_mont_ctx *ctx );
+
+/**
+ * Описание:          Unallocate a Montgomery context
+ *
+ * Парам. ctx      Context to unallocate
+ */
+void mpi_mont_free( mpi_mont_ctx *ctx );
+
+/**
+ * Описание:          Prepare a Montgomery context for the modulus N:
+ *                 copy N, compute mm and R^2 mod N
+ *
+ * Парам. ctx      Initialized context
+ * Парам. N        Modular MPI
+ *
+ * Возвр. :         0 if successful,
+ *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed,
+ *                 POLARSSL_ERR_MPI_BAD_INPUT_DATA if N is negative or even
+ */
+int mpi_mont_setup( mpi_mont_ctx *ctx, const mpi *N );
+
+/**
+ * Описание:          Copy the contents of a Montgomery context
  *
- * . X        Destination MPI
- * . size     Size in bytes
- * . f_rng    RNG function
- * . p_rng    RNG parameter
+ * Парам. dst      Destination context, initialized
+ * Парам. src      Source context
  *
- * . :         0 if successful,
+ * Возвр. :         0 if successful,
+ *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed
+ */
+int mpi_mont_copy( mpi_mont_ctx *dst, const mpi_mont_ctx *src );
+
+/**
+ * Описание:          Check a context that was not made by mpi_mont_setup(),
+ *                 e.g. loaded from a file
+ *
+ * Парам. ctx      Context to check
+ *
+ * Возвр. :         0 if mm = -N^-1 mod 2^biL, RR = R^2 mod N and, for a
+ *                 SIMD engine, RRs is R^2 mod N in the engine's radix,
+ *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed,
+ *                 POLARSSL_ERR_MPI_BAD_INPUT_DATA otherwise
+ *
+ * Допол.:        RR is checked as RR * R^-1 * R^-1 = 1, two Montgomery
+ *                 reductions instead of recomputing R^2 mod N.
+ */
+int mpi_mont_check( const mpi_mont_ctx *ctx );
+
+/**
+ * Описание:          Exponentiation with a prepared context: X = A^E mod N
+ *
+ * Парам. X        Destination MPI
+ * Парам. A        Left-hand MPI
+ * Парам. E        Exponent MPI
+ * Парам. ctx      Context set up by mpi_mont_setup()
+ *
+ * Возвр. :         0 if successful,
+ *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed,
+ *                 POLARSSL_ERR_MPI_BAD_INPUT_DATA if ctx was not set up
+ *
+ * Допол.:        Same result as mpi_exp_mod( X, A, E, &ctx->N, NULL ),
+ *                 without recomputing mm and R^2 mod N. ctx is only read,
+ *                 so one context can serve several threads.
+ */
+int mpi_exp_mod_ctx( mpi *X, const mpi *A, const mpi *E,
+                     const mpi_mont_ctx *ctx );
+
+/**
+ * Описание:          Convert to Montgomery form: X = A * R mod N
+ *
+ * Парам. X        Destination MPI
+ * Парам. A        Left-hand MPI
+ * Парам. ctx      Context set up by mpi_mont_setup()
+ *
+ * Возвр. :         0 if successful,
+ *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed,
+ *                 POLARSSL_ERR_MPI_BAD_INPUT_DATA if ctx was not set up
+ *
+ * Допол.:        R = 2^(biL * ctx->N.n), as in ctx->RR. The mpi_mont_*
+ *                 operations below expect operands in [0, N) and keep
+ *                 their results there.
+ */
+int mpi_mont_to( mpi *X, const mpi *A, const mpi_mont_ctx *ctx );
+
+/**
+ * Описание:          Convert from Montgomery form: X = A * R^-1 mod N
+ *
+ * Парам. X        Destination MPI
+ * Парам. A        Left-hand MPI, in Montgomery form
+ * Парам. ctx      Context set up by mpi_mont_setup()
+ *
+ * Возвр. :         0 if successful,
+ *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed,
+ *                 POLARSSL_ERR_MPI_BAD_INPUT_DATA if ctx was not set up
+ */
+int mpi_mont_from( mpi *X, const mpi *A, const mpi_mont_ctx *ctx );
+
+/**
+ * Описание:          Montgomery multiplication: X = A * B * R^-1 mod N
+ *
+ * Парам. X        Destination MPI
+ * Парам. A        Left-hand MPI, in Montgomery form
+ * Парам. B        Right-hand MPI, in Montgomery form
+ * Парам. ctx      Context set up by mpi_mont_setup()
+ *
+ * Возвр. :         0 if successful,
+ *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed,
+ *                 POLARSSL_ERR_MPI_BAD_INPUT_DATA if ctx was not set up
+ *
+ * Допол.:        A == B uses Montgomery squaring.
+ */
+int mpi_mont_mul( mpi *X, const mpi *A, const mpi *B, const mpi_mont_ctx *ctx );
+
+/**
+ * Описание:          Modular addition: X = A + B mod N
+ *
+ * Парам. X        Destination MPI
+ * Парам. A        Left-hand MPI, in [0, N)
+ * Парам. B        Right-hand MPI, in [0, N)
+ * Парам. ctx      Context set up by mpi_mont_setup()
+ *
+ * Возвр. :         0 if successful,
+ *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed
+ */
+int mpi_mont_add( mpi *X, const mpi *A, const mpi *B, const mpi_mont_ctx *ctx );
+
+/**
+ * Описание:          Modular subtraction: X = A - B mod N
+ *
+ * Парам. X        Destination MPI
+ * Парам. A        Left-hand MPI, in [0, N)
+ * Парам. B        Right-hand MPI, in [0, N)
+ * Парам. ctx      Context set up by mpi_mont_setup()
+ *
+ * Возвр. :         0 if successful,
+ *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed
+ */
+int mpi_mont_sub( mpi *X, const mpi *A, const mpi *B, const mpi_mont_ctx *ctx );
+
+/**
+ * Описание:          Multi-buffer exponentiation: X[i] = A[i]^E[i] mod N[i]
+ *                 for 0 <= i < count
+ *
+ * Парам. X        Array of count destination MPIs
+ * Парам. A        Array of count left-hand MPIs
+ * Парам. E        Array of count exponent MPIs
+ * Парам. N        Array of count modular MPIs
+ * Парам. count    Number of exponentiations
+ *
+ * Возвр. :         0 if successful,
+ *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed,
+ *                 POLARSSL_ERR_MPI_BAD_INPUT_DATA if some N[i] is negative
+ *                 or even
+ *
+ * Допол.:        Results are the same as count calls to mpi_exp_mod().
+ *                 Groups of operations with moduli of the same size run
+ *                 interleaved in SIMD lanes when the CPU supports it.
+ *                 X[i] may alias A[i], but not any other input.
+ */
+int mpi_exp_mod_multi( mpi *X[], const mpi *A[], const mpi *E[],
+                       const mpi *N[], size_t count );
+
+/**
+ * Описание:          Fill an MPI X with size bytes of random
+ *
+ * Парам. X        Destination MPI
+ * Парам. size     Size in bytes
+ * Парам. f_rng    RNG function
+ * Парам. p_rng    RNG parameter
+ *
+ * Возвр. :         0 if successful,
  *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed
  */
 int mpi_fill_random( mpi *X, size_t size,
@@ -561,25 +786,25 @@ int mpi_fill_random( mpi *X, size_t size,
                      void *p_rng );
 
 /**
- * :          Greatest common divisor: G = gcd(A, B)
+ * Описание:          Greatest common divisor: G = gcd(A, B)
  *
- * . G        Destination MPI
- * . A        Left-hand MPI
- * . B        Right-hand MPI
+ * Парам. G        Destination MPI
+ * Парам. A        Left-hand MPI
+ * Парам. B        Right-hand MPI
  *
- * . :         0 if successful,
+ * Возвр. :         0 if successful,
  *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed
  */
 int mpi_gcd( mpi *G, const mpi *A, const mpi *B );
 
 /**
- * :          Modular inverse: X = A^-1 mod N
+ * Описание:          Modular inverse: X = A^-1 mod N
  *
- * . X        Destination MPI
- * . A        Left-hand MPI
- * . N        Right-hand MPI
+ * Парам. X        Destination MPI
+ * Парам. A        Left-hand MPI
+ * Парам. N        Right-hand MPI
  *
- * . :         0 if successful,
+ * Возвр. :         0 if successful,
  *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed,
  *                 POLARSSL_ERR_MPI_BAD_INPUT_DATA if N is negative or nil
                    POLARSSL_ERR_MPI_NOT_ACCEPTABLE if A has no inverse mod N
@@ -587,30 +812,33 @@ int mpi_gcd( mpi *G, const mpi *A, const mpi *B );
 int mpi_inv_mod( mpi *X, const mpi *A, const mpi *N );
 
 /**
- * :          Miller-Rabin primality test
+ * Описание:          Primality test: trial division, then Miller-Rabin or Baillie-PSW
  *
- * . X        MPI to check
- * . f_rng    RNG function
- * . p_rng    RNG parameter
+ * Парам. X        MPI to check
+ * Парам. f_rng    RNG function
+ * Парам. p_rng    RNG parameter
  *
- * . :         0 if successful (probably prime),
+ * Возвр. :         0 if successful (probably prime),
  *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed,
  *                 POLARSSL_ERR_MPI_NOT_ACCEPTABLE if X is not prime
+ *
+ * Допол.:        With POLARSSL_MPI_BPSW the test after trial division is
+ *                 Baillie-PSW, which is deterministic and ignores f_rng.
  */
 int mpi_is_prime( mpi *X,
                   int (*f_rng)(void *, unsigned char *, size_t),
                   void *p_rng );
 
 /**
- * :          Prime number generation
+ * Описание:          Prime number generation
  *
- * . X        Destination MPI
- * . nbits    Required size of X in bits ( 3 <= nbits <= POLARSSL_MPI_MAX_BITS )
- * . dh_flag  If 1, then (X-1)/2 will be prime too
- * . f_rng    RNG function
- * . p_rng    RNG parameter
+ * Парам. X        Destination MPI
+ * Парам. nbits    Required size of X in bits ( 3 <= nbits <= POLARSSL_MPI_MAX_BITS )
+ * Парам. dh_flag  If 1, then (X-1)/2 will be prime too
+ * Парам. f_rng    RNG function
+ * Парам. p_rng    RNG parameter
  *
- * . :         0 if successful (probably prime),
+ * Возвр. :         0 if successful (probably prime),
  *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed,
  *                 POLARSSL_ERR_MPI_BAD_INPUT_DATA if nbits is < 3
  */
@@ -619,9 +847,62 @@ int mpi_gen_prime( mpi *X, size_t nbits, int dh_flag,
                    void *p_rng );
 
 /**
- * :          Checkup routine
+ * Описание:          Random starting point for mpi_gen_prime_search():
+ *                 nbits bits, X = 3 mod 4
+ *
+ * Парам. X        Destination MPI
+ * Парам. nbits    Required size of X in bits ( 3 <= nbits <= POLARSSL_MPI_MAX_BITS )
+ * Парам. f_rng    RNG function
+ * Парам. p_rng    RNG parameter
+ *
+ * Возвр. :         0 if successful,
+ *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed,
+ *                 POLARSSL_ERR_MPI_BAD_INPUT_DATA if nbits is < 3
+ */
+int mpi_gen_prime_start( mpi *X, size_t nbits,
+                         int (*f_rng)(void *, unsigned char *, size_t),
+                         void *p_rng );
+
+/**
+ * Описание:          Sieve search for the first prime X + k * step, k >= 0
+ *                 (step = 2, or 4 if dh_flag is set), looking only at the
+ *                 sieve windows first, first + stride, first + 2 * stride, ...
+ *
+ * Парам. X        Starting point on input, odd (3 mod 4 if dh_flag is set)
+ *                 and larger than POLARSSL_MPI_SIEVE_BOUND; the prime found
+ *                 on output
+ * Парам. dh_flag  If 1, then (X-1)/2 will be prime too
+ * Парам. first    First window to search
+ * Парам. stride   Distance between the windows searched
+ * Парам. f_rng    RNG function
+ * Парам. p_rng    RNG parameter
+ * Парам. f_abort  Cancellation callback or NULL, called with p_abort and
+ *                 the current window before each window and each
+ *                 Miller-Rabin test; nonzero stops the search
+ * Парам. p_abort  Cancellation callback parameter
+ *
+ * Возвр. :         0 if successful (probably prime),
+ *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed,
+ *                 POLARSSL_ERR_MPI_BAD_INPUT_DATA if X or stride is not valid,
+ *                 POLARSSL_ERR_MPI_ABORTED if f_abort stopped the search
+ *
+ * Допол.:        Window w covers the candidates
+ *                 w * POLARSSL_MPI_SIEVE_WINDOW <= k < ( w + 1 ) * POLARSSL_MPI_SIEVE_WINDOW.
+ *                 Searches with the same X, first = 0..T-1 and stride = T
+ *                 split the work of one search between T threads; the
+ *                 prime found in the lowest window is the one a single
+ *                 search with first = 0, stride = 1 returns.
+ */
+int mpi_gen_prime_search( mpi *X, int dh_flag, size_t first, size_t stride,
+                          int (*f_rng)(void *, unsigned char *, size_t),
+                          void *p_rng,
+                          int (*f_abort)(void *, size_t),
+                          void *p_abort );
+
+/**
+ * Описание:          Checkup routine
  *
- * . :         0 if successful, or 1 if the test failed
+ * Возвр. :         0 if successful, or 1 if the test failed
  */
 int mpi_self_test( int verbose );
 
@@ -0,0 +1,983 @@
+/*
+ *  Multi-precision integer library, SIMD Montgomery engines
+ *
+ *  Both engines run the word-by-word Montgomery multiplication of
+ *  HAC 14.36 with one digit of the accumulator per 64-bit vector lane.
+ *  Each step adds a * b[i] + u * N to the accumulator, drops the lowest
+ *  digit (which is zero modulo the radix) by shifting the accumulator one
+ *  lane down, and carries its high part into the new lowest digit.
+ *  Digits are left unnormalized until the end of the multiplication.
+ *
+ *  Based on:
+ *
+ *  S. Gueron, V. Krasnov, "Software Implementation of Modular
+ *  Exponentiation, Using Advanced Vector Instructions Architectures"
+ */
+
+#include "config.h"
+
+#if defined(POLARSSL_BIGNUM_C)
+
+#include "bignum.h"
+#include "bn_avx.h"
+
+#if defined(POLARSSL_MPI_HAVE_AVX2)
+
+#include <immintrin.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+#if defined(__GNUC__)
+#define MPI_TARGET( t ) __attribute__(( target( t ) ))
+#else
+#define MPI_TARGET( t )
+#endif
+
+#define ciL    (sizeof(t_uint))         /* chars in limb  */
+
+#define CHARS_TO_LIMBS(i) (((i) + ciL - 1) / ciL)
+
+/*
+ * Fixed window size used by mpi_exp_mod_avx()
+ */
+#define MONT_WSIZE      5
+
+/*
+ * Largest digit count: 4096 bits in radix 2^29, plus a spare vector
+ */
+#define MONT_MAX_DIGITS ( ( POLARSSL_MPI_AVX_MAX_BITS + 28 ) / 29 + 8 )
+
+typedef struct mont_simd mont_simd;
+
+struct mont_simd
+{
+    size_t w;                   /*!<  bits per digit                  */
+    size_t d;                   /*!<  digits in the modulus           */
+    size_t l;                   /*!<  digits per operand, padded      */
+    uint64_t mask;              /*!<  2^w - 1                         */
+    uint64_t k0;                /*!<  -N^-1 mod 2^w                   */
+    uint64_t *m;                /*!<  modulus, l digits               */
+
+    /*!<  r = a * b * 2^(-w*d) mod N, all operands l digits          */
+    void (*mul)( uint64_t *r, const uint64_t *a, const uint64_t *b,
+                 const mont_simd *M );
+};
+
+/*
+ * CPU feature detection
+ */
+static void mpi_cpuid( unsigned int leaf, unsigned int r[4] )
+{
+#if defined(_MSC_VER)
+    int t[4];
+
+    __cpuid( t, 0 );
+    if( (unsigned int) t[0] < leaf )
+    {
+        r[0] = r[1] = r[2] = r[3] = 0;
+        return;
+    }
+
+    __cpuidex( t, leaf, 0 );
+    r[0] = t[0]; r[1] = t[1]; r[2] = t[2]; r[3] = t[3];
+#else
+    if( __get_cpuid_max( 0, NULL ) < leaf )
+    {
+        r[0] = r[1] = r[2] = r[3] = 0;
+        return;
+    }
+
+    __cpuid_count( leaf, 0, r[0], r[1], r[2], r[3] );
+#endif
+}
+
+static uint64_t mpi_xgetbv( void )
+{
+#if defined(_MSC_VER)
+    return( _xgetbv( 0 ) );
+#else
+    unsigned int a, d;
+
+    asm volatile( "xgetbv" : "=a" (a), "=d" (d) : "c" (0) );
+
+    return( ( (uint64_t) d << 32 ) | a );
+#endif
+}
+
+static int mpi_check_engine( void )
+{
+    unsigned int r[4];
+    uint64_t xcr0;
+
+    /*
+     * OSXSAVE and AVX, then YMM state enabled by the OS
+     */
+    mpi_cpuid( 1, r );
+    if( ( r[2] & ( 1u << 27 ) ) == 0 || ( r[2] & ( 1u << 28 ) ) == 0 )
+        return( POLARSSL_MPI_ENGINE_NONE );
+
+    xcr0 = mpi_xgetbv();
+    if( ( xcr0 & 0x06 ) != 0x06 )
+        return( POLARSSL_MPI_ENGINE_NONE );
+
+    mpi_cpuid( 7, r );
+
+#if defined(POLARSSL_MPI_HAVE_IFMA)
+    /*
+     * AVX512F (bit 16), AVX512IFMA (bit 21), AVX512VL (bit 31) and
+     * opmask / ZMM state enabled by the OS
+     */
+    if( ( r[1] & ( 1u << 16 ) ) != 0 && ( r[1] & ( 1u << 21 ) ) != 0 &&
+        ( r[1] & ( 1u << 31 ) ) != 0 && ( xcr0 & 0xE6 ) == 0xE6 )
+        return( POLARSSL_MPI_ENGINE_IFMA );
+#endif
+
+    if( ( r[1] & ( 1u << 5 ) ) != 0 )
+        return( POLARSSL_MPI_ENGINE_AVX2 );
+
+    return( POLARSSL_MPI_ENGINE_NONE );
+}
+
+int mpi_avx_engine( size_t nbits )
+{
+    static const int engine = mpi_check_engine();
+
+    if( nbits < POLARSSL_MPI_AVX_MIN_BITS || nbits > POLARSSL_MPI_AVX_MAX_BITS )
+        return( POLARSSL_MPI_ENGINE_NONE );
+
+    return( engine );
+}
+
+/*
+ * Final step shared by the engines: normalize the l accumulator digits
+ * in t (value < 2N) and subtract N once if needed, without branching
+ * on the result
+ */
+static void mont_finish( uint64_t *r, uint64_t *t, const mont_simd *M )
+{
+    size_t j;
+    uint64_t c, x, top, borrow, sel;
+    uint64_t s[MONT_MAX_DIGITS];
+
+    for( j = 0, c = 0; j < M->l; j++ )
+    {
+        t[j] += c;
+        c = t[j] >> M->w;
+        t[j] &= M->mask;
+    }
+
+    top = c + ( ( M->d < M->l ) ? t[M->d] : 0 );
+
+    for( j = 0, borrow = 0; j < M->d; j++ )
+    {
+        x = t[j] - M->m[j] - borrow;
+        borrow = x >> 63;
+        s[j] = x & M->mask;
+    }
+
+    sel = (uint64_t) 0 - (uint64_t)( top >= borrow );
+
+    for( j = 0; j < M->d; j++ )
+        r[j] = ( s[j] & sel ) | ( t[j] & ~sel );
+
+    for( ; j < M->l; j++ )
+        r[j] = 0;
+}
+
+#if defined(POLARSSL_MPI_HAVE_IFMA)
+
+/*
+ * Montgomery multiplication, AVX-512 IFMA, 8 digits of 52 bits per vector
+ *
+ * Every lane receives at most four 52-bit halves per step, so with up to
+ * 79 digits the accumulator never needs an intermediate normalization.
+ */
+MPI_TARGET( "avx512f,avx512ifma,avx512vl" )
+static void mont52_mul( uint64_t *r, const uint64_t *a, const uint64_t *b,
+                        const mont_simd *M )
+{
+    size_t i, v, nv = M->l / 8;
+    uint64_t u, t0, m0 = M->m[0];
+    __m512i acc[MONT_MAX_DIGITS / 8 + 1];
+    __m512i bi, ui;
+    uint64_t t[MONT_MAX_DIGITS];
+
+    for( v = 0; v <= nv; v++ )
+        acc[v] = _mm512_setzero_si512();
+
+    for( i = 0; i < M->d; i++ )
+    {
+        bi = _mm512_set1_epi64( (long long) b[i] );
+
+        for( v = 0; v < nv; v++ )
+            acc[v] = _mm512_madd52lo_epu64( acc[v],
+                         _mm512_loadu_si512( a + 8 * v ), bi );
+
+        t0 = (uint64_t) _mm_cvtsi128_si64( _mm512_castsi512_si128( acc[0] ) );
+        u  = ( t0 * M->k0 ) & M->mask;
+        ui = _mm512_set1_epi64( (long long) u );
+
+        for( v = 0; v < nv; v++ )
+            acc[v] = _mm512_madd52lo_epu64( acc[v],
+                         _mm512_loadu_si512( M->m + 8 * v ), ui );
+
+        /*
+         * Lowest digit is now 0 mod 2^52: drop it, keep its carry
+         */
+        t0 = ( t0 + ( ( m0 * u ) & M->mask ) ) >> 52;
+
+        for( v = 0; v < nv; v++ )
+            acc[v] = _mm512_alignr_epi64( acc[v + 1], acc[v], 1 );
+
+        acc[0] = _mm512_add_epi64( acc[0],
+                     _mm512_maskz_set1_epi64( 1, (long long) t0 ) );
+
+        for( v = 0; v < nv; v++ )
+        {
+            acc[v] = _mm512_madd52hi_epu64( acc[v],
+                         _mm512_loadu_si512( a + 8 * v ), bi );
+            acc[v] = _mm512_madd52hi_epu64( acc[v],
+                         _mm512_loadu_si512( M->m + 8 * v ), ui );
+        }
+    }
+
+    for( v = 0; v < nv; v++ )
+        _mm512_storeu_si512( t + 8 * v, acc[v] );
+
+    mont_finish( r, t, M );
+}
+
+#endif /* POLARSSL_MPI_HAVE_IFMA */
+
+/*
+ * AVX2 lane shifts across a vector array: [x1 x2 x3 y0] and [p3 x0 x1 x2]
+ */
+#define MONT_SHR1( x, y )                                               \
+    _mm256_blend_epi32( _mm256_permute4x64_epi64( x, 0x39 ),            \
+                        _mm256_permute4x64_epi64( y, 0x39 ), 0xC0 )
+
+#define MONT_SHL1( x, p )                                               \
+    _mm256_blend_epi32( _mm256_permute4x64_epi64( x, 0x93 ),            \
+                        _mm256_permute4x64_epi64( p, 0x93 ), 0x03 )
+
+/*
+ * Steps between two partial normalizations of the AVX2 accumulator:
+ * each step adds less than 2^59 to a lane
+ */
+#define MONT29_NORM     16
+
+/*
+ * Montgomery multiplication, AVX2, 4 digits of 29 bits per vector
+ *
+ * vpmuludq gives the full 58-bit products, which are accumulated as is;
+ * every MONT29_NORM steps one parallel carry step brings all lanes back
+ * to about 35 bits.
+ */
+MPI_TARGET( "avx2" )
+static void mont29_mul( uint64_t *r, const uint64_t *a, const uint64_t *b,
+                        const mont_simd *M )
+{
+    size_t i, v, nv = M->l / 4;
+    uint64_t u, t0, m0 = M->m[0];
+    __m256i acc[MONT_MAX_DIGITS / 4 + 1];
+    __m256i bi, ui, c, p, mask;
+    uint64_t t[MONT_MAX_DIGITS];
+
+    mask = _mm256_set1_epi64x( (long long) M->mask );
+
+    for( v = 0; v <= nv; v++ )
+        acc[v] = _mm256_setzero_si256();
+
+    for( i = 0; i < M->d; i++ )
+    {
+        bi = _mm256_set1_epi64x( (long long) b[i] );
+
+        for( v = 0; v < nv; v++ )
+            acc[v] = _mm256_add_epi64( acc[v], _mm256_mul_epu32(
+                         _mm256_loadu_si256( (const __m256i *)( a + 4 * v ) ), bi ) );
+
+        t0 = (uint64_t) _mm_cvtsi128_si64( _mm256_castsi256_si128( acc[0] ) );
+        u  = ( t0 * M->k0 ) & M->mask;
+        ui = _mm256_set1_epi64x( (long long) u );
+
+        for( v = 0; v < nv; v++ )
+            acc[v] = _mm256_add_epi64( acc[v], _mm256_mul_epu32(
+                         _mm256_loadu_si256( (const __m256i *)( M->m + 4 * v ) ), ui ) );
+
+        t0 = ( t0 + m0 * u ) >> 29;
+
+        for( v = 0; v < nv; v++ )
+            acc[v] = MONT_SHR1( acc[v], acc[v + 1] );
+
+        acc[0] = _mm256_add_epi64( acc[0],
+                     _mm256_set_epi64x( 0, 0, 0, (long long) t0 ) );
+
+        if( ( i + 1 ) % MONT29_NORM == 0 )
+        {
+            /*
+             * lane j = ( lane j & mask ) + ( lane j-1 >> 29 ); the top lane
+             * is never carried out of since the value stays below 2N
+             */
+            p = _mm256_setzero_si256();
+
+            for( v = 0; v < nv; v++ )
+            {
+                c = _mm256_srli_epi64( acc[v], 29 );
+                acc[v] = _mm256_add_epi64( _mm256_and_si256( acc[v], mask ),
+                                           MONT_SHL1( c, p ) );
+                p = c;
+            }
+        }
+    }
+
+    for( v = 0; v < nv; v++ )
+        _mm256_storeu_si256( (__m256i *)( t + 4 * v ), acc[v] );
+
+    mont_finish( r, t, M );
+}
+
+/*
+ * Conversion between mpi limbs and digits of w bits
+ */
+static void mont_from_mpi( uint64_t *t, const mpi *X, const mont_simd *M )
+{
+    size_t i, j, bits, nbytes = X->n * ciL;
+    uint64_t acc;
+
+    memset( t, 0, M->l * sizeof( uint64_t ) );
+
+    for( i = j = bits = 0, acc = 0; i < nbytes && j < M->d; i++ )
+    {
+        acc |= (uint64_t)( ( X->p[i / ciL] >> ( ( i % ciL ) << 3 ) ) & 0xFF ) << bits;
+        bits += 8;
+
+        if( bits >= M->w )
+        {
+            t[j++] = acc & M->mask;
+            acc >>= M->w;
+            bits -= M->w;
+        }
+    }
+
+    if( j < M->d )
+        t[j] = acc;
+}
+
+static int mont_to_mpi( mpi *X, const uint64_t *t, const mont_simd *M )
+{
+    int ret;
+    size_t j, k, bits, nbytes = ( M->d * M->w + 7 ) >> 3;
+    uint64_t acc;
+
+    MPI_CHK( mpi_grow( X, CHARS_TO_LIMBS( nbytes ) ) );
+    MPI_CHK( mpi_lset( X, 0 ) );
+
+    for( j = k = bits = 0, acc = 0; j < M->d; j++ )
+    {
+        acc |= t[j] << bits;
+        bits += M->w;
+
+        for( ; bits >= 8; bits -= 8, acc >>= 8, k++ )
+            X->p[k / ciL] |= (t_uint)( acc & 0xFF ) << ( ( k % ciL ) << 3 );
+    }
+
+    if( bits > 0 )
+        X->p[k / ciL] |= (t_uint)( acc & 0xFF ) << ( ( k % ciL ) << 3 );
+
+cleanup:
+
+    return( ret );
+}
+
+/*
+ * Digit layout of the engine for an nbits modulus
+ */
+static int mont_layout( mont_simd *M, int engine, size_t nbits )
+{
+    /*
+     * IFMA capable CPUs can also run the AVX2 engine
+     */
+    if( engine == POLARSSL_MPI_ENGINE_NONE || engine > mpi_avx_engine( nbits ) )
+        return( POLARSSL_ERR_MPI_BAD_INPUT_DATA );
+
+#if defined(POLARSSL_MPI_HAVE_IFMA)
+    if( engine == POLARSSL_MPI_ENGINE_IFMA )
+    {
+        M->w   = 52;
+        M->d   = ( nbits + 51 ) / 52;
+        M->l   = ( M->d + 7 ) & ~(size_t) 7;
+        M->mul = mont52_mul;
+    }
+    else
+#endif
+    {
+        M->w   = 29;
+        M->d   = ( nbits + 28 ) / 29;
+        M->l   = ( M->d + 1 + 3 ) & ~(size_t) 3;
+        M->mul = mont29_mul;
+    }
+
+    M->mask = ( (uint64_t) 1 << M->w ) - 1;
+
+    return( 0 );
+}
+
+/*
+ * All ones if a == b, zero otherwise, without a branch
+ */
+static uint64_t mont_eq_mask( size_t a, size_t b )
+{
+    uint64_t x = (uint64_t) ( a ^ b );
+
+    return( ( ( x | ( (uint64_t) 0 - x ) ) >> 63 ) - 1 );
+}
+
+/*
+ * t = W[idx] from a table of count entries of l digits. Every entry is
+ * read and masked, so the memory access pattern does not depend on the
+ * (secret) window value.
+ */
+static void mont_select( uint64_t *t, const uint64_t *w, size_t count,
+                         size_t l, size_t idx )
+{
+    size_t i, j;
+    uint64_t mask;
+
+    memset( t, 0, l * sizeof( uint64_t ) );
+
+    for( i = 0; i < count; i++ )
+    {
+        mask = mont_eq_mask( i, idx );
+
+        for( j = 0; j < l; j++ )
+            t[j] |= w[i * l + j] & mask;
+    }
+}
+
+/*
+ * Load N into M->m and compute k0 = -N^-1 mod 2^w
+ */
+static void mont_modulus( mont_simd *M, const mpi *N )
+{
+    size_t i;
+    uint64_t inv;
+
+    mont_from_mpi( M->m, N, M );
+
+    /*
+     * Newton iteration on the lowest digit
+     */
+    for( i = 0, inv = 1; i < 6; i++ )
+        inv *= 2 - M->m[0] * inv;
+    M->k0 = ( (uint64_t) 0 - inv ) & M->mask;
+}
+
+/*
+ * RR = R^2 mod N with R = 2^(w*d)
+ */
+int mpi_avx_rr( int engine, mpi *RR, const mpi *N )
+{
+    int ret;
+    mont_simd M;
+
+    if( ( N->p[0] & 1 ) == 0 )
+        return( POLARSSL_ERR_MPI_BAD_INPUT_DATA );
+
+    MPI_CHK( mont_layout( &M, engine, mpi_msb( N ) ) );
+
+    MPI_CHK( mpi_lset( RR, 1 ) );
+    MPI_CHK( mpi_shift_l( RR, 2 * M.w * M.d ) );
+    MPI_CHK( mpi_mod_mpi( RR, RR, N ) );
+
+cleanup:
+
+    return( ret );
+}
+
+/*
+ * RR * R^-1 * R^-1 = 1 for a valid RR
+ */
+int mpi_avx_check_rr( int engine, const mpi *RR, const mpi *N )
+{
+    int ret;
+    size_t j;
+    uint64_t diff, *buf = NULL, *x, *t;
+    mont_simd M;
+
+    if( ( N->p[0] & 1 ) == 0 || RR->p == NULL || RR->s < 0 ||
+        mpi_cmp_mpi( RR, N ) >= 0 ||
+        mont_layout( &M, engine, mpi_msb( N ) ) != 0 )
+        return( POLARSSL_ERR_MPI_BAD_INPUT_DATA );
+
+    buf = (uint64_t *) malloc( 3 * M.l * sizeof( uint64_t ) );
+    if( buf == NULL )
+        return( POLARSSL_ERR_MPI_MALLOC_FAILED );
+
+    M.m = buf;
+    x   = M.m + M.l;
+    t   = x + M.l;
+
+    mont_modulus( &M, N );
+    mont_from_mpi( x, RR, &M );
+
+    memset( t, 0, M.l * sizeof( uint64_t ) );
+    t[0] = 1;
+
+    M.mul( x, x, t, &M );
+    M.mul( x, x, t, &M );
+
+    for( j = 0, diff = 0; j < M.l; j++ )
+        diff |= x[j] ^ t[j];
+
+    ret = ( diff == 0 ) ? 0 : POLARSSL_ERR_MPI_BAD_INPUT_DATA;
+
+    free( buf );
+
+    return( ret );
+}
+
+/*
+ * Fixed-window exponentiation: X = A^E mod N. The window table is
+ * scanned in full for every window, so E may be a private exponent.
+ */
+int mpi_exp_mod_avx( int engine, mpi *X, const mpi *A, const mpi *E,
+                     const mpi *N, const mpi *RR )
+{
+    int ret;
+    size_t i, j, ebits, wbits, one = 1;
+    uint64_t *buf = NULL, *rr, *x, *t, *w;
+    mont_simd M;
+    mpi T;
+
+    if( ( N->p[0] & 1 ) == 0 ||
+        mont_layout( &M, engine, mpi_msb( N ) ) != 0 )
+        return( POLARSSL_ERR_MPI_BAD_INPUT_DATA );
+
+    mpi_init( &T );
+
+    /*
+     * Layout: m, RR, x, t, then the 2^MONT_WSIZE window table
+     */
+    buf = (uint64_t *) malloc( ( 4 + ( one << MONT_WSIZE ) ) * M.l * sizeof( uint64_t ) );
+    if( buf == NULL )
+    {
+        ret = POLARSSL_ERR_MPI_MALLOC_FAILED;
+        goto cleanup;
+    }
+
+    M.m = buf;
+    rr  = M.m + M.l;
+    x   = rr + M.l;
+    t   = x + M.l;
+    w   = t + M.l;
+
+    mont_modulus( &M, N );
+
+    if( RR == NULL )
+    {
+        MPI_CHK( mpi_avx_rr( engine, &T, N ) );
+        mont_from_mpi( rr, &T, &M );
+    }
+    else
+        mont_from_mpi( rr, RR, &M );
+
+    /*
+     * W[0] = R mod N, W[1] = A * R mod N, W[i] = W[i - 1] * W[1]
+     */
+    if( mpi_cmp_mpi( A, N ) >= 0 )
+    {
+        MPI_CHK( mpi_mod_mpi( &T, A, N ) );
+        mont_from_mpi( x, &T, &M );
+    }
+    else
+        mont_from_mpi( x, A, &M );
+
+    memset( t, 0, M.l * sizeof( uint64_t ) );
+    t[0] = 1;
+
+    M.mul( w, rr, t, &M );
+    M.mul( w + M.l, x, rr, &M );
+
+    for( i = 2; i < ( one << MONT_WSIZE ); i++ )
+        M.mul( w + i * M.l, w + ( i - 1 ) * M.l, w + M.l, &M );
+
+    /*
+     * Left to right, MONT_WSIZE exponent bits at a time, starting with
+     * the (possibly partial) top window
+     */
+    ebits = mpi_msb( E );
+    i = ( ebits + MONT_WSIZE - 1 ) / MONT_WSIZE * MONT_WSIZE;
+
+    memcpy( x, w, M.l * sizeof( uint64_t ) );
+
+    while( i > 0 )
+    {
+        i -= MONT_WSIZE;
+
+        for( j = 0, wbits = 0; j < MONT_WSIZE; j++ )
+            wbits |= (size_t) mpi_get_bit( (mpi *) E, i + j ) << j;
+
+        if( i + MONT_WSIZE < ebits )
+        {
+            for( j = 0; j < MONT_WSIZE; j++ )
+                M.mul( x, x, x, &M );
+        }
+
+        mont_select( t, w, one << MONT_WSIZE, M.l, wbits );
+        M.mul( x, x, t, &M );
+    }
+
+    /*
+     * X = A^E * R * R^-1 mod N = A^E mod N
+     */
+    memset( t, 0, M.l * sizeof( uint64_t ) );
+    t[0] = 1;
+    M.mul( x, x, t, &M );
+
+    MPI_CHK( mont_to_mpi( X, x, &M ) );
+
+cleanup:
+
+    if( buf != NULL )
+    {
+        memset( buf, 0, ( 4 + ( one << MONT_WSIZE ) ) * M.l * sizeof( uint64_t ) );
+        free( buf );
+    }
+
+    mpi_free( &T );
+
+    return( ret );
+}
+
+#if defined(POLARSSL_MPI_HAVE_IFMA)
+
+/*
+ * Multi-buffer engine: POLARSSL_MPI_MULTI_LANES independent Montgomery
+ * multiplications in lock-step. Operands are stored structure-of-arrays,
+ * digit j of lane k at index j * 8 + k, so vector j holds digit j of every
+ * lane and no lane shuffles are needed.
+ */
+#define MB_LANES        POLARSSL_MPI_MULTI_LANES
+
+typedef struct mont_multi mont_multi;
+
+struct mont_multi
+{
+    size_t d;                   /*!<  digits of 52 bits per lane      */
+    uint64_t *m;                /*!<  moduli, d vectors               */
+    uint64_t *k0;               /*!<  -N^-1 mod 2^52 per lane         */
+    uint64_t *acc;              /*!<  accumulator, 2 * d + 1 vectors  */
+};
+
+/*
+ * r = a * b * 2^(-52*d) mod N, lane by lane
+ *
+ * The accumulator is indexed from the current step instead of being
+ * shifted: step i works on vectors i .. i + d. Each vector receives at most
+ * four 52-bit halves per step, which is far from overflowing for d <= 79.
+ */
+MPI_TARGET( "avx512f,avx512ifma" )
+static void mb52_mul( uint64_t *r, const uint64_t *a, const uint64_t *b,
+                      const mont_multi *M )
+{
+    size_t i, j, d = M->d;
+    uint64_t *acc = M->acc;
+    __m512i t, bi, ui, k0, mask, aj, mj, ap, mp, c, top, borrow;
+    __mmask8 sel;
+
+    k0   = _mm512_loadu_si512( M->k0 );
+    mask = _mm512_set1_epi64( ( (long long) 1 << 52 ) - 1 );
+
+    for( j = 0; j <= 2 * d; j++ )
+        _mm512_storeu_si512( acc + j * MB_LANES, _mm512_setzero_si512() );
+
+    for( i = 0; i < d; i++ )
+    {
+        bi = _mm512_loadu_si512( b + i * MB_LANES );
+
+        /*
+         * Lowest digit first: it decides u = acc[i] * k0 mod 2^52, and
+         * becomes 0 mod 2^52 once u * N is added
+         */
+        ap = _mm512_loadu_si512( a );
+        mp = _mm512_loadu_si512( M->m );
+
+        t  = _mm512_madd52lo_epu64( _mm512_loadu_si512( acc + i * MB_LANES ),
+                                    ap, bi );
+        ui = _mm512_madd52lo_epu64( _mm512_setzero_si512(), t, k0 );
+        t  = _mm512_madd52lo_epu64( t, mp, ui );
+        c  = _mm512_srli_epi64( t, 52 );
+
+        for( j = 1; j <= d; j++ )
+        {
+            t = _mm512_add_epi64( _mm512_loadu_si512( acc + ( i + j ) * MB_LANES ), c );
+            c = _mm512_setzero_si512();
+
+            if( j < d )
+            {
+                aj = _mm512_loadu_si512( a + j * MB_LANES );
+                mj = _mm512_loadu_si512( M->m + j * MB_LANES );
+                t  = _mm512_madd52lo_epu64( t, aj, bi );
+                t  = _mm512_madd52lo_epu64( t, mj, ui );
+            }
+
+            t = _mm512_madd52hi_epu64( t, ap, bi );
+            t = _mm512_madd52hi_epu64( t, mp, ui );
+            _mm512_storeu_si512( acc + ( i + j ) * MB_LANES, t );
+
+            if( j < d )
+            {
+                ap = aj;
+                mp = mj;
+            }
+        }
+    }
+
+    /*
+     * Result in vectors d .. 2d: normalize, then subtract N where the
+     * lane is not below it
+     */
+    acc += d * MB_LANES;
+    c = _mm512_setzero_si512();
+
+    for( j = 0; j < d; j++ )
+    {
+        t = _mm512_add_epi64( _mm512_loadu_si512( acc + j * MB_LANES ), c );
+        c = _mm512_srli_epi64( t, 52 );
+        _mm512_storeu_si512( acc + j * MB_LANES, _mm512_and_si512( t, mask ) );
+    }
+
+    top = _mm512_add_epi64( _mm512_loadu_si512( acc + d * MB_LANES ), c );
+    borrow = _mm512_setzero_si512();
+
+    for( j = 0; j < d; j++ )
+    {
+        t = _mm512_sub_epi64( _mm512_loadu_si512( acc + j * MB_LANES ),
+                              _mm512_loadu_si512( M->m + j * MB_LANES ) );
+        t = _mm512_sub_epi64( t, borrow );
+        borrow = _mm512_srli_epi64( t, 63 );
+        _mm512_storeu_si512( r + j * MB_LANES, _mm512_and_si512( t, mask ) );
+    }
+
+    sel = _mm512_cmpge_epu64_mask( top, borrow );
+
+    for( j = 0; j < d; j++ )
+        _mm512_storeu_si512( r + j * MB_LANES, _mm512_mask_blend_epi64( sel,
+                                 _mm512_loadu_si512( acc + j * MB_LANES ),
+                                 _mm512_loadu_si512( r + j * MB_LANES ) ) );
+}
+
+/*
+ * Copy lane k of a digit vector array to or from a plain digit array
+ */
+static void mb_put_lane( uint64_t *v, const uint64_t *t, size_t k, size_t d )
+{
+    size_t j;
+
+    for( j = 0; j < d; j++ )
+        v[j * MB_LANES + k] = t[j];
+}
+
+static void mb_get_lane( uint64_t *t, const uint64_t *v, size_t k, size_t d )
+{
+    size_t j;
+
+    for( j = 0; j < d; j++ )
+        t[j] = v[j * MB_LANES + k];
+}
+
+/*
+ * Multi-buffer fixed-window exponentiation: X[k] = A[k]^E[k] mod N[k]
+ */
+int mpi_exp_mod_multi_avx( mpi *X[], const mpi *A[], const mpi *E[],
+                           const mpi *N[], size_t count )
+{
+    int ret;
+    size_t i, j, k, c, d, l, nbits, ebits, size, one = 1;
+    size_t wbits[MB_LANES];
+    uint64_t mask[MB_LANES];
+    uint64_t inv, *buf = NULL, *rr, *x, *t, *s, *w;
+    uint64_t k0[MB_LANES];
+    mont_simd M;
+    mont_multi MB;
+    mpi T;
+
+    if( count == 0 || count > MB_LANES )
+        return( POLARSSL_ERR_MPI_BAD_INPUT_DATA );
+
+    nbits = mpi_msb( N[0] );
+    if( mpi_avx_engine( nbits ) != POLARSSL_MPI_ENGINE_IFMA )
+        return( POLARSSL_ERR_MPI_NOT_ACCEPTABLE );
+
+    /*
+     * All moduli must have the same digit count
+     */
+    d = ( nbits + 51 ) / 52;
+    for( k = 0; k < count; k++ )
+    {
+        if( ( mpi_msb( N[k] ) + 51 ) / 52 != d || N[k]->s < 0 || A[k]->s < 0 )
+            return( POLARSSL_ERR_MPI_NOT_ACCEPTABLE );
+
+        if( ( N[k]->p[0] & 1 ) == 0 )
+            return( POLARSSL_ERR_MPI_BAD_INPUT_DATA );
+    }
+
+    mpi_init( &T );
+
+    M.w    = 52;
+    M.d    = d;
+    M.l    = l = ( d + 7 ) & ~(size_t) 7;
+    M.mask = ( (uint64_t) 1 << 52 ) - 1;
+    M.mul  = NULL;
+
+    MB.d  = d;
+    MB.k0 = k0;
+
+    /*
+     * Layout, in vectors of MB_LANES digits: m, RR, x, t, s, the 2d + 1
+     * accumulator, then the 2^MONT_WSIZE window table; followed by one
+     * plain l digit operand used for the conversions
+     */
+    size = ( ( 5 + ( one << MONT_WSIZE ) ) * d + 2 * d + 1 ) * MB_LANES + l;
+
+    buf = (uint64_t *) malloc( size * sizeof( uint64_t ) );
+    if( buf == NULL )
+    {
+        ret = POLARSSL_ERR_MPI_MALLOC_FAILED;
+        goto cleanup;
+    }
+
+    memset( buf, 0, size * sizeof( uint64_t ) );
+
+    MB.m   = buf;
+    rr     = MB.m + d * MB_LANES;
+    x      = rr + d * MB_LANES;
+    t      = x + d * MB_LANES;
+    s      = t + d * MB_LANES;
+    MB.acc = s + d * MB_LANES;
+    w      = MB.acc + ( 2 * d + 1 ) * MB_LANES;
+    M.m    = w + ( one << MONT_WSIZE ) * d * MB_LANES;
+
+    /*
+     * Per lane: modulus, k0, RR = 2^(2*52*d) mod N, A mod N. Lanes beyond
+     * count repeat the last operation and are discarded.
+     */
+    for( k = 0; k < MB_LANES; k++ )
+    {
+        i = ( k < count ) ? k : count - 1;
+
+        mont_from_mpi( M.m, N[i], &M );
+        mb_put_lane( MB.m, M.m, k, d );
+
+        for( j = 0, inv = 1; j < 6; j++ )
+            inv *= 2 - M.m[0] * inv;
+        k0[k] = ( (uint64_t) 0 - inv ) & M.mask;
+
+        MPI_CHK( mpi_lset( &T, 1 ) );
+        MPI_CHK( mpi_shift_l( &T, 2 * 52 * d ) );
+        MPI_CHK( mpi_mod_mpi( &T, &T, N[i] ) );
+        mont_from_mpi( M.m, &T, &M );
+        mb_put_lane( rr, M.m, k, d );
+
+        MPI_CHK( mpi_mod_mpi( &T, A[i], N[i] ) );
+        mont_from_mpi( M.m, &T, &M );
+        mb_put_lane( x, M.m, k, d );
+
+        t[k] = 1;
+    }
+
+    /*
+     * W[0] = R mod N, W[1] = A * R mod N, W[i] = W[i - 1] * W[1]
+     */
+    mb52_mul( w, rr, t, &MB );
+    mb52_mul( w + d * MB_LANES, x, rr, &MB );
+
+    for( i = 2; i < ( one << MONT_WSIZE ); i++ )
+        mb52_mul( w + i * d * MB_LANES, w + ( i - 1 ) * d * MB_LANES,
+                  w + d * MB_LANES, &MB );
+
+    /*
+     * Lock-step windows over the longest exponent; shorter exponents
+     * just see leading zero windows, which multiply by W[0] = 1
+     */
+    for( k = 0, ebits = 0; k < count; k++ )
+        if( mpi_msb( E[k] ) > ebits )
+            ebits = mpi_msb( E[k] );
+
+    i = ( ebits + MONT_WSIZE - 1 ) / MONT_WSIZE * MONT_WSIZE;
+
+    memcpy( x, w, d * MB_LANES * sizeof( uint64_t ) );
+
+    while( i > 0 )
+    {
+        i -= MONT_WSIZE;
+
+        for( k = 0; k < MB_LANES; k++ )
+        {
+            const mpi *Ek = E[( k < count ) ? k : count - 1];
+
+            for( j = 0, wbits[k] = 0; j < MONT_WSIZE; j++ )
+                wbits[k] |= (size_t) mpi_get_bit( (mpi *) Ek, i + j ) << j;
+        }
+
+        if( i + MONT_WSIZE < ebits )
+        {
+            for( j = 0; j < MONT_WSIZE; j++ )
+                mb52_mul( x, x, x, &MB );
+        }
+
+        /*
+         * Gather each lane's table entry, scanning the whole table as in
+         * mont_select()
+         */
+        memset( s, 0, d * MB_LANES * sizeof( uint64_t ) );
+
+        for( c = 0; c < ( one << MONT_WSIZE ); c++ )
+        {
+            for( k = 0; k < MB_LANES; k++ )
+                mask[k] = mont_eq_mask( c, wbits[k] );
+
+            for( j = 0; j < d; j++ )
+                for( k = 0; k < MB_LANES; k++ )
+                    s[j * MB_LANES + k] |= w[( c * d + j ) * MB_LANES + k] & mask[k];
+        }
+
+        mb52_mul( x, x, s, &MB );
+    }
+
+    /*
+     * X = A^E * R * R^-1 mod N = A^E mod N
+     */
+    mb52_mul( x, x, t, &MB );
+
+    for( k = 0; k < count; k++ )
+    {
+        memset( M.m, 0, l * sizeof( uint64_t ) );
+        mb_get_lane( M.m, x, k, d );
+        MPI_CHK( mont_to_mpi( X[k], M.m, &M ) );
+    }
+
+cleanup:
+
+    if( buf != NULL )
+    {
+        memset( buf, 0, size * sizeof( uint64_t ) );
+        free( buf );
+    }
+
+    mpi_free( &T );
+
+    return( ret );
+}
+
+#endif /* POLARSSL_MPI_HAVE_IFMA */
+
+#endif /* POLARSSL_MPI_HAVE_AVX2 */
+
+#endif /* POLARSSL_BIGNUM_C */
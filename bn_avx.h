@@ -0,0 +1,142 @@
+/**
+ * \file bn_avx.h
+ *
+ * \brief  Multi-precision integer library, SIMD Montgomery engines
+ *
+ *      Montgomery exponentiation with the modulus stored in small
+ *      digits, one digit per 64-bit vector lane:
+ *
+ *         . AVX-512 IFMA: radix 2^52, vpmadd52luq / vpmadd52huq
+ *         . AVX2:         radix 2^29, vpmuludq
+ *
+ *      The engine is selected at runtime from CPUID and only used by
+ *      mpi_exp_mod() for moduli of POLARSSL_MPI_AVX_MIN_BITS up to
+ *      POLARSSL_MPI_AVX_MAX_BITS bits. Operands are converted from and
+ *      to the normal mpi limb layout at the edges.
+ *
+ *      mpi_exp_mod_multi() runs groups of POLARSSL_MPI_MULTI_LANES
+ *      exponentiations on the IFMA engine, one operation per lane.
+ */
+#ifndef POLARSSL_BN_AVX_H
+#define POLARSSL_BN_AVX_H
+
+#include "bignum.h"
+
+#if defined(POLARSSL_HAVE_ASM)
+#if ( defined(__GNUC__) && ( defined(__amd64__) || defined(__x86_64__) ) ) || \
+    ( defined(_MSC_VER) && defined(_M_X64) )
+#define POLARSSL_MPI_HAVE_AVX2
+#if defined(__clang__) || ( defined(__GNUC__) && __GNUC__ >= 5 )
+#define POLARSSL_MPI_HAVE_IFMA
+#endif
+#endif
+#endif /* POLARSSL_HAVE_ASM */
+
+#if defined(POLARSSL_MPI_HAVE_AVX2)
+
+#define POLARSSL_MPI_AVX_MIN_BITS       1024    /**< Smallest modulus handled by the SIMD engines. */
+#define POLARSSL_MPI_AVX_MAX_BITS       4096    /**< Largest modulus handled by the SIMD engines. */
+
+#define POLARSSL_MPI_ENGINE_NONE        0       /**< No SIMD engine, use mpi_montmul(). */
+#define POLARSSL_MPI_ENGINE_AVX2        1       /**< AVX2, radix 2^29. */
+#define POLARSSL_MPI_ENGINE_IFMA        2       /**< AVX-512 IFMA, radix 2^52. */
+
+#define POLARSSL_MPI_MULTI_LANES        8       /**< Exponentiations per mpi_exp_mod_multi_avx() call. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \brief          Return the SIMD engine to use for a modulus of nbits
+ *
+ * \param nbits    Size of the modulus in bits
+ *
+ * \return         POLARSSL_MPI_ENGINE_IFMA or POLARSSL_MPI_ENGINE_AVX2 if
+ *                 the CPU and OS support it and nbits is in range,
+ *                 POLARSSL_MPI_ENGINE_NONE otherwise
+ */
+int mpi_avx_engine( size_t nbits );
+
+/**
+ * \brief          Compute R^2 mod N for the engine's radix and digit count
+ *
+ * \param engine   Engine returned by mpi_avx_engine()
+ * \param RR       Destination MPI
+ * \param N        Modular MPI, odd
+ *
+ * \return         0 if successful,
+ *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed,
+ *                 POLARSSL_ERR_MPI_BAD_INPUT_DATA if the engine can't
+ *                 handle N
+ */
+int mpi_avx_rr( int engine, mpi *RR, const mpi *N );
+
+/**
+ * \brief          Check that RR is R^2 mod N for the engine's radix and
+ *                 digit count, as RR * R^-1 * R^-1 = 1
+ *
+ * \param engine   Engine returned by mpi_avx_engine()
+ * \param RR       Value to check
+ * \param N        Modular MPI, odd
+ *
+ * \return         0 if RR is right,
+ *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed,
+ *                 POLARSSL_ERR_MPI_BAD_INPUT_DATA if it is not or the
+ *                 engine can't handle N
+ */
+int mpi_avx_check_rr( int engine, const mpi *RR, const mpi *N );
+
+/**
+ * \brief          Fixed-window exponentiation: X = A^E mod N
+ *
+ *                 Each window reads the whole table, so the memory access
+ *                 pattern does not depend on E and E may be secret
+ *
+ * \param engine   Engine returned by mpi_avx_engine()
+ * \param X        Destination MPI
+ * \param A        Left-hand MPI, non-negative
+ * \param E        Exponent MPI
+ * \param N        Modular MPI, odd
+ * \param RR       R^2 mod N from mpi_avx_rr() for the same engine,
+ *                 or NULL to compute it
+ *
+ * \return         0 if successful,
+ *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed,
+ *                 POLARSSL_ERR_MPI_BAD_INPUT_DATA if the engine can't
+ *                 handle N
+ */
+int mpi_exp_mod_avx( int engine, mpi *X, const mpi *A, const mpi *E,
+                     const mpi *N, const mpi *RR );
+
+#if defined(POLARSSL_MPI_HAVE_IFMA)
+/**
+ * \brief          Multi-buffer fixed-window exponentiation on the IFMA
+ *                 engine: X[k] = A[k]^E[k] mod N[k], one operation per
+ *                 vector lane
+ *
+ * \param X        Array of count destination MPIs
+ * \param A        Array of count left-hand MPIs
+ * \param E        Array of count exponent MPIs
+ * \param N        Array of count modular MPIs, odd
+ * \param count    1 to POLARSSL_MPI_MULTI_LANES
+ *
+ * \return         0 if successful,
+ *                 POLARSSL_ERR_MPI_MALLOC_FAILED if memory allocation failed,
+ *                 POLARSSL_ERR_MPI_BAD_INPUT_DATA if count is out of range
+ *                 or some N[k] is even,
+ *                 POLARSSL_ERR_MPI_NOT_ACCEPTABLE if the engine is not
+ *                 available, the moduli differ in digit count or some
+ *                 A[k] or N[k] is negative; nothing is computed then
+ */
+int mpi_exp_mod_multi_avx( mpi *X[], const mpi *A[], const mpi *E[],
+                           const mpi *N[], size_t count );
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* POLARSSL_MPI_HAVE_AVX2 */
+
+#endif /* bn_avx.h */
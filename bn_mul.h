@@ -192,6 +192,36 @@
     asm( "movq   %%rsi, %0      " : "=m" (s) :: \
     "rax", "rcx", "rdx", "rbx", "rsi", "rdi", "r8" );
 
+/*
+ * 8-way unrolled kernel for CPUs with BMI2 and ADX. mulx leaves the
+ * flags alone, so the high halves are chained through CF (adcx) and the
+ * destination limbs through OF (adox), two independent carry chains.
+ * Only usable after a runtime CPU check, see mpi_mul_hlp().
+ */
+#define MULADDC_HUIT_ADX_STEP( o )              \
+    asm( "mulxq  " #o "(%rsi), %rax, %r8 " );   \
+    asm( "adcxq  %rcx, %rax     " );            \
+    asm( "adoxq  " #o "(%rdi), %rax " );        \
+    asm( "movq   %rax, " #o "(%rdi) " );        \
+    asm( "movq   %r8,  %rcx     " );
+
+#define MULADDC_HUIT_ADX                        \
+    asm( "movq   %rbx, %rdx     " );            \
+    asm( "xorl   %eax, %eax     " );            \
+    MULADDC_HUIT_ADX_STEP(  0 )                 \
+    MULADDC_HUIT_ADX_STEP(  8 )                 \
+    MULADDC_HUIT_ADX_STEP( 16 )                 \
+    MULADDC_HUIT_ADX_STEP( 24 )                 \
+    MULADDC_HUIT_ADX_STEP( 32 )                 \
+    MULADDC_HUIT_ADX_STEP( 40 )                 \
+    MULADDC_HUIT_ADX_STEP( 48 )                 \
+    MULADDC_HUIT_ADX_STEP( 56 )                 \
+    asm( "movq   $0,   %rax     " );            \
+    asm( "adcxq  %rax, %rcx     " );            \
+    asm( "adoxq  %rax, %rcx     " );            \
+    asm( "leaq   64(%rsi), %rsi " );            \
+    asm( "leaq   64(%rdi), %rdi " );
+
 #endif /* AMD64 */
 
 #if defined(__mc68020__) || defined(__mcpu32__)
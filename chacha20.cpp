@@ -0,0 +1,254 @@
+/*
+ *  ChaCha20 stream cipher
+ *
+ *  Y. Nir, A. Langley, "ChaCha20 and Poly1305 for IETF Protocols",
+ *  RFC 7539, sections 2.1 - 2.4.
+ */
+
+#include "config.h"
+
+#if defined(POLARSSL_CHACHA20_C)
+
+#include "chacha20.h"
+
+#if defined(POLARSSL_SELF_TEST)
+#include <stdio.h>
+#endif
+
+/*
+ * 32-bit integer manipulation macros (little endian)
+ */
+#ifndef GET_UINT32_LE
+#define GET_UINT32_LE(n,b,i)                            \
+{                                                       \
+    (n) = ( (uint32_t) (b)[(i)    ]       )             \
+        | ( (uint32_t) (b)[(i) + 1] <<  8 )             \
+        | ( (uint32_t) (b)[(i) + 2] << 16 )             \
+        | ( (uint32_t) (b)[(i) + 3] << 24 );            \
+}
+#endif
+
+#ifndef PUT_UINT32_LE
+#define PUT_UINT32_LE(n,b,i)                            \
+{                                                       \
+    (b)[(i)    ] = (unsigned char) ( (n)       );       \
+    (b)[(i) + 1] = (unsigned char) ( (n) >>  8 );       \
+    (b)[(i) + 2] = (unsigned char) ( (n) >> 16 );       \
+    (b)[(i) + 3] = (unsigned char) ( (n) >> 24 );       \
+}
+#endif
+
+#define ROTL32(x,n)     ( ( (x) << (n) ) | ( (x) >> ( 32 - (n) ) ) )
+
+#define QUARTERROUND(a,b,c,d)                           \
+{                                                       \
+    a += b; d ^= a; d = ROTL32( d, 16 );                \
+    c += d; b ^= c; b = ROTL32( b, 12 );                \
+    a += b; d ^= a; d = ROTL32( d,  8 );                \
+    c += d; b ^= c; b = ROTL32( b,  7 );                \
+}
+
+void chacha20_block( const uint32_t state[16], unsigned char out[64] )
+{
+    int i;
+    uint32_t x[16];
+
+    memcpy( x, state, sizeof( x ) );
+
+    for( i = 0; i < 10; i++ )
+    {
+        QUARTERROUND( x[0], x[4], x[ 8], x[12] );
+        QUARTERROUND( x[1], x[5], x[ 9], x[13] );
+        QUARTERROUND( x[2], x[6], x[10], x[14] );
+        QUARTERROUND( x[3], x[7], x[11], x[15] );
+        QUARTERROUND( x[0], x[5], x[10], x[15] );
+        QUARTERROUND( x[1], x[6], x[11], x[12] );
+        QUARTERROUND( x[2], x[7], x[ 8], x[13] );
+        QUARTERROUND( x[3], x[4], x[ 9], x[14] );
+    }
+
+    for( i = 0; i < 16; i++ )
+    {
+        x[i] += state[i];
+        PUT_UINT32_LE( x[i], out, 4 * i );
+    }
+
+    memset( x, 0, sizeof( x ) );
+}
+
+void chacha20_setup( chacha20_context *ctx,
+                     const unsigned char key[CHACHA20_KEY_SIZE],
+                     const unsigned char nonce[CHACHA20_NONCE_SIZE],
+                     uint32_t counter )
+{
+    int i;
+
+    /*
+     * "expand 32-byte k"
+     */
+    ctx->state[0] = 0x61707865;
+    ctx->state[1] = 0x3320646E;
+    ctx->state[2] = 0x79622D32;
+    ctx->state[3] = 0x6B206574;
+
+    for( i = 0; i < 8; i++ )
+        GET_UINT32_LE( ctx->state[4 + i], key, 4 * i );
+
+    ctx->state[12] = counter;
+
+    for( i = 0; i < 3; i++ )
+        GET_UINT32_LE( ctx->state[13 + i], nonce, 4 * i );
+
+    memset( ctx->keystream, 0, sizeof( ctx->keystream ) );
+    ctx->pos = sizeof( ctx->keystream );
+}
+
+void chacha20_crypt( chacha20_context *ctx, size_t length,
+                     const unsigned char *input, unsigned char *output )
+{
+    size_t i;
+
+    /*
+     * Finish the keystream block left over from the previous call
+     */
+    while( length > 0 && ctx->pos < sizeof( ctx->keystream ) )
+    {
+        *output++ = *input++ ^ ctx->keystream[ctx->pos++];
+        length--;
+    }
+
+    while( length >= CHACHA20_BLOCK_SIZE )
+    {
+        chacha20_block( ctx->state, ctx->keystream );
+        ctx->state[12]++;
+
+        for( i = 0; i < CHACHA20_BLOCK_SIZE; i++ )
+            output[i] = input[i] ^ ctx->keystream[i];
+
+        input  += CHACHA20_BLOCK_SIZE;
+        output += CHACHA20_BLOCK_SIZE;
+        length -= CHACHA20_BLOCK_SIZE;
+    }
+
+    if( length > 0 )
+    {
+        chacha20_block( ctx->state, ctx->keystream );
+        ctx->state[12]++;
+
+        for( i = 0; i < length; i++ )
+            output[i] = input[i] ^ ctx->keystream[i];
+
+        ctx->pos = length;
+    }
+}
+
+void chacha20_free( chacha20_context *ctx )
+{
+    memset( ctx, 0, sizeof( chacha20_context ) );
+}
+
+#if defined(POLARSSL_SELF_TEST)
+
+/*
+ * RFC 7539, 2.3.2: key 00..1f, counter 1, nonce 00000009 0000004a 00000000
+ */
+static const unsigned char chacha20_test_block[64] =
+{
+    0x10, 0xF1, 0xE7, 0xE4, 0xD1, 0x3B, 0x59, 0x15,
+    0x50, 0x0F, 0xDD, 0x1F, 0xA3, 0x20, 0x71, 0xC4,
+    0xC7, 0xD1, 0xF4, 0xC7, 0x33, 0xC0, 0x68, 0x03,
+    0x04, 0x22, 0xAA, 0x9A, 0xC3, 0xD4, 0x6C, 0x4E,
+    0xD2, 0x82, 0x64, 0x46, 0x07, 0x9F, 0xAA, 0x09,
+    0x14, 0xC2, 0xD7, 0x05, 0xD9, 0x8B, 0x02, 0xA2,
+    0xB5, 0x12, 0x9C, 0xD1, 0xDE, 0x16, 0x4E, 0xB9,
+    0xCB, 0xD0, 0x83, 0xE8, 0xA2, 0x50, 0x3C, 0x4E
+};
+
+static const unsigned char chacha20_test_nonce[2][CHACHA20_NONCE_SIZE] =
+{
+    { 0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x4A, 0x00, 0x00, 0x00, 0x00 },
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x4A, 0x00, 0x00, 0x00, 0x00 }
+};
+
+static const char chacha20_test_pt[] =
+    "Ladies and Gentlemen of the class of '99: If I could offer you only "
+    "one tip for the future, sunscreen would be it.";
+
+/*
+ * RFC 7539, 2.4.2: key 00..1f, counter 1, nonce 00000000 0000004a 00000000
+ */
+static const unsigned char chacha20_test_ct[114] =
+{
+    0x6E, 0x2E, 0x35, 0x9A, 0x25, 0x68, 0xF9, 0x80,
+    0x41, 0xBA, 0x07, 0x28, 0xDD, 0x0D, 0x69, 0x81,
+    0xE9, 0x7E, 0x7A, 0xEC, 0x1D, 0x43, 0x60, 0xC2,
+    0x0A, 0x27, 0xAF, 0xCC, 0xFD, 0x9F, 0xAE, 0x0B,
+    0xF9, 0x1B, 0x65, 0xC5, 0x52, 0x47, 0x33, 0xAB,
+    0x8F, 0x59, 0x3D, 0xAB, 0xCD, 0x62, 0xB3, 0x57,
+    0x16, 0x39, 0xD6, 0x24, 0xE6, 0x51, 0x52, 0xAB,
+    0x8F, 0x53, 0x0C, 0x35, 0x9F, 0x08, 0x61, 0xD8,
+    0x07, 0xCA, 0x0D, 0xBF, 0x50, 0x0D, 0x6A, 0x61,
+    0x56, 0xA3, 0x8E, 0x08, 0x8A, 0x22, 0xB6, 0x5E,
+    0x52, 0xBC, 0x51, 0x4D, 0x16, 0xCC, 0xF8, 0x06,
+    0x81, 0x8C, 0xE9, 0x1A, 0xB7, 0x79, 0x37, 0x36,
+    0x5A, 0xF9, 0x0B, 0xBF, 0x74, 0xA3, 0x5B, 0xE6,
+    0xB4, 0x0B, 0x8E, 0xED, 0xF2, 0x78, 0x5E, 0x42,
+    0x87, 0x4D
+};
+
+/*
+ * Checkup routine
+ */
+int chacha20_self_test( int verbose )
+{
+    int i;
+    unsigned char key[CHACHA20_KEY_SIZE];
+    unsigned char out[114];
+    chacha20_context ctx;
+
+    for( i = 0; i < CHACHA20_KEY_SIZE; i++ )
+        key[i] = (unsigned char) i;
+
+    if( verbose != 0 )
+        printf( "  CHACHA20 block test: " );
+
+    chacha20_setup( &ctx, key, chacha20_test_nonce[0], 1 );
+    chacha20_block( ctx.state, out );
+
+    if( memcmp( out, chacha20_test_block, sizeof( chacha20_test_block ) ) != 0 )
+    {
+        if( verbose != 0 )
+            printf( "failed\n" );
+
+        return( 1 );
+    }
+
+    if( verbose != 0 )
+        printf( "passed\n  CHACHA20 encryption test: " );
+
+    /*
+     * Uneven pieces go through the keystream carry-over
+     */
+    chacha20_setup( &ctx, key, chacha20_test_nonce[1], 1 );
+    chacha20_crypt( &ctx, 7, (const unsigned char *) chacha20_test_pt, out );
+    chacha20_crypt( &ctx, 100, (const unsigned char *) chacha20_test_pt + 7, out + 7 );
+    chacha20_crypt( &ctx, 7, (const unsigned char *) chacha20_test_pt + 107, out + 107 );
+    chacha20_free( &ctx );
+
+    if( memcmp( out, chacha20_test_ct, sizeof( chacha20_test_ct ) ) != 0 )
+    {
+        if( verbose != 0 )
+            printf( "failed\n" );
+
+        return( 1 );
+    }
+
+    if( verbose != 0 )
+        printf( "passed\n\n" );
+
+    return( 0 );
+}
+
+#endif
+
+#endif
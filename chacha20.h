@@ -0,0 +1,90 @@
+/**
+ * \file chacha20.h
+ *
+ * \brief  ChaCha20 stream cipher (RFC 7539)
+ *
+ *      A 256-bit key, a 96-bit nonce and a 32-bit block counter. The same
+ *      call encrypts and decrypts. A key and nonce pair must never be used
+ *      for two different messages.
+ */
+#ifndef POLARSSL_CHACHA20_H
+#define POLARSSL_CHACHA20_H
+
+#include "config.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define CHACHA20_KEY_SIZE           32      /**< Key size in bytes. */
+#define CHACHA20_NONCE_SIZE         12      /**< Nonce size in bytes. */
+#define CHACHA20_BLOCK_SIZE         64      /**< Block size in bytes. */
+
+/**
+ * \brief          ChaCha20 context
+ */
+typedef struct
+{
+    uint32_t state[16];                                 /*!<  constants, key, counter, nonce  */
+    unsigned char keystream[CHACHA20_BLOCK_SIZE];       /*!<  current keystream block         */
+    size_t pos;                                         /*!<  next unused byte in keystream   */
+}
+chacha20_context;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \brief          ChaCha20 block function: 20 rounds over state plus the
+ *                 feed-forward, serialized little endian. The counter in
+ *                 the state is not advanced.
+ *
+ * \param state    Input state: constants, key, counter and nonce words
+ * \param out      64 bytes of keystream
+ */
+void chacha20_block( const uint32_t state[16], unsigned char out[64] );
+
+/**
+ * \brief          Set up the cipher for one message
+ *
+ * \param ctx      Context to set up
+ * \param key      CHACHA20_KEY_SIZE bytes of key
+ * \param nonce    CHACHA20_NONCE_SIZE bytes of nonce
+ * \param counter  Block counter of the first keystream block
+ */
+void chacha20_setup( chacha20_context *ctx,
+                     const unsigned char key[CHACHA20_KEY_SIZE],
+                     const unsigned char nonce[CHACHA20_NONCE_SIZE],
+                     uint32_t counter );
+
+/**
+ * \brief          Encrypt or decrypt data. Consecutive calls continue the
+ *                 same keystream.
+ *
+ * \param ctx      Context set up by chacha20_setup()
+ * \param length   Length of the input data
+ * \param input    Buffer holding the input data
+ * \param output   Buffer for the output data (may be the same as input)
+ */
+void chacha20_crypt( chacha20_context *ctx, size_t length,
+                     const unsigned char *input, unsigned char *output );
+
+/**
+ * \brief          Clear the context
+ *
+ * \param ctx      Context to clear
+ */
+void chacha20_free( chacha20_context *ctx );
+
+/**
+ * \brief          Checkup routine
+ *
+ * \return         0 if successful, or 1 if the test failed
+ */
+int chacha20_self_test( int verbose );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* chacha20.h */
@@ -0,0 +1,233 @@
+/*
+ *  ChaCha20-based deterministic random bit generator
+ *
+ *  The block function follows RFC 7539, section 2.3, with a 64-bit block
+ *  counter in words 12-13 and a 64-bit stream number in words 14-15.
+ *  After every refill of the output buffer the first 32 bytes replace
+ *  the key and are wiped (D. J. Bernstein, "Fast-key-erasure random-number
+ *  generators", 2017).
+ */
+
+#if defined(_WIN32) && !defined(_CRT_RAND_S)
+#define _CRT_RAND_S
+#endif
+
+#include "config.h"
+
+#if defined(POLARSSL_CHACHA_DRBG_C)
+
+#include "chacha_drbg.h"
+#include "chacha20.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__linux__) && defined(__GLIBC__) && \
+    ( __GLIBC__ > 2 || ( __GLIBC__ == 2 && __GLIBC_MINOR__ >= 25 ) )
+#include <sys/random.h>
+#define CHACHA_DRBG_HAVE_GETRANDOM
+#endif
+
+/*
+ * 32-bit integer manipulation macros (little endian)
+ */
+#ifndef GET_UINT32_LE
+#define GET_UINT32_LE(n,b,i)                            \
+{                                                       \
+    (n) = ( (uint32_t) (b)[(i)    ]       )             \
+        | ( (uint32_t) (b)[(i) + 1] <<  8 )             \
+        | ( (uint32_t) (b)[(i) + 2] << 16 )             \
+        | ( (uint32_t) (b)[(i) + 3] << 24 );            \
+}
+#endif
+
+#ifndef PUT_UINT32_LE
+#define PUT_UINT32_LE(n,b,i)                            \
+{                                                       \
+    (b)[(i)    ] = (unsigned char) ( (n)       );       \
+    (b)[(i) + 1] = (unsigned char) ( (n) >>  8 );       \
+    (b)[(i) + 2] = (unsigned char) ( (n) >> 16 );       \
+    (b)[(i) + 3] = (unsigned char) ( (n) >> 24 );       \
+}
+#endif
+
+/*
+ * Refill the output buffer and rekey from its first 32 bytes
+ */
+static void chacha_drbg_refill( chacha_drbg_context *ctx )
+{
+    int i;
+
+    for( i = 0; i < CHACHA_DRBG_BLOCKS; i++ )
+    {
+        chacha20_block( ctx->state, ctx->buf + i * CHACHA_DRBG_BLOCK_SIZE );
+
+        if( ++ctx->state[12] == 0 )
+            ++ctx->state[13];
+    }
+
+    for( i = 0; i < 8; i++ )
+        GET_UINT32_LE( ctx->state[4 + i], ctx->buf, 4 * i );
+
+    ctx->state[12] = 0;
+    ctx->state[13] = 0;
+
+    memset( ctx->buf, 0, CHACHA_DRBG_KEY_SIZE );
+    ctx->pos = CHACHA_DRBG_KEY_SIZE;
+}
+
+void chacha_drbg_seed( chacha_drbg_context *ctx,
+                       const unsigned char key[CHACHA_DRBG_KEY_SIZE],
+                       uint64_t stream )
+{
+    int i;
+
+    /*
+     * "expand 32-byte k"
+     */
+    ctx->state[0] = 0x61707865;
+    ctx->state[1] = 0x3320646E;
+    ctx->state[2] = 0x79622D32;
+    ctx->state[3] = 0x6B206574;
+
+    for( i = 0; i < 8; i++ )
+        GET_UINT32_LE( ctx->state[4 + i], key, 4 * i );
+
+    ctx->state[12] = 0;
+    ctx->state[13] = 0;
+    ctx->state[14] = (uint32_t)( stream       );
+    ctx->state[15] = (uint32_t)( stream >> 32 );
+
+    memset( ctx->buf, 0, sizeof( ctx->buf ) );
+    ctx->pos = sizeof( ctx->buf );
+}
+
+int chacha_drbg_seed_os( chacha_drbg_context *ctx )
+{
+    int ret = POLARSSL_ERR_CHACHA_DRBG_ENTROPY_SOURCE_FAILED;
+    unsigned char key[CHACHA_DRBG_KEY_SIZE];
+
+#if defined(_WIN32)
+    unsigned int v;
+    size_t i;
+
+    for( i = 0; i < sizeof( key ); i += 4 )
+    {
+        if( rand_s( &v ) != 0 )
+            goto cleanup;
+
+        PUT_UINT32_LE( v, key, i );
+    }
+#else
+    size_t n = 0;
+    FILE *f;
+
+#if defined(CHACHA_DRBG_HAVE_GETRANDOM)
+    ssize_t r;
+
+    while( n < sizeof( key ) &&
+           ( r = getrandom( key + n, sizeof( key ) - n, 0 ) ) > 0 )
+        n += (size_t) r;
+#endif
+
+    if( n < sizeof( key ) )
+    {
+        if( ( f = fopen( "/dev/urandom", "rb" ) ) == NULL )
+            goto cleanup;
+
+        n += fread( key + n, 1, sizeof( key ) - n, f );
+        fclose( f );
+
+        if( n < sizeof( key ) )
+            goto cleanup;
+    }
+#endif
+
+    chacha_drbg_seed( ctx, key, 0 );
+    ret = 0;
+
+cleanup:
+
+    memset( key, 0, sizeof( key ) );
+
+    return( ret );
+}
+
+int chacha_drbg_random( void *p_rng, unsigned char *output, size_t output_len )
+{
+    chacha_drbg_context *ctx = (chacha_drbg_context *) p_rng;
+    size_t n;
+
+    while( output_len > 0 )
+    {
+        if( ctx->pos == sizeof( ctx->buf ) )
+            chacha_drbg_refill( ctx );
+
+        n = sizeof( ctx->buf ) - ctx->pos;
+        if( n > output_len )
+            n = output_len;
+
+        memcpy( output, ctx->buf + ctx->pos, n );
+        memset( ctx->buf + ctx->pos, 0, n );
+
+        ctx->pos += n;
+        output += n;
+        output_len -= n;
+    }
+
+    return( 0 );
+}
+
+void chacha_drbg_free( chacha_drbg_context *ctx )
+{
+    memset( ctx, 0, sizeof( chacha_drbg_context ) );
+}
+
+#if defined(POLARSSL_SELF_TEST)
+
+/*
+ * Checkup routine
+ */
+int chacha_drbg_self_test( int verbose )
+{
+    int i;
+    unsigned char key[CHACHA_DRBG_KEY_SIZE];
+    unsigned char a[100], b[100];
+    chacha_drbg_context ctx;
+
+    for( i = 0; i < CHACHA_DRBG_KEY_SIZE; i++ )
+        key[i] = (unsigned char) i;
+
+    if( verbose != 0 )
+        printf( "  CHACHA_DRBG reproducibility test: " );
+
+    /*
+     * Same key and stream give the same bytes however they are requested
+     */
+    chacha_drbg_seed( &ctx, key, 7 );
+    chacha_drbg_random( &ctx, a, sizeof( a ) );
+
+    chacha_drbg_seed( &ctx, key, 7 );
+    for( i = 0; i < (int) sizeof( b ); i += 3 )
+        chacha_drbg_random( &ctx, b + i,
+                            ( sizeof( b ) - i < 3 ) ? sizeof( b ) - i : 3 );
+
+    chacha_drbg_free( &ctx );
+
+    if( memcmp( a, b, sizeof( a ) ) != 0 )
+    {
+        if( verbose != 0 )
+            printf( "failed\n" );
+
+        return( 1 );
+    }
+
+    if( verbose != 0 )
+        printf( "passed\n\n" );
+
+    return( 0 );
+}
+
+#endif
+
+#endif
@@ -0,0 +1,102 @@
+/**
+ * \file chacha_drbg.h
+ *
+ * \brief  ChaCha20-based deterministic random bit generator
+ *
+ *      The ChaCha20 block function (RFC 7539) run in counter mode under a
+ *      256-bit key. Output is produced CHACHA_DRBG_BLOCKS blocks at a time
+ *      into a buffer; the first 32 bytes of every refill become the next
+ *      key and are never returned, so a captured state does not reveal
+ *      earlier output (fast key erasure).
+ *
+ *      chacha_drbg_random() has the f_rng signature used throughout
+ *      bignum.h and can be passed to mpi_fill_random(), mpi_gen_prime()
+ *      and friends with the context as p_rng. A context is not locked:
+ *      use one per thread.
+ */
+#ifndef POLARSSL_CHACHA_DRBG_H
+#define POLARSSL_CHACHA_DRBG_H
+
+#include "config.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define POLARSSL_ERR_CHACHA_DRBG_ENTROPY_SOURCE_FAILED     -0x0034  /**< The entropy source failed. */
+
+#define CHACHA_DRBG_KEY_SIZE        32      /**< Key size in bytes. */
+#define CHACHA_DRBG_BLOCK_SIZE      64      /**< ChaCha20 block size in bytes. */
+#define CHACHA_DRBG_BLOCKS          8       /**< Blocks generated per buffer refill. */
+
+/**
+ * \brief          DRBG context
+ */
+typedef struct
+{
+    uint32_t state[16];                                 /*!<  constants, key, counter, stream  */
+    unsigned char buf[CHACHA_DRBG_BLOCKS * CHACHA_DRBG_BLOCK_SIZE];     /*!<  output buffer  */
+    size_t pos;                                         /*!<  next unused byte in buf          */
+}
+chacha_drbg_context;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \brief          Seed the context with a caller-supplied key
+ *
+ * \param ctx      Context to seed
+ * \param key      CHACHA_DRBG_KEY_SIZE bytes of key material
+ * \param stream   Stream number; different streams under one key give
+ *                 independent output
+ *
+ * \note           The same key and stream always produce the same output,
+ *                 which makes key generation reproducible in tests and
+ *                 benchmarks. Use chacha_drbg_seed_os() otherwise.
+ */
+void chacha_drbg_seed( chacha_drbg_context *ctx,
+                       const unsigned char key[CHACHA_DRBG_KEY_SIZE],
+                       uint64_t stream );
+
+/**
+ * \brief          Seed the context from the operating system
+ *                 (getrandom() or /dev/urandom, rand_s() on Windows)
+ *
+ * \param ctx      Context to seed
+ *
+ * \return         0 if successful,
+ *                 POLARSSL_ERR_CHACHA_DRBG_ENTROPY_SOURCE_FAILED otherwise
+ */
+int chacha_drbg_seed_os( chacha_drbg_context *ctx );
+
+/**
+ * \brief          Generate random bytes
+ *
+ * \param p_rng    Seeded chacha_drbg_context
+ * \param output   Buffer to fill
+ * \param output_len Length of the buffer
+ *
+ * \return         0
+ */
+int chacha_drbg_random( void *p_rng, unsigned char *output, size_t output_len );
+
+/**
+ * \brief          Clear the context
+ *
+ * \param ctx      Context to clear
+ */
+void chacha_drbg_free( chacha_drbg_context *ctx );
+
+/**
+ * \brief          Checkup routine
+ *
+ * \return         0 if successful, or 1 if the test failed
+ */
+int chacha_drbg_self_test( int verbose );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* chacha_drbg.h */
@@ -0,0 +1,433 @@
+/*
+ *  Poly1305 and ChaCha20-Poly1305
+ *
+ *  Y. Nir, A. Langley, "ChaCha20 and Poly1305 for IETF Protocols",
+ *  RFC 7539, sections 2.5 - 2.8. Poly1305 keeps the accumulator in five
+ *  26-bit limbs so every product fits in 64 bits (A. Moon, poly1305-donna).
+ */
+
+#include "config.h"
+
+#if defined(POLARSSL_CHACHAPOLY_C)
+
+#include "chachapoly.h"
+
+#if defined(POLARSSL_SELF_TEST)
+#include <stdio.h>
+#endif
+
+/*
+ * 32-bit integer manipulation macros (little endian)
+ */
+#ifndef GET_UINT32_LE
+#define GET_UINT32_LE(n,b,i)                            \
+{                                                       \
+    (n) = ( (uint32_t) (b)[(i)    ]       )             \
+        | ( (uint32_t) (b)[(i) + 1] <<  8 )             \
+        | ( (uint32_t) (b)[(i) + 2] << 16 )             \
+        | ( (uint32_t) (b)[(i) + 3] << 24 );            \
+}
+#endif
+
+#ifndef PUT_UINT32_LE
+#define PUT_UINT32_LE(n,b,i)                            \
+{                                                       \
+    (b)[(i)    ] = (unsigned char) ( (n)       );       \
+    (b)[(i) + 1] = (unsigned char) ( (n) >>  8 );       \
+    (b)[(i) + 2] = (unsigned char) ( (n) >> 16 );       \
+    (b)[(i) + 3] = (unsigned char) ( (n) >> 24 );       \
+}
+#endif
+
+#define POLY1305_MASK26     0x3FFFFFF
+
+void poly1305_starts( poly1305_context *ctx,
+                      const unsigned char key[POLY1305_KEY_SIZE] )
+{
+    uint32_t t0, t1, t2, t3;
+
+    GET_UINT32_LE( t0, key,  0 );
+    GET_UINT32_LE( t1, key,  4 );
+    GET_UINT32_LE( t2, key,  8 );
+    GET_UINT32_LE( t3, key, 12 );
+
+    /*
+     * r &= 0x0ffffffc0ffffffc0ffffffc0fffffff, split into 26-bit limbs
+     */
+    ctx->r[0] = (   t0                     ) & 0x3FFFFFF;
+    ctx->r[1] = ( ( t0 >> 26 ) | ( t1 <<  6 ) ) & 0x3FFFF03;
+    ctx->r[2] = ( ( t1 >> 20 ) | ( t2 << 12 ) ) & 0x3FFC0FF;
+    ctx->r[3] = ( ( t2 >> 14 ) | ( t3 << 18 ) ) & 0x3F03FFF;
+    ctx->r[4] = (   t3 >>  8                 ) & 0x00FFFFF;
+
+    memset( ctx->h, 0, sizeof( ctx->h ) );
+
+    GET_UINT32_LE( ctx->pad[0], key, 16 );
+    GET_UINT32_LE( ctx->pad[1], key, 20 );
+    GET_UINT32_LE( ctx->pad[2], key, 24 );
+    GET_UINT32_LE( ctx->pad[3], key, 28 );
+
+    ctx->leftover = 0;
+}
+
+/*
+ * h = (h + m) * r mod 2^130 - 5 for each 16-byte block; hibit is 2^128
+ * for full blocks and 0 for the padded last one
+ */
+static void poly1305_blocks( poly1305_context *ctx, const unsigned char *m,
+                             size_t bytes, uint32_t hibit )
+{
+    uint32_t r0 = ctx->r[0], r1 = ctx->r[1], r2 = ctx->r[2];
+    uint32_t r3 = ctx->r[3], r4 = ctx->r[4];
+    uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+    uint32_t h0 = ctx->h[0], h1 = ctx->h[1], h2 = ctx->h[2];
+    uint32_t h3 = ctx->h[3], h4 = ctx->h[4];
+    uint32_t t0, t1, t2, t3, c;
+    uint64_t d0, d1, d2, d3, d4;
+
+    while( bytes >= 16 )
+    {
+        GET_UINT32_LE( t0, m,  0 );
+        GET_UINT32_LE( t1, m,  4 );
+        GET_UINT32_LE( t2, m,  8 );
+        GET_UINT32_LE( t3, m, 12 );
+
+        h0 += (   t0                     ) & POLY1305_MASK26;
+        h1 += ( ( t0 >> 26 ) | ( t1 <<  6 ) ) & POLY1305_MASK26;
+        h2 += ( ( t1 >> 20 ) | ( t2 << 12 ) ) & POLY1305_MASK26;
+        h3 += ( ( t2 >> 14 ) | ( t3 << 18 ) ) & POLY1305_MASK26;
+        h4 += (   t3 >>  8                 ) | hibit;
+
+        d0 = (uint64_t) h0 * r0 + (uint64_t) h1 * s4 + (uint64_t) h2 * s3 +
+             (uint64_t) h3 * s2 + (uint64_t) h4 * s1;
+        d1 = (uint64_t) h0 * r1 + (uint64_t) h1 * r0 + (uint64_t) h2 * s4 +
+             (uint64_t) h3 * s3 + (uint64_t) h4 * s2;
+        d2 = (uint64_t) h0 * r2 + (uint64_t) h1 * r1 + (uint64_t) h2 * r0 +
+             (uint64_t) h3 * s4 + (uint64_t) h4 * s3;
+        d3 = (uint64_t) h0 * r3 + (uint64_t) h1 * r2 + (uint64_t) h2 * r1 +
+             (uint64_t) h3 * r0 + (uint64_t) h4 * s4;
+        d4 = (uint64_t) h0 * r4 + (uint64_t) h1 * r3 + (uint64_t) h2 * r2 +
+             (uint64_t) h3 * r1 + (uint64_t) h4 * r0;
+
+        c = (uint32_t)( d0 >> 26 ); h0 = (uint32_t) d0 & POLY1305_MASK26;
+        d1 += c; c = (uint32_t)( d1 >> 26 ); h1 = (uint32_t) d1 & POLY1305_MASK26;
+        d2 += c; c = (uint32_t)( d2 >> 26 ); h2 = (uint32_t) d2 & POLY1305_MASK26;
+        d3 += c; c = (uint32_t)( d3 >> 26 ); h3 = (uint32_t) d3 & POLY1305_MASK26;
+        d4 += c; c = (uint32_t)( d4 >> 26 ); h4 = (uint32_t) d4 & POLY1305_MASK26;
+        h0 += c * 5; c = h0 >> 26; h0 &= POLY1305_MASK26;
+        h1 += c;
+
+        m += 16;
+        bytes -= 16;
+    }
+
+    ctx->h[0] = h0;
+    ctx->h[1] = h1;
+    ctx->h[2] = h2;
+    ctx->h[3] = h3;
+    ctx->h[4] = h4;
+}
+
+void poly1305_update( poly1305_context *ctx,
+                      const unsigned char *input, size_t ilen )
+{
+    size_t n;
+
+    if( ctx->leftover > 0 )
+    {
+        n = 16 - ctx->leftover;
+        if( n > ilen )
+            n = ilen;
+
+        memcpy( ctx->buf + ctx->leftover, input, n );
+        ctx->leftover += n;
+        input += n;
+        ilen  -= n;
+
+        if( ctx->leftover < 16 )
+            return;
+
+        poly1305_blocks( ctx, ctx->buf, 16, 1 << 24 );
+        ctx->leftover = 0;
+    }
+
+    n = ilen & ~(size_t) 15;
+    if( n > 0 )
+    {
+        poly1305_blocks( ctx, input, n, 1 << 24 );
+        input += n;
+        ilen  -= n;
+    }
+
+    if( ilen > 0 )
+    {
+        memcpy( ctx->buf, input, ilen );
+        ctx->leftover = ilen;
+    }
+}
+
+void poly1305_finish( poly1305_context *ctx,
+                      unsigned char mac[POLY1305_MAC_SIZE] )
+{
+    uint32_t h0, h1, h2, h3, h4, c;
+    uint32_t g0, g1, g2, g3, g4, mask;
+    uint64_t f;
+
+    if( ctx->leftover > 0 )
+    {
+        ctx->buf[ctx->leftover] = 1;
+        memset( ctx->buf + ctx->leftover + 1, 0, 15 - ctx->leftover );
+        poly1305_blocks( ctx, ctx->buf, 16, 0 );
+    }
+
+    h0 = ctx->h[0]; h1 = ctx->h[1]; h2 = ctx->h[2];
+    h3 = ctx->h[3]; h4 = ctx->h[4];
+
+    /*
+     * Full carry, then h mod 2^130 - 5: take g = h + 5 - 2^130 if it
+     * does not borrow
+     */
+                 c = h1 >> 26; h1 &= POLY1305_MASK26;
+    h2 += c;     c = h2 >> 26; h2 &= POLY1305_MASK26;
+    h3 += c;     c = h3 >> 26; h3 &= POLY1305_MASK26;
+    h4 += c;     c = h4 >> 26; h4 &= POLY1305_MASK26;
+    h0 += c * 5; c = h0 >> 26; h0 &= POLY1305_MASK26;
+    h1 += c;
+
+    g0 = h0 + 5; c = g0 >> 26; g0 &= POLY1305_MASK26;
+    g1 = h1 + c; c = g1 >> 26; g1 &= POLY1305_MASK26;
+    g2 = h2 + c; c = g2 >> 26; g2 &= POLY1305_MASK26;
+    g3 = h3 + c; c = g3 >> 26; g3 &= POLY1305_MASK26;
+    g4 = h4 + c - ( 1 << 26 );
+
+    mask = ( g4 >> 31 ) - 1;
+    g0 &= mask; g1 &= mask; g2 &= mask; g3 &= mask; g4 &= mask;
+    mask = ~mask;
+    h0 = ( h0 & mask ) | g0;
+    h1 = ( h1 & mask ) | g1;
+    h2 = ( h2 & mask ) | g2;
+    h3 = ( h3 & mask ) | g3;
+    h4 = ( h4 & mask ) | g4;
+
+    /*
+     * tag = (h + s) mod 2^128
+     */
+    h0 = ( h0       ) | ( h1 << 26 );
+    h1 = ( h1 >>  6 ) | ( h2 << 20 );
+    h2 = ( h2 >> 12 ) | ( h3 << 14 );
+    h3 = ( h3 >> 18 ) | ( h4 <<  8 );
+
+    f = (uint64_t) h0 + ctx->pad[0];             h0 = (uint32_t) f;
+    f = (uint64_t) h1 + ctx->pad[1] + ( f >> 32 ); h1 = (uint32_t) f;
+    f = (uint64_t) h2 + ctx->pad[2] + ( f >> 32 ); h2 = (uint32_t) f;
+    f = (uint64_t) h3 + ctx->pad[3] + ( f >> 32 ); h3 = (uint32_t) f;
+
+    PUT_UINT32_LE( h0, mac,  0 );
+    PUT_UINT32_LE( h1, mac,  4 );
+    PUT_UINT32_LE( h2, mac,  8 );
+    PUT_UINT32_LE( h3, mac, 12 );
+
+    memset( ctx, 0, sizeof( poly1305_context ) );
+}
+
+/*
+ * Poly1305 key from keystream block 0, then
+ * tag = Poly1305( aad | pad16 | ciphertext | pad16 | len(aad) | len(ct) )
+ */
+static void chachapoly_tag( const unsigned char key[CHACHA20_KEY_SIZE],
+                            const unsigned char nonce[CHACHA20_NONCE_SIZE],
+                            const unsigned char *aad, size_t aad_len,
+                            size_t length, const unsigned char *ct,
+                            unsigned char tag[POLY1305_MAC_SIZE] )
+{
+    static const unsigned char zeros[16] = { 0 };
+    unsigned char block[CHACHA20_BLOCK_SIZE];
+    unsigned char lens[16];
+    chacha20_context chacha;
+    poly1305_context poly;
+    uint64_t n;
+    int i;
+
+    chacha20_setup( &chacha, key, nonce, 0 );
+    chacha20_block( chacha.state, block );
+    poly1305_starts( &poly, block );
+
+    poly1305_update( &poly, aad, aad_len );
+    poly1305_update( &poly, zeros, ( 16 - aad_len % 16 ) % 16 );
+    poly1305_update( &poly, ct, length );
+    poly1305_update( &poly, zeros, ( 16 - length % 16 ) % 16 );
+
+    for( i = 0, n = aad_len; i < 8; i++, n >>= 8 )
+        lens[i] = (unsigned char) n;
+    for( i = 8, n = length; i < 16; i++, n >>= 8 )
+        lens[i] = (unsigned char) n;
+    poly1305_update( &poly, lens, sizeof( lens ) );
+
+    poly1305_finish( &poly, tag );
+
+    chacha20_free( &chacha );
+    memset( block, 0, sizeof( block ) );
+}
+
+void chachapoly_encrypt( const unsigned char key[CHACHA20_KEY_SIZE],
+                         const unsigned char nonce[CHACHA20_NONCE_SIZE],
+                         const unsigned char *aad, size_t aad_len,
+                         size_t length, const unsigned char *input,
+                         unsigned char *output,
+                         unsigned char tag[POLY1305_MAC_SIZE] )
+{
+    chacha20_context chacha;
+
+    chacha20_setup( &chacha, key, nonce, 1 );
+    chacha20_crypt( &chacha, length, input, output );
+    chacha20_free( &chacha );
+
+    chachapoly_tag( key, nonce, aad, aad_len, length, output, tag );
+}
+
+int chachapoly_decrypt( const unsigned char key[CHACHA20_KEY_SIZE],
+                        const unsigned char nonce[CHACHA20_NONCE_SIZE],
+                        const unsigned char *aad, size_t aad_len,
+                        const unsigned char tag[POLY1305_MAC_SIZE],
+                        size_t length, const unsigned char *input,
+                        unsigned char *output )
+{
+    unsigned char check[POLY1305_MAC_SIZE];
+    unsigned char diff = 0;
+    chacha20_context chacha;
+    int i;
+
+    chachapoly_tag( key, nonce, aad, aad_len, length, input, check );
+
+    /*
+     * Constant-time comparison
+     */
+    for( i = 0; i < POLY1305_MAC_SIZE; i++ )
+        diff |= check[i] ^ tag[i];
+
+    if( diff != 0 )
+        return( POLARSSL_ERR_CHACHAPOLY_AUTH_FAILED );
+
+    chacha20_setup( &chacha, key, nonce, 1 );
+    chacha20_crypt( &chacha, length, input, output );
+    chacha20_free( &chacha );
+
+    return( 0 );
+}
+
+#if defined(POLARSSL_SELF_TEST)
+
+/*
+ * RFC 7539, 2.8.2
+ */
+static const unsigned char chachapoly_test_key[CHACHA20_KEY_SIZE] =
+{
+    0x80, 0x81, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8A, 0x8B, 0x8C, 0x8D, 0x8E, 0x8F,
+    0x90, 0x91, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97,
+    0x98, 0x99, 0x9A, 0x9B, 0x9C, 0x9D, 0x9E, 0x9F
+};
+
+static const unsigned char chachapoly_test_nonce[CHACHA20_NONCE_SIZE] =
+{
+    0x07, 0x00, 0x00, 0x00, 0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47
+};
+
+static const unsigned char chachapoly_test_aad[12] =
+{
+    0x50, 0x51, 0x52, 0x53, 0xC0, 0xC1, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7
+};
+
+static const char chachapoly_test_pt[] =
+    "Ladies and Gentlemen of the class of '99: If I could offer you only "
+    "one tip for the future, sunscreen would be it.";
+
+static const unsigned char chachapoly_test_ct[114] =
+{
+    0xD3, 0x1A, 0x8D, 0x34, 0x64, 0x8E, 0x60, 0xDB,
+    0x7B, 0x86, 0xAF, 0xBC, 0x53, 0xEF, 0x7E, 0xC2,
+    0xA4, 0xAD, 0xED, 0x51, 0x29, 0x6E, 0x08, 0xFE,
+    0xA9, 0xE2, 0xB5, 0xA7, 0x36, 0xEE, 0x62, 0xD6,
+    0x3D, 0xBE, 0xA4, 0x5E, 0x8C, 0xA9, 0x67, 0x12,
+    0x82, 0xFA, 0xFB, 0x69, 0xDA, 0x92, 0x72, 0x8B,
+    0x1A, 0x71, 0xDE, 0x0A, 0x9E, 0x06, 0x0B, 0x29,
+    0x05, 0xD6, 0xA5, 0xB6, 0x7E, 0xCD, 0x3B, 0x36,
+    0x92, 0xDD, 0xBD, 0x7F, 0x2D, 0x77, 0x8B, 0x8C,
+    0x98, 0x03, 0xAE, 0xE3, 0x28, 0x09, 0x1B, 0x58,
+    0xFA, 0xB3, 0x24, 0xE4, 0xFA, 0xD6, 0x75, 0x94,
+    0x55, 0x85, 0x80, 0x8B, 0x48, 0x31, 0xD7, 0xBC,
+    0x3F, 0xF4, 0xDE, 0xF0, 0x8E, 0x4B, 0x7A, 0x9D,
+    0xE5, 0x76, 0xD2, 0x65, 0x86, 0xCE, 0xC6, 0x4B,
+    0x61, 0x16
+};
+
+static const unsigned char chachapoly_test_tag[POLY1305_MAC_SIZE] =
+{
+    0x1A, 0xE1, 0x0B, 0x59, 0x4F, 0x09, 0xE2, 0x6A,
+    0x7E, 0x90, 0x2E, 0xCB, 0xD0, 0x60, 0x06, 0x91
+};
+
+/*
+ * Checkup routine
+ */
+int chachapoly_self_test( int verbose )
+{
+    unsigned char out[114], back[114];
+    unsigned char tag[POLY1305_MAC_SIZE];
+
+    if( verbose != 0 )
+        printf( "  CHACHA20-POLY1305 encryption test: " );
+
+    chachapoly_encrypt( chachapoly_test_key, chachapoly_test_nonce,
+                        chachapoly_test_aad, sizeof( chachapoly_test_aad ),
+                        sizeof( out ), (const unsigned char *) chachapoly_test_pt,
+                        out, tag );
+
+    if( memcmp( out, chachapoly_test_ct, sizeof( out ) ) != 0 ||
+        memcmp( tag, chachapoly_test_tag, sizeof( tag ) ) != 0 )
+    {
+        if( verbose != 0 )
+            printf( "failed\n" );
+
+        return( 1 );
+    }
+
+    if( verbose != 0 )
+        printf( "passed\n  CHACHA20-POLY1305 decryption test: " );
+
+    if( chachapoly_decrypt( chachapoly_test_key, chachapoly_test_nonce,
+                            chachapoly_test_aad, sizeof( chachapoly_test_aad ),
+                            tag, sizeof( out ), out, back ) != 0 ||
+        memcmp( back, chachapoly_test_pt, sizeof( back ) ) != 0 )
+    {
+        if( verbose != 0 )
+            printf( "failed\n" );
+
+        return( 1 );
+    }
+
+    /*
+     * A flipped ciphertext bit must be rejected
+     */
+    out[57] ^= 0x10;
+
+    if( chachapoly_decrypt( chachapoly_test_key, chachapoly_test_nonce,
+                            chachapoly_test_aad, sizeof( chachapoly_test_aad ),
+                            tag, sizeof( out ), out, back ) !=
+        POLARSSL_ERR_CHACHAPOLY_AUTH_FAILED )
+    {
+        if( verbose != 0 )
+            printf( "failed\n" );
+
+        return( 1 );
+    }
+
+    if( verbose != 0 )
+        printf( "passed\n\n" );
+
+    return( 0 );
+}
+
+#endif
+
+#endif
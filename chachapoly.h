@@ -0,0 +1,124 @@
+/**
+ * \file chachapoly.h
+ *
+ * \brief  Poly1305 one-time authenticator and the ChaCha20-Poly1305 AEAD
+ *         construction (RFC 7539)
+ *
+ *      chachapoly_encrypt() encrypts with ChaCha20 starting at block 1 and
+ *      authenticates the additional data and the ciphertext with a Poly1305
+ *      key taken from keystream block 0. chachapoly_decrypt() checks the tag
+ *      before it releases any plaintext.
+ */
+#ifndef POLARSSL_CHACHAPOLY_H
+#define POLARSSL_CHACHAPOLY_H
+
+#include "config.h"
+#include "chacha20.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define POLARSSL_ERR_CHACHAPOLY_AUTH_FAILED                -0x0036  /**< Authenticated decryption failed. */
+
+#define POLY1305_KEY_SIZE           32      /**< One-time key size in bytes. */
+#define POLY1305_MAC_SIZE           16      /**< Tag size in bytes. */
+
+/**
+ * \brief          Poly1305 context
+ */
+typedef struct
+{
+    uint32_t r[5];                      /*!<  clamped r, radix 2^26        */
+    uint32_t h[5];                      /*!<  accumulator, radix 2^26      */
+    uint32_t pad[4];                    /*!<  s, added at the end          */
+    unsigned char buf[16];              /*!<  partial block                */
+    size_t leftover;                    /*!<  bytes in buf                 */
+}
+poly1305_context;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \brief          Start a Poly1305 computation
+ *
+ * \param ctx      Context to set up
+ * \param key      POLY1305_KEY_SIZE bytes of one-time key (r, s)
+ */
+void poly1305_starts( poly1305_context *ctx,
+                      const unsigned char key[POLY1305_KEY_SIZE] );
+
+/**
+ * \brief          Poly1305 process buffer
+ *
+ * \param ctx      Poly1305 context
+ * \param input    buffer holding the data
+ * \param ilen     length of the input data
+ */
+void poly1305_update( poly1305_context *ctx,
+                      const unsigned char *input, size_t ilen );
+
+/**
+ * \brief          Poly1305 final tag; the context is cleared
+ *
+ * \param ctx      Poly1305 context
+ * \param mac      POLY1305_MAC_SIZE bytes of tag
+ */
+void poly1305_finish( poly1305_context *ctx,
+                      unsigned char mac[POLY1305_MAC_SIZE] );
+
+/**
+ * \brief          ChaCha20-Poly1305 authenticated encryption
+ *
+ * \param key      CHACHA20_KEY_SIZE bytes of key
+ * \param nonce    CHACHA20_NONCE_SIZE bytes of nonce, unique per key
+ * \param aad      Additional data, authenticated but not encrypted
+ * \param aad_len  Length of the additional data
+ * \param length   Length of the input data
+ * \param input    Plaintext
+ * \param output   Ciphertext, length bytes (may be the same as input)
+ * \param tag      POLY1305_MAC_SIZE bytes of tag
+ */
+void chachapoly_encrypt( const unsigned char key[CHACHA20_KEY_SIZE],
+                         const unsigned char nonce[CHACHA20_NONCE_SIZE],
+                         const unsigned char *aad, size_t aad_len,
+                         size_t length, const unsigned char *input,
+                         unsigned char *output,
+                         unsigned char tag[POLY1305_MAC_SIZE] );
+
+/**
+ * \brief          ChaCha20-Poly1305 authenticated decryption
+ *
+ * \param key      CHACHA20_KEY_SIZE bytes of key
+ * \param nonce    CHACHA20_NONCE_SIZE bytes of nonce
+ * \param aad      Additional data
+ * \param aad_len  Length of the additional data
+ * \param tag      POLY1305_MAC_SIZE bytes of tag to check
+ * \param length   Length of the input data
+ * \param input    Ciphertext
+ * \param output   Plaintext, length bytes (may be the same as input)
+ *
+ * \return         0 if successful,
+ *                 POLARSSL_ERR_CHACHAPOLY_AUTH_FAILED if the tag does not
+ *                 match; output is then left untouched
+ */
+int chachapoly_decrypt( const unsigned char key[CHACHA20_KEY_SIZE],
+                        const unsigned char nonce[CHACHA20_NONCE_SIZE],
+                        const unsigned char *aad, size_t aad_len,
+                        const unsigned char tag[POLY1305_MAC_SIZE],
+                        size_t length, const unsigned char *input,
+                        unsigned char *output );
+
+/**
+ * \brief          Checkup routine
+ *
+ * \return         0 if successful, or 1 if the test failed
+ */
+int chachapoly_self_test( int verbose );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* chachapoly.h */
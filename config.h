@@ -147,6 +147,19 @@
  */
 #define POLARSSL_GENPRIME
 
+/**
+ * \def POLARSSL_MPI_BPSW
+ *
+ * Requires: POLARSSL_BIGNUM_C
+ *
+ * Use the Baillie-PSW test (strong base-2 Miller-Rabin and strong Lucas)
+ * in mpi_is_prime() and mpi_gen_prime() instead of the 2 to 27 random
+ * base Miller-Rabin rounds of HAC table 4.4.
+ *
+ * Comment this macro to go back to the random base rounds.
+ */
+#define POLARSSL_MPI_BPSW
+
 /**
  * \def POLARSSL_FS_IO
  *
@@ -319,6 +332,45 @@
  */
 #define POLARSSL_CERTS_C
 
+/**
+ * \def POLARSSL_CHACHA20_C
+ *
+ * Enable the ChaCha20 stream cipher.
+ *
+ * Module:  chacha20.cpp
+ * Caller:  chacha_drbg.cpp
+ *          chachapoly.cpp
+ */
+#define POLARSSL_CHACHA20_C
+
+/**
+ * \def POLARSSL_CHACHA_DRBG_C
+ *
+ * Enable the ChaCha20-based random generator.
+ *
+ * Module:  chacha_drbg.cpp
+ * Caller:  MpiBigInt.cpp
+ *
+ * Requires: POLARSSL_CHACHA20_C
+ *
+ * This module provides the f_rng used for key generation.
+ */
+#define POLARSSL_CHACHA_DRBG_C
+
+/**
+ * \def POLARSSL_CHACHAPOLY_C
+ *
+ * Enable Poly1305 and the ChaCha20-Poly1305 AEAD construction.
+ *
+ * Module:  chachapoly.cpp
+ * Caller:  RSA.cpp
+ *
+ * Requires: POLARSSL_CHACHA20_C
+ *
+ * This module is required for the CRYPT_HYBRID mode of RSACrypter.
+ */
+#define POLARSSL_CHACHAPOLY_C
+
 /**
  * \def POLARSSL_CIPHER_C
  *
@@ -571,11 +623,11 @@
  *
  * Enable the SHA-224 and SHA-256 cryptographic hash algorithms.
  *
- * Module:  library/sha2.c
- * Caller:  library/md_wrap.c
- *          library/x509parse.c
+ * Module:  sha2.cpp
+ * Caller:  RSA.cpp
  *
- * This module adds support for SHA-224 and SHA-256.
+ * This module adds support for SHA-224 and SHA-256 and is required for
+ * the SIGN_SHA256 signature mode of RSACrypter.
  */
 #define POLARSSL_SHA2_C
 